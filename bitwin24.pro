@@ -294,6 +294,7 @@ HEADERS = \
    $$PWD/src/bitwin24-cli-res.rc \
    $$PWD/src/bitwin24-tx-res.rc \
    $$PWD/src/bitwin24d-res.rc \
+   $$PWD/src/blockcache.h \
    $$PWD/src/blocksignature.h \
    $$PWD/src/bloom.h \
    $$PWD/src/chain.h \
@@ -308,6 +309,7 @@ HEADERS = \
    $$PWD/src/compat.h \
    $$PWD/src/compressor.h \
    $$PWD/src/core_io.h \
+   $$PWD/src/core_memusage.h \
    $$PWD/src/crypter.h \
    $$PWD/src/db.h \
    $$PWD/src/denomination_functions.h \
@@ -330,6 +332,7 @@ HEADERS = \
    $$PWD/src/masternode.h \
    $$PWD/src/masternodeconfig.h \
    $$PWD/src/masternodeman.h \
+   $$PWD/src/memusage.h \
    $$PWD/src/merkleblock.h \
    $$PWD/src/miner.h \
    $$PWD/src/mintpool.h \
@@ -339,6 +342,7 @@ HEADERS = \
    $$PWD/src/noui.h \
    $$PWD/src/obfuscation-relay.h \
    $$PWD/src/obfuscation.h \
+   $$PWD/src/poolalloc.h \
    $$PWD/src/pow.h \
    $$PWD/src/protocol.h \
    $$PWD/src/pubkey.h \
@@ -346,6 +350,7 @@ HEADERS = \
    $$PWD/src/reverse_iterate.h \
    $$PWD/src/reverselock.h \
    $$PWD/src/scheduler.h \
+   $$PWD/src/serialindex.h \
    $$PWD/src/serialize.h \
    $$PWD/src/spork.h \
    $$PWD/src/sporkdb.h \
@@ -373,6 +378,7 @@ HEADERS = \
    $$PWD/src/wallet_ismine.h \
    $$PWD/src/walletdb.h \
    $$PWD/src/zbwichain.h \
+   $$PWD/src/zbwispendcache.h \
    $$PWD/src/zbwitracker.h \
    $$PWD/src/zbwiwallet.h \
    $$PWD/configure.ac
@@ -1527,6 +1533,7 @@ SOURCES = \
    $$PWD/src/test/data/txcreate2.hex \
    $$PWD/src/test/data/txcreatesign.hex \
    $$PWD/src/test/accounting_tests.cpp \
+   $$PWD/src/test/accumulators_tests.cpp \
    $$PWD/src/test/alert_tests.cpp \
    $$PWD/src/test/allocator_tests.cpp \
    $$PWD/src/test/arith_uint256_tests.cpp \
@@ -1537,6 +1544,7 @@ SOURCES = \
    $$PWD/src/test/benchmark_zerocoin.cpp \
    $$PWD/src/test/bip32_tests.cpp \
    $$PWD/src/test/bitcoin-util-test.py \
+   $$PWD/src/test/blockcache_tests.cpp \
    $$PWD/src/test/bloom_tests.cpp \
    $$PWD/src/test/budget_tests.cpp \
    $$PWD/src/test/buildenv.py \
@@ -1544,6 +1552,7 @@ SOURCES = \
    $$PWD/src/test/checkblock_tests.cpp \
    $$PWD/src/test/Checkpoints_tests.cpp \
    $$PWD/src/test/coins_tests.cpp \
+   $$PWD/src/test/coinsdb_tests.cpp \
    $$PWD/src/test/compress_tests.cpp \
    $$PWD/src/test/crypto_tests.cpp \
    $$PWD/src/test/DoS_tests.cpp \
@@ -1585,6 +1594,7 @@ SOURCES = \
    $$PWD/src/test/zerocoin_denomination_tests.cpp \
    $$PWD/src/test/zerocoin_implementation_tests.cpp \
    $$PWD/src/test/zerocoin_transactions_tests.cpp \
+   $$PWD/src/test/zerocoindb_tests.cpp \
    $$PWD/src/univalue/autom4te.cache/output.0 \
    $$PWD/src/univalue/autom4te.cache/output.1 \
    $$PWD/src/univalue/autom4te.cache/output.2 \
@@ -1700,6 +1710,7 @@ SOURCES = \
    $$PWD/src/bitwin24-tx.cpp \
    $$PWD/src/bitwin24d \
    $$PWD/src/bitwin24d.cpp \
+   $$PWD/src/blockcache.cpp \
    $$PWD/src/blocksignature.cpp \
    $$PWD/src/bloom.cpp \
    $$PWD/src/chain.cpp \
@@ -1752,6 +1763,7 @@ SOURCES = \
    $$PWD/src/rpcdump.cpp \
    $$PWD/src/rpcwallet.cpp \
    $$PWD/src/scheduler.cpp \
+   $$PWD/src/serialindex.cpp \
    $$PWD/src/spork.cpp \
    $$PWD/src/sporkdb.cpp \
    $$PWD/src/stakeinput.cpp \
@@ -1771,6 +1783,7 @@ SOURCES = \
    $$PWD/src/wallet_ismine.cpp \
    $$PWD/src/walletdb.cpp \
    $$PWD/src/zbwichain.cpp \
+   $$PWD/src/zbwispendcache.cpp \
    $$PWD/src/zbwitracker.cpp \
    $$PWD/src/zbwiwallet.cpp \
    $$PWD/aclocal.m4 \
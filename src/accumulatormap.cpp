@@ -46,7 +46,7 @@ bool AccumulatorMap::Load(uint256 nCheckpoint)
         uint32_t nChecksum = ParseChecksum(nCheckpoint, denom);
 
         CBigNum bnValue;
-        if (!zerocoinDB->ReadAccumulatorValue(nChecksum, bnValue))
+        if (!pzerocoinTip->ReadAccumulatorValue(nChecksum, bnValue))
             return error("%s : cannot find checksum %d", __func__, nChecksum);
 
         mapAccumulators.at(denom)->setValue(bnValue);
@@ -75,6 +75,25 @@ bool AccumulatorMap::Accumulate(const PublicCoin& pubCoin, bool fSkipValidation)
     return true;
 }
 
+//Add zerocoins to the accumulators of their denominations, with one exponentiation per denomination
+bool AccumulatorMap::Accumulate(const std::list<PublicCoin>& listPubcoins, bool fSkipValidation)
+{
+    std::map<CoinDenomination, std::vector<CBigNum> > mapValues;
+    for (const PublicCoin& pubCoin : listPubcoins) {
+        CoinDenomination denom = pubCoin.getDenomination();
+        if (denom == CoinDenomination::ZQ_ERROR)
+            return false;
+        if (!fSkipValidation && !pubCoin.validate())
+            return false;
+
+        mapValues[denom].emplace_back(pubCoin.getValue());
+    }
+
+    for (const auto& it : mapValues)
+        mapAccumulators.at(it.first)->increment(it.second);
+    return true;
+}
+
 //Get the value of a specific accumulator
 CBigNum AccumulatorMap::GetValue(CoinDenomination denom)
 {
@@ -22,6 +22,7 @@ public:
     bool Load(uint256 nCheckpoint);
     void Load(const AccumulatorCheckpoints::Checkpoint& checkpoint);
     bool Accumulate(const libzerocoin::PublicCoin& pubCoin, bool fSkipValidation = false);
+    bool Accumulate(const std::list<libzerocoin::PublicCoin>& listPubcoins, bool fSkipValidation = false);
     CBigNum GetValue(libzerocoin::CoinDenomination denom);
     uint256 GetCheckpoint();
     void Reset();
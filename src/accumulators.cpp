@@ -16,9 +16,74 @@
 
 using namespace libzerocoin;
 
-std::map<uint32_t, CBigNum> mapAccumulatorValues;
 std::list<uint256> listAccCheckpointsNoDB;
 
+namespace {
+
+/**
+ * Accumulator values by checksum. Values are read from the zerocoin database the first time they
+ * are looked up and only the most recently used ones are kept, so memory does not grow with the
+ * number of checkpoints in the chain.
+ */
+class CAccumulatorValueCache
+{
+private:
+    typedef std::list<std::pair<uint32_t, CBigNum> > list_type;
+    list_type listValues; //! most recently used first
+    std::map<uint32_t, list_type::iterator> mapValues;
+    CCriticalSection cs_accvalues;
+
+public:
+    bool Get(uint32_t nChecksum, CBigNum& bnValue)
+    {
+        LOCK(cs_accvalues);
+        auto it = mapValues.find(nChecksum);
+        if (it == mapValues.end())
+            return false;
+
+        listValues.splice(listValues.begin(), listValues, it->second);
+        bnValue = it->second->second;
+        return true;
+    }
+
+    void Set(uint32_t nChecksum, const CBigNum& bnValue)
+    {
+        int64_t nMaxCacheSize = GetArg("-maxaccumulatorcachesize", DEFAULT_MAX_ACCUMULATOR_CACHE_SIZE);
+        if (nMaxCacheSize <= 0) return;
+
+        LOCK(cs_accvalues);
+        auto it = mapValues.find(nChecksum);
+        if (it != mapValues.end()) {
+            it->second->second = bnValue;
+            listValues.splice(listValues.begin(), listValues, it->second);
+            return;
+        }
+
+        while (static_cast<int64_t>(mapValues.size()) >= nMaxCacheSize) {
+            mapValues.erase(listValues.back().first);
+            listValues.pop_back();
+        }
+
+        listValues.emplace_front(nChecksum, bnValue);
+        mapValues.insert(std::make_pair(nChecksum, listValues.begin()));
+    }
+
+    void Erase(uint32_t nChecksum)
+    {
+        LOCK(cs_accvalues);
+        auto it = mapValues.find(nChecksum);
+        if (it == mapValues.end())
+            return;
+
+        listValues.erase(it->second);
+        mapValues.erase(it);
+    }
+};
+
+CAccumulatorValueCache accumulatorValueCache;
+
+}
+
 uint32_t ParseChecksum(uint256 nChecksum, CoinDenomination denomination)
 {
     //shift to the beginning bit of this denomination and trim any remaining bits by returning 32 bits only
@@ -64,17 +129,16 @@ int GetChecksumHeight(uint32_t nChecksum, CoinDenomination denomination)
 
 bool GetAccumulatorValueFromChecksum(uint32_t nChecksum, bool fMemoryOnly, CBigNum& bnAccValue)
 {
-    if (mapAccumulatorValues.count(nChecksum)) {
-        bnAccValue = mapAccumulatorValues.at(nChecksum);
+    if (accumulatorValueCache.Get(nChecksum, bnAccValue))
         return true;
-    }
 
     if (fMemoryOnly)
         return false;
 
-    if (!zerocoinDB->ReadAccumulatorValue(nChecksum, bnAccValue)) {
+    if (pzerocoinTip->ReadAccumulatorValue(nChecksum, bnAccValue))
+        accumulatorValueCache.Set(nChecksum, bnAccValue);
+    else
         bnAccValue = 0;
-    }
 
     return true;
 }
@@ -89,8 +153,8 @@ void AddAccumulatorChecksum(const uint32_t nChecksum, const CBigNum &bnValue)
 {
     //Since accumulators are switching at v2, stop databasing v1 because its useless. Only focus on v2.
     if (chainActive.Height() >= Params().Zerocoin_Block_V2_Start()) {
-        zerocoinDB->WriteAccumulatorValue(nChecksum, bnValue);
-        mapAccumulatorValues.insert(make_pair(nChecksum, bnValue));
+        pzerocoinTip->WriteAccumulatorValue(nChecksum, bnValue);
+        accumulatorValueCache.Set(nChecksum, bnValue);
     }
 }
 
@@ -108,8 +172,8 @@ void DatabaseChecksums(AccumulatorMap& mapAccumulators)
 bool EraseChecksum(uint32_t nChecksum)
 {
     //erase from both memory and database
-    mapAccumulatorValues.erase(nChecksum);
-    return zerocoinDB->EraseAccumulatorValue(nChecksum);
+    accumulatorValueCache.Erase(nChecksum);
+    return pzerocoinTip->EraseAccumulatorValue(nChecksum);
 }
 
 bool EraseAccumulatorValues(const uint256& nCheckpointErase, const uint256& nCheckpointPrevious)
@@ -129,24 +193,6 @@ bool EraseAccumulatorValues(const uint256& nCheckpointErase, const uint256& nChe
     return true;
 }
 
-bool LoadAccumulatorValuesFromDB(const uint256 nCheckpoint)
-{
-    for (auto& denomination : zerocoinDenomList) {
-        uint32_t nChecksum = ParseChecksum(nCheckpoint, denomination);
-
-        //if read is not successful then we are not in a state to verify zerocoin transactions
-        CBigNum bnValue;
-        if (!zerocoinDB->ReadAccumulatorValue(nChecksum, bnValue)) {
-            if (!count(listAccCheckpointsNoDB.begin(), listAccCheckpointsNoDB.end(), nCheckpoint))
-                listAccCheckpointsNoDB.push_back(nCheckpoint);
-            LogPrint("zero", "%s : Missing databased value for checksum %d", __func__, nChecksum);
-            return false;
-        }
-        mapAccumulatorValues.insert(make_pair(nChecksum, bnValue));
-    }
-    return true;
-}
-
 //Erase accumulator checkpoints for a certain block range
 bool EraseCheckpoints(int nStartHeight, int nEndHeight)
 {
@@ -255,6 +301,7 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
 
     //Accumulate all coins over the last ten blocks that havent been accumulated (height - 20 through height - 11)
     int nTotalMintsFound = 0;
+    std::list<PublicCoin> listAccumulate;
     CBlockIndex *pindex = chainActive[nHeightCheckpoint - 20];
 
     while (pindex->nHeight < nHeight - 10) {
@@ -269,25 +316,21 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
         }
 
         //grab mints from this block
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex))
-            return error("%s: failed to read block from disk", __func__);
-
         std::list<PublicCoin> listPubcoins;
-        if (!BlockToPubcoinList(block, listPubcoins, fFilterInvalid))
+        if (!GetBlockPubcoins(pindex, CoinDenomination::ZQ_ERROR, fFilterInvalid, listPubcoins))
             return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
 
         nTotalMintsFound += listPubcoins.size();
         LogPrint("zero", "%s found %d mints\n", __func__, listPubcoins.size());
 
-        //add the pubcoins to accumulator
-        for (const PublicCoin& pubcoin : listPubcoins) {
-            if(!mapAccumulators.Accumulate(pubcoin, true))
-                return error("%s: failed to add pubcoin to accumulator at height %d", __func__, pindex->nHeight);
-        }
+        listAccumulate.splice(listAccumulate.end(), listPubcoins);
         pindex = chainActive.Next(pindex);
     }
 
+    //add the pubcoins of the whole range to the accumulators at once
+    if (!mapAccumulators.Accumulate(listAccumulate, true))
+        return error("%s: failed to add pubcoins to accumulator at height %d", __func__, nHeight);
+
     // if there were no new mints found, the accumulator checkpoint will be the same as the last checkpoint
     if (nTotalMintsFound == 0)
         nCheckpoint = chainActive[nHeight - 1]->nAccumulatorCheckpoint;
@@ -358,30 +401,24 @@ int ComputeAccumulatedCoins(int nHeightEnd, libzerocoin::CoinDenomination denom)
     return n;
 }
 
+//Collect the mints of a block that go into an accumulator, so that they can be added with a single exponentiation
 int AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nHeightMintAdded, const CBlockIndex* pindex,
-                           libzerocoin::Accumulator* accumulator, bool isWitness)
+                           std::vector<CBigNum>& vPubcoins, bool isWitness)
 {
     // if this block contains mints of the denomination that is being spent, then add them to the witness
     int nMintsAdded = 0;
     if (pindex->MintedDenomination(coin.getDenomination())) {
-        //grab mints from this block
-        CBlock block;
-        if(!ReadBlockFromDisk(block, pindex))
-            return error("%s: failed to read block from disk while adding pubcoins to witness", __func__);
-
+        //grab mints of this denomination from this block
         list<PublicCoin> listPubcoins;
-        if(!BlockToPubcoinList(block, listPubcoins, true))
-            return error("%s: failed to get zerocoin mintlist from block %n\n", __func__, pindex->nHeight);
+        if(!GetBlockPubcoins(pindex, coin.getDenomination(), true, listPubcoins))
+            return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
 
         //add the mints to the witness
         for (const PublicCoin& pubcoin : listPubcoins) {
-            if (pubcoin.getDenomination() != coin.getDenomination())
-                continue;
-
             if (isWitness && pindex->nHeight == nHeightMintAdded && pubcoin.getValue() == coin.getValue())
                 continue;
 
-            accumulator->increment(pubcoin.getValue());
+            vPubcoins.emplace_back(pubcoin.getValue());
             ++nMintsAdded;
         }
     }
@@ -415,7 +452,43 @@ bool GetAccumulatorValue(int& nHeight, const libzerocoin::CoinDenomination denom
     return true;
 }
 
-bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError, CBlockIndex* pindexCheckpoint)
+//Whether a cached witness belongs to this coin and was built along the active chain
+static bool WitnessCacheOnChain(const CAccumulatorWitnessCache& cache, const PublicCoin& coin)
+{
+    if (cache.IsNull() || cache.denom != coin.getDenomination() || cache.bnPubcoin != coin.getValue())
+        return false;
+
+    CBlockIndex* pindexLast = chainActive[cache.nHeightNext - 1];
+    return pindexLast && pindexLast->GetBlockHash() == cache.hashBlockLast;
+}
+
+//Find the height a witness can be resumed from using the cache, without changing the resulting witness
+static bool ResumeWitnessCache(const CAccumulatorWitnessCache& cache, int nSecurityLevel, int nHeightStop, int& nHeightResume)
+{
+    if (cache.nHeightNext <= nHeightStop) {
+        //the witness must not have been stopped by the security level before the cached height
+        if (nSecurityLevel != 100 && cache.nCheckpointsAdded >= nSecurityLevel)
+            return false;
+
+        nHeightResume = cache.nHeightNext;
+        return true;
+    }
+
+    //The cache went past the stop height, it can only be used if no coins of this denomination were minted in between
+    if (nSecurityLevel != 100 || nHeightStop < cache.nHeightAccStart)
+        return false;
+    if (nHeightStop <= 1050010 && cache.nHeightNext > 1050000)
+        return false;
+    for (int i = nHeightStop; i < cache.nHeightNext; i++) {
+        if (chainActive[i]->MintedDenomination(cache.denom))
+            return false;
+    }
+
+    nHeightResume = nHeightStop;
+    return true;
+}
+
+bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError, CBlockIndex* pindexCheckpoint, CAccumulatorWitnessCache* pcache)
 {
     LogPrint("zero", "%s: generating\n", __func__);
     int nLockAttempts = 0;
@@ -431,36 +504,7 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
     if (nLockAttempts == 100)
         return error("%s: could not get lock on cs_main", __func__);
     LogPrint("zero", "%s: after lock\n", __func__);
-    uint256 txid;
-    if (!zerocoinDB->ReadCoinMint(coin.getValue(), txid))
-        return error("%s failed to read mint from db", __func__);
-
-    CTransaction txMinted;
-    uint256 hashBlock;
-    if (!GetTransaction(txid, txMinted, hashBlock))
-        return error("%s failed to read tx", __func__);
-
-    int nHeightTest;
-    if (!IsTransactionInChain(txid, nHeightTest))
-        return error("%s: mint tx %s is not in chain", __func__, txid.GetHex());
-
-    int nHeightMintAdded = mapBlockIndex[hashBlock]->nHeight;
-
-    //get the checkpoint added at the next multiple of 10
-    int nHeightCheckpoint = nHeightMintAdded + (10 - (nHeightMintAdded % 10));
-
-    //the height to start accumulating coins to add to witness
-    int nAccStartHeight = nHeightMintAdded - (nHeightMintAdded % 10);
 
-    //Get the accumulator that is right before the cluster of blocks containing our mint was added to the accumulator
-    CBigNum bnAccValue = 0;
-    if (GetAccumulatorValue(nHeightCheckpoint, coin.getDenomination(), bnAccValue)) {
-            accumulator.setValue(bnAccValue);
-            witness.resetValue(accumulator, coin);
-    }
-
-    //add the pubcoins from the blockchain up to the next checksum starting from the block
-    CBlockIndex* pindex = chainActive[nHeightCheckpoint - 10];
     int nChainHeight = chainActive.Height();
     int nHeightStop = nChainHeight % 10;
     nHeightStop = nChainHeight - nHeightStop - 20; // at least two checkpoints deep
@@ -469,14 +513,67 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
     if (pindexCheckpoint)
         nHeightStop = pindexCheckpoint->nHeight - 10;
 
-    //Iterate through the chain and calculate the witness
+    RandomizeSecurityLevel(nSecurityLevel); //make security level not always the same and predictable
+
+    int nHeightMintAdded = 0;
+    int nAccStartHeight = 0;
     int nCheckpointsAdded = 0;
     nMintsAdded = 0;
-    RandomizeSecurityLevel(nSecurityLevel); //make security level not always the same and predictable
+    bool fDoubleCounted = false;
+    CBlockIndex* pindex = nullptr;
     libzerocoin::Accumulator witnessAccumulator = accumulator;
 
-    bool fDoubleCounted = false;
+    //Pick up from where the cached witness got to, if it is still on the active chain
+    bool fCacheOnChain = pcache && WitnessCacheOnChain(*pcache, coin);
+    int nHeightResume = 0;
+    if (fCacheOnChain && ResumeWitnessCache(*pcache, nSecurityLevel, nHeightStop, nHeightResume)) {
+        nHeightMintAdded = pcache->nHeightMintAdded;
+        nAccStartHeight = pcache->nHeightAccStart;
+        nMintsAdded = pcache->nMintsAdded;
+        nCheckpointsAdded = pcache->nCheckpointsAdded;
+        fDoubleCounted = pcache->fDoubleCounted;
+        witnessAccumulator.setValue(pcache->bnWitness);
+        pindex = chainActive[nHeightResume];
+        LogPrint("zero", "%s: resuming witness at height %d from cache at height %d\n", __func__, nHeightResume, pcache->nHeightNext);
+    } else {
+        uint256 txid;
+        if (!pzerocoinTip->ReadCoinMint(coin.getValue(), txid))
+            return error("%s failed to read mint from db", __func__);
+
+        CTransaction txMinted;
+        uint256 hashBlock;
+        if (!GetTransaction(txid, txMinted, hashBlock))
+            return error("%s failed to read tx", __func__);
+
+        int nHeightTest;
+        if (!IsTransactionInChain(txid, nHeightTest))
+            return error("%s: mint tx %s is not in chain", __func__, txid.GetHex());
+
+        nHeightMintAdded = mapBlockIndex[hashBlock]->nHeight;
+
+        //get the checkpoint added at the next multiple of 10
+        int nHeightCheckpoint = nHeightMintAdded + (10 - (nHeightMintAdded % 10));
+
+        //the height to start accumulating coins to add to witness
+        nAccStartHeight = nHeightMintAdded - (nHeightMintAdded % 10);
+
+        //Get the accumulator that is right before the cluster of blocks containing our mint was added to the accumulator
+        CBigNum bnAccValue = 0;
+        if (GetAccumulatorValue(nHeightCheckpoint, coin.getDenomination(), bnAccValue)) {
+                accumulator.setValue(bnAccValue);
+                witness.resetValue(accumulator, coin);
+        }
+        witnessAccumulator = accumulator;
+
+        //add the pubcoins from the blockchain up to the next checksum starting from the block
+        pindex = chainActive[nHeightCheckpoint - 10];
+    }
+
+    //Iterate through the chain and calculate the witness
+    std::vector<CBigNum> vWitnessPubcoins;
+    int nCheckpointsBefore = nCheckpointsAdded;
     while (pindex) {
+        nCheckpointsBefore = nCheckpointsAdded;
         if (pindex->nHeight != nAccStartHeight && pindex->pprev->nAccumulatorCheckpoint != pindex->nAccumulatorCheckpoint)
             ++nCheckpointsAdded;
 
@@ -487,7 +584,7 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
             if(InvalidCheckpointRange(pindex->nHeight))
                 continue;
 
-            bnAccValue = 0;
+            CBigNum bnAccValue = 0;
             uint256 nCheckpointSpend = chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint;
             if (!GetAccumulatorValueFromDB(nCheckpointSpend, coin.getDenomination(), bnAccValue) || bnAccValue == 0)
                 return error("%s : failed to find checksum in database for accumulator", __func__);
@@ -496,7 +593,7 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
             break;
         }
 
-        nMintsAdded += AddBlockMintsToAccumulator(coin, nHeightMintAdded, pindex, &witnessAccumulator, true);
+        nMintsAdded += AddBlockMintsToAccumulator(coin, nHeightMintAdded, pindex, vWitnessPubcoins, true);
 
         // 10 blocks were accumulated twice when zBWI v2 was activated
         if (pindex->nHeight == 1050010 && !fDoubleCounted) {
@@ -508,10 +605,25 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
         pindex = chainActive.Next(pindex);
     }
 
+    witnessAccumulator.increment(vWitnessPubcoins);
     witness.resetValue(witnessAccumulator, coin);
     if (!witness.VerifyWitness(accumulator, coin))
         return error("%s: failed to verify witness", __func__);
 
+    //Remember how far this witness got, unless the cache is already further along the active chain
+    if (pcache && pindex && (!fCacheOnChain || pindex->nHeight >= pcache->nHeightNext)) {
+        pcache->bnPubcoin = coin.getValue();
+        pcache->denom = coin.getDenomination();
+        pcache->nHeightMintAdded = nHeightMintAdded;
+        pcache->nHeightAccStart = nAccStartHeight;
+        pcache->nHeightNext = pindex->nHeight;
+        pcache->hashBlockLast = pindex->pprev->GetBlockHash();
+        pcache->bnWitness = witnessAccumulator.getValue();
+        pcache->nMintsAdded = nMintsAdded;
+        pcache->nCheckpointsAdded = nCheckpointsBefore;
+        pcache->fDoubleCounted = fDoubleCounted;
+    }
+
     // A certain amount of accumulated coins are required
     if (nMintsAdded < Params().Zerocoin_RequiredAccumulation()) {
         strError = _(strprintf("Less than %d mints added, unable to create spend", Params().Zerocoin_RequiredAccumulation()).c_str());
@@ -525,6 +637,58 @@ bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator
     return true;
 }
 
+/**
+ * Add the mints of the blocks below nHeightStop to a cached witness, the same way GenerateAccumulatorWitness
+ * does at security level 100. cs_main is only held while looking up the blocks.
+ */
+bool AdvanceAccumulatorWitnessCache(CAccumulatorWitnessCache& cache, int nHeightStop)
+{
+    std::vector<const CBlockIndex*> vBlocks;
+    const CBlockIndex* pindex = nullptr;
+    bool fDoubleCounted = cache.fDoubleCounted;
+    {
+        LOCK(cs_main);
+        const CBlockIndex* pindexLast = chainActive[cache.nHeightNext - 1];
+        if (cache.IsNull() || !pindexLast || pindexLast->GetBlockHash() != cache.hashBlockLast)
+            return false;
+
+        pindex = chainActive.Next(pindexLast);
+        while (pindex && pindex->nHeight < nHeightStop) {
+            vBlocks.emplace_back(pindex);
+
+            // 10 blocks were accumulated twice when zBWI v2 was activated
+            if (pindex->nHeight == 1050010 && !fDoubleCounted) {
+                pindex = chainActive[1050000];
+                fDoubleCounted = true;
+                continue;
+            }
+
+            pindex = chainActive.Next(pindex);
+        }
+
+        if (!pindex)
+            return false;
+    }
+
+    PublicCoin coin(Params().Zerocoin_Params(false), cache.bnPubcoin, cache.denom);
+    libzerocoin::Accumulator witnessAccumulator(Params().Zerocoin_Params(false), cache.denom, cache.bnWitness);
+    std::vector<CBigNum> vWitnessPubcoins;
+    for (const CBlockIndex* pindexAdd : vBlocks) {
+        if (pindexAdd->nHeight != cache.nHeightAccStart && pindexAdd->pprev->nAccumulatorCheckpoint != pindexAdd->nAccumulatorCheckpoint)
+            ++cache.nCheckpointsAdded;
+
+        cache.nMintsAdded += AddBlockMintsToAccumulator(coin, cache.nHeightMintAdded, pindexAdd, vWitnessPubcoins, true);
+    }
+    witnessAccumulator.increment(vWitnessPubcoins);
+
+    cache.nHeightNext = pindex->nHeight;
+    cache.hashBlockLast = pindex->pprev->GetBlockHash();
+    cache.bnWitness = witnessAccumulator.getValue();
+    cache.fDoubleCounted = fDoubleCounted;
+
+    return true;
+}
+
 map<CoinDenomination, int> GetMintMaturityHeight()
 {
     map<CoinDenomination, pair<int, int > > mapDenomMaturity;
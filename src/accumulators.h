@@ -17,14 +17,73 @@
 
 class CBlockIndex;
 
+/** -maxaccumulatorcachesize default, in entries; each holds a 2048 bit value, about 100 checkpoints of all denominations */
+static const int64_t DEFAULT_MAX_ACCUMULATOR_CACHE_SIZE = 800;
+
+/**
+ * The state of a mint's witness accumulator part way through the chain, so that a later witness
+ * only has to add the blocks connected since, instead of replaying everything from the mint.
+ */
+class CAccumulatorWitnessCache
+{
+public:
+    CBigNum bnPubcoin;
+    libzerocoin::CoinDenomination denom;
+    int nHeightMintAdded;
+    int nHeightAccStart;
+    int nHeightNext; //! the next block whose mints have to be added
+    uint256 hashBlockLast; //! the last block whose mints were added, to detect reorgs
+    CBigNum bnWitness;
+    int nMintsAdded;
+    int nCheckpointsAdded;
+    bool fDoubleCounted;
+
+    CAccumulatorWitnessCache()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        bnPubcoin = 0;
+        denom = libzerocoin::ZQ_ERROR;
+        nHeightMintAdded = 0;
+        nHeightAccStart = 0;
+        nHeightNext = 0;
+        hashBlockLast = 0;
+        bnWitness = 0;
+        nMintsAdded = 0;
+        nCheckpointsAdded = 0;
+        fDoubleCounted = false;
+    }
+
+    bool IsNull() const { return nHeightNext == 0; }
+
+    ADD_SERIALIZE_METHODS;
+
+    template <typename Stream, typename Operation>
+    inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
+        READWRITE(bnPubcoin);
+        READWRITE(denom);
+        READWRITE(nHeightMintAdded);
+        READWRITE(nHeightAccStart);
+        READWRITE(nHeightNext);
+        READWRITE(hashBlockLast);
+        READWRITE(bnWitness);
+        READWRITE(nMintsAdded);
+        READWRITE(nCheckpointsAdded);
+        READWRITE(fDoubleCounted);
+    }
+};
+
 std::map<libzerocoin::CoinDenomination, int> GetMintMaturityHeight();
-bool GenerateAccumulatorWitness(const libzerocoin::PublicCoin &coin, libzerocoin::Accumulator& accumulator, libzerocoin::AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, std::string& strError, CBlockIndex* pindexCheckpoint = nullptr);
+bool GenerateAccumulatorWitness(const libzerocoin::PublicCoin &coin, libzerocoin::Accumulator& accumulator, libzerocoin::AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, std::string& strError, CBlockIndex* pindexCheckpoint = nullptr, CAccumulatorWitnessCache* pcache = nullptr);
+bool AdvanceAccumulatorWitnessCache(CAccumulatorWitnessCache& cache, int nHeightStop);
 bool GetAccumulatorValueFromDB(uint256 nCheckpoint, libzerocoin::CoinDenomination denom, CBigNum& bnAccValue);
 bool GetAccumulatorValueFromChecksum(uint32_t nChecksum, bool fMemoryOnly, CBigNum& bnAccValue);
 void AddAccumulatorChecksum(const uint32_t nChecksum, const CBigNum &bnValue, bool fMemoryOnly);
 bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, AccumulatorMap& mapAccumulators);
 void DatabaseChecksums(AccumulatorMap& mapAccumulators);
-bool LoadAccumulatorValuesFromDB(const uint256 nCheckpoint);
 bool EraseAccumulatorValues(const uint256& nCheckpointErase, const uint256& nCheckpointPrevious);
 uint32_t ParseChecksum(uint256 nChecksum, libzerocoin::CoinDenomination denomination);
 uint32_t GetChecksum(const CBigNum &bnValue);
@@ -0,0 +1,141 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "core_memusage.h"
+
+CBlockCache blockcache;
+
+/** Heap usage of a deserialized block */
+static size_t BlockUsage(const CBlock& block)
+{
+    return memusage::MallocUsage(sizeof(CBlock)) + RecursiveDynamicUsage(block);
+}
+
+CBlockCache::CBlockCache() : nUsage(0), nMaxUsage(DEFAULT_BLOCK_CACHE_SIZE << 20), nHits(0), nMisses(0), nRawHits(0), nRawMisses(0) {}
+
+CBlockCache::CEntry& CBlockCache::Touch(const uint256& hash)
+{
+    std::map<uint256, CEntry>::iterator it = mapEntries.find(hash);
+    if (it == mapEntries.end()) {
+        listLRU.push_front(hash);
+        CEntry& entry = mapEntries[hash];
+        entry.nUsage = 0;
+        entry.itLRU = listLRU.begin();
+        return entry;
+    }
+    listLRU.splice(listLRU.begin(), listLRU, it->second.itLRU);
+    return it->second;
+}
+
+void CBlockCache::Resize(CEntry& entry)
+{
+    nUsage -= entry.nUsage;
+    entry.nUsage = (entry.pblock ? BlockUsage(*entry.pblock) : 0) + (entry.praw ? memusage::DynamicUsage(*entry.praw) : 0);
+    nUsage += entry.nUsage;
+}
+
+void CBlockCache::Trim()
+{
+    while (nUsage > nMaxUsage && !listLRU.empty()) {
+        std::map<uint256, CEntry>::iterator it = mapEntries.find(listLRU.back());
+        nUsage -= it->second.nUsage;
+        mapEntries.erase(it);
+        listLRU.pop_back();
+    }
+}
+
+void CBlockCache::SetMaxUsage(size_t nMaxUsageIn)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    nMaxUsage = nMaxUsageIn;
+    Trim();
+}
+
+std::shared_ptr<const CBlock> CBlockCache::Get(const uint256& hash)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    std::map<uint256, CEntry>::iterator it = mapEntries.find(hash);
+    if (it == mapEntries.end() || !it->second.pblock) {
+        nMisses++;
+        return std::shared_ptr<const CBlock>();
+    }
+    nHits++;
+    listLRU.splice(listLRU.begin(), listLRU, it->second.itLRU);
+    return it->second.pblock;
+}
+
+void CBlockCache::Insert(const std::shared_ptr<const CBlock>& pblock)
+{
+    const uint256 hash = pblock->GetHash();
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (!nMaxUsage)
+        return;
+    CEntry& entry = Touch(hash);
+    if (entry.pblock)
+        return;
+    entry.pblock = pblock;
+    Resize(entry);
+    Trim();
+}
+
+std::shared_ptr<const std::vector<char> > CBlockCache::GetRaw(const uint256& hash)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    std::map<uint256, CEntry>::iterator it = mapEntries.find(hash);
+    if (it == mapEntries.end() || !it->second.praw) {
+        nRawMisses++;
+        return std::shared_ptr<const std::vector<char> >();
+    }
+    nRawHits++;
+    listLRU.splice(listLRU.begin(), listLRU, it->second.itLRU);
+    return it->second.praw;
+}
+
+void CBlockCache::InsertRaw(const uint256& hash, const std::shared_ptr<const std::vector<char> >& praw)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    if (!nMaxUsage)
+        return;
+    CEntry& entry = Touch(hash);
+    if (entry.praw)
+        return;
+    entry.praw = praw;
+    Resize(entry);
+    Trim();
+}
+
+void CBlockCache::Erase(const uint256& hash)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    std::map<uint256, CEntry>::iterator it = mapEntries.find(hash);
+    if (it == mapEntries.end())
+        return;
+    nUsage -= it->second.nUsage;
+    listLRU.erase(it->second.itLRU);
+    mapEntries.erase(it);
+}
+
+void CBlockCache::Clear()
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    mapEntries.clear();
+    listLRU.clear();
+    nUsage = 0;
+}
+
+CBlockCacheStats CBlockCache::GetStats()
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    CBlockCacheStats stats;
+    stats.nBlocks = mapEntries.size();
+    stats.nUsage = nUsage;
+    stats.nMaxUsage = nMaxUsage;
+    stats.nHits = nHits;
+    stats.nMisses = nMisses;
+    stats.nRawHits = nRawHits;
+    stats.nRawMisses = nRawMisses;
+    return stats;
+}
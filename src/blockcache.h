@@ -0,0 +1,88 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITWIN24_BLOCKCACHE_H
+#define BITWIN24_BLOCKCACHE_H
+
+#include "uint256.h"
+
+#include <list>
+#include <map>
+#include <memory>
+#include <stdint.h>
+#include <vector>
+
+#include <boost/thread/mutex.hpp>
+
+class CBlock;
+
+/** -blockcachesize default, in megabytes */
+static const int64_t DEFAULT_BLOCK_CACHE_SIZE = 32;
+/** Serialized blocks are only cached this close to the tip, older ones are read from disk as they are */
+static const int BLOCK_CACHE_RAW_DEPTH = 16;
+
+/** Hit/miss statistics of the block cache */
+struct CBlockCacheStats
+{
+    size_t nBlocks;
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nRawHits;
+    uint64_t nRawMisses;
+};
+
+/**
+ * Least recently used cache of blocks, shared by every ReadBlockFromDisk caller so recent and hot
+ * blocks are not read and deserialized again for each of them. Next to the deserialized block it can
+ * hold the block's serialized bytes, so blocks requested by many peers are serialized only once.
+ * Both count against the same memory limit.
+ */
+class CBlockCache
+{
+private:
+    struct CEntry {
+        std::shared_ptr<const CBlock> pblock;
+        std::shared_ptr<const std::vector<char> > praw;
+        size_t nUsage;
+        std::list<uint256>::iterator itLRU;
+    };
+
+    boost::mutex cs;
+    std::map<uint256, CEntry> mapEntries;
+    //! Most recently used first
+    std::list<uint256> listLRU;
+    size_t nUsage;
+    size_t nMaxUsage;
+    uint64_t nHits;
+    uint64_t nMisses;
+    uint64_t nRawHits;
+    uint64_t nRawMisses;
+
+    CEntry& Touch(const uint256& hash);
+    void Resize(CEntry& entry);
+    void Trim();
+
+public:
+    CBlockCache();
+
+    void SetMaxUsage(size_t nMaxUsageIn);
+
+    std::shared_ptr<const CBlock> Get(const uint256& hash);
+    void Insert(const std::shared_ptr<const CBlock>& pblock);
+
+    std::shared_ptr<const std::vector<char> > GetRaw(const uint256& hash);
+    void InsertRaw(const uint256& hash, const std::shared_ptr<const std::vector<char> >& praw);
+
+    /** Forget a block, e.g. once it is disconnected from the active chain */
+    void Erase(const uint256& hash);
+    void Clear();
+
+    CBlockCacheStats GetStats();
+};
+
+extern CBlockCache blockcache;
+
+#endif //BITWIN24_BLOCKCACHE_H
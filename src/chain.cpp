@@ -10,6 +10,40 @@
 
 using namespace std;
 
+/**
+ * CBlockIndexArena implementation
+ */
+CBlockIndex* CBlockIndexArena::NextSlot()
+{
+    if (nUsedInChunk == ENTRIES_PER_CHUNK) {
+        vChunks.push_back(static_cast<CBlockIndex*>(::operator new(ENTRIES_PER_CHUNK * sizeof(CBlockIndex))));
+        nUsedInChunk = 0;
+    }
+    return vChunks.back() + nUsedInChunk;
+}
+
+void CBlockIndexArena::Clear()
+{
+    for (size_t i = 0; i < vChunks.size(); i++) {
+        size_t nEntries = i + 1 == vChunks.size() ? nUsedInChunk : ENTRIES_PER_CHUNK;
+        for (size_t j = 0; j < nEntries; j++)
+            vChunks[i][j].~CBlockIndex();
+        ::operator delete(vChunks[i]);
+    }
+    vChunks.clear();
+    nUsedInChunk = ENTRIES_PER_CHUNK;
+}
+
+size_t CBlockIndexArena::size() const
+{
+    return vChunks.empty() ? 0 : (vChunks.size() - 1) * ENTRIES_PER_CHUNK + nUsedInChunk;
+}
+
+size_t CBlockIndexArena::DynamicUsage() const
+{
+    return vChunks.size() * ENTRIES_PER_CHUNK * sizeof(CBlockIndex) + vChunks.capacity() * sizeof(CBlockIndex*);
+}
+
 /**
  * CChain implementation
  */
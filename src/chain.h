@@ -16,6 +16,8 @@
 #include "util.h"
 #include "libzerocoin/Denominations.h"
 
+#include <new>
+#include <stdexcept>
 #include <vector>
 
 #include <boost/foreach.hpp>
@@ -102,6 +104,82 @@ enum BlockStatus {
     BLOCK_FAILED_MASK = BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
 };
 
+/**
+ * Zerocoin supply of each denomination. Held in a fixed array rather than a std::map, which cost
+ * every block index entry a heap node per denomination; it serializes exactly like the map did.
+ */
+class CZerocoinSupply
+{
+private:
+    int64_t anSupply[8];
+
+    static int Position(libzerocoin::CoinDenomination denom)
+    {
+        for (unsigned int i = 0; i < libzerocoin::zerocoinDenomList.size(); i++) {
+            if (libzerocoin::zerocoinDenomList[i] == denom)
+                return i;
+        }
+        return -1;
+    }
+
+public:
+    CZerocoinSupply()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        for (int64_t& nSupply : anSupply)
+            nSupply = 0;
+    }
+
+    int64_t& at(libzerocoin::CoinDenomination denom)
+    {
+        int nPos = Position(denom);
+        if (nPos < 0)
+            throw std::out_of_range("CZerocoinSupply::at() : invalid denomination");
+        return anSupply[nPos];
+    }
+
+    const int64_t& at(libzerocoin::CoinDenomination denom) const
+    {
+        return const_cast<CZerocoinSupply*>(this)->at(denom);
+    }
+
+    unsigned int GetSerializeSize(int nType, int nVersion) const
+    {
+        return GetSizeOfCompactSize(libzerocoin::zerocoinDenomList.size()) +
+               libzerocoin::zerocoinDenomList.size() * (::GetSerializeSize(libzerocoin::ZQ_ONE, nType, nVersion) + sizeof(int64_t));
+    }
+
+    template <typename Stream>
+    void Serialize(Stream& s, int nType, int nVersion) const
+    {
+        WriteCompactSize(s, libzerocoin::zerocoinDenomList.size());
+        for (unsigned int i = 0; i < libzerocoin::zerocoinDenomList.size(); i++) {
+            ::Serialize(s, libzerocoin::zerocoinDenomList[i], nType, nVersion);
+            ::Serialize(s, anSupply[i], nType, nVersion);
+        }
+    }
+
+    template <typename Stream>
+    void Unserialize(Stream& s, int nType, int nVersion)
+    {
+        SetNull();
+        uint64_t nSize = ReadCompactSize(s);
+        for (uint64_t i = 0; i < nSize; i++) {
+            libzerocoin::CoinDenomination denom;
+            int64_t nSupply;
+            ::Unserialize(s, denom, nType, nVersion);
+            ::Unserialize(s, nSupply, nType, nVersion);
+            int nPos = Position(denom);
+            if (nPos >= 0)
+                anSupply[nPos] = nSupply;
+        }
+    }
+};
+
 /** The block chain is a tree shaped structure starting with the
  * genesis block at the root, with each block potentially having multiple
  * candidates to be the next block. A blockindex may have multiple pprev pointing
@@ -122,9 +200,6 @@ public:
     //! pointer to the index of some further predecessor of this block
     CBlockIndex* pskip;
 
-    //ppcoin: trust score of block chain
-    uint256 bnChainTrust;
-
     //! height of the entry in the chain. The genesis block has height 0
     int nHeight;
 
@@ -181,7 +256,8 @@ public:
     uint32_t nSequenceId;
     
     //! zerocoin specific fields
-    std::map<libzerocoin::CoinDenomination, int64_t> mapZerocoinSupply;
+    CZerocoinSupply mapZerocoinSupply;
+    //! denomination of each mint, in block order; empty, and so without a heap allocation, in blocks without mints
     std::vector<libzerocoin::CoinDenomination> vMintDenominationsInBlock;
     
     void SetNull()
@@ -214,9 +290,7 @@ public:
         nNonce = 0;
         nAccumulatorCheckpoint = 0;
         // Start supply of each denomination with 0s
-        for (auto& denom : libzerocoin::zerocoinDenomList) {
-            mapZerocoinSupply.insert(make_pair(denom, 0));
-        }
+        mapZerocoinSupply.SetNull();
         vMintDenominationsInBlock.clear();
     }
 
@@ -238,7 +312,6 @@ public:
             nAccumulatorCheckpoint = block.nAccumulatorCheckpoint;
 
         //Proof of Stake
-        bnChainTrust = uint256();
         nMint = 0;
         nMoneySupply = 0;
         nFlags = 0;
@@ -512,6 +585,43 @@ public:
     }
 };
 
+/**
+ * Owner of the block index entries. Entries are constructed in place in large chunks, so loading
+ * millions of headers costs a few hundred allocations instead of one per entry and keeps the index
+ * contiguous. Entries are not freed one by one; Clear() destroys all of them at once.
+ */
+class CBlockIndexArena
+{
+private:
+    static const size_t ENTRIES_PER_CHUNK = 4096;
+
+    std::vector<CBlockIndex*> vChunks;
+    //! Entries constructed in the last chunk
+    size_t nUsedInChunk;
+
+    CBlockIndex* NextSlot();
+
+    CBlockIndexArena(const CBlockIndexArena&);
+    CBlockIndexArena& operator=(const CBlockIndexArena&);
+
+public:
+    CBlockIndexArena() : nUsedInChunk(ENTRIES_PER_CHUNK) {}
+    ~CBlockIndexArena() { Clear(); }
+
+    template <typename... Args>
+    CBlockIndex* New(Args&&... args)
+    {
+        CBlockIndex* pindex = new (NextSlot()) CBlockIndex(std::forward<Args>(args)...);
+        nUsedInChunk++;
+        return pindex;
+    }
+
+    void Clear();
+
+    size_t size() const;
+    size_t DynamicUsage() const;
+};
+
 /** An in-memory indexed chain of blocks. */
 class CChain
 {
@@ -10,6 +10,8 @@
 #define BITCOIN_COINS_H
 
 #include "compressor.h"
+#include "core_memusage.h"
+#include "poolalloc.h"
 #include "script/standard.h"
 #include "serialize.h"
 #include "uint256.h"
@@ -286,6 +288,14 @@ public:
                 return false;
         return true;
     }
+
+    size_t DynamicMemoryUsage() const
+    {
+        size_t ret = memusage::DynamicUsage(vout);
+        BOOST_FOREACH (const CTxOut& out, vout)
+            ret += RecursiveDynamicUsage(out.scriptPubKey);
+        return ret;
+    }
 };
 
 class CCoinsKeyHasher
@@ -319,7 +329,13 @@ struct CCoinsCacheEntry {
     CCoinsCacheEntry() : coins(), flags(0) {}
 };
 
-typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher> CCoinsMap;
+typedef boost::unordered_map<uint256, CCoinsCacheEntry, CCoinsKeyHasher, std::equal_to<uint256>,
+    CPoolAllocator<std::pair<const uint256, CCoinsCacheEntry> > > CCoinsMap;
+
+/** -coinscachepool default */
+static const bool DEFAULT_COINS_CACHE_POOL = true;
+/** Whether coins caches allocate their entries from a CPoolResource, set at startup */
+extern bool fCoinsCachePool;
 
 struct CCoinsStats {
     int nHeight;
@@ -401,7 +417,8 @@ class CCoinsModifier
 private:
     CCoinsViewCache& cache;
     CCoinsMap::iterator it;
-    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_);
+    size_t cachedCoinUsage; // Cached memory usage of the CCoins object before modification
+    CCoinsModifier(CCoinsViewCache& cache_, CCoinsMap::iterator it_, size_t usage);
 
 public:
     CCoins* operator->() { return &it->second.coins; }
@@ -422,8 +439,13 @@ protected:
      * declared as "const".  
      */
     mutable uint256 hashBlock;
+    //! Entry storage of cacheCoins, null when pooling is off
+    std::shared_ptr<CPoolResource> pool;
     mutable CCoinsMap cacheCoins;
 
+    /* Cached dynamic memory usage for the inner CCoins objects. */
+    mutable size_t cachedCoinsUsage;
+
 public:
     CCoinsViewCache(CCoinsView* baseIn);
     ~CCoinsViewCache();
@@ -459,6 +481,12 @@ public:
     //! Calculate the size of the cache (in number of transactions)
     unsigned int GetCacheSize() const;
 
+    //! Bytes held by the entry pool, 0 when pooling is off
+    size_t GetPoolUsage() const;
+
+    //! Calculate the size of the cache (in bytes)
+    size_t DynamicMemoryUsage() const;
+
     /** 
      * Amount of bitwin24 coming in to a transaction
      * Note that lightweight clients may not know anything besides the hash of previous transactions,
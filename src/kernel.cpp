@@ -8,10 +8,13 @@
 #include <boost/assign/list_of.hpp>
 #include <boost/lexical_cast.hpp>
 
+#include "checkqueue.h"
+#include "crypto/common.h"
 #include "db.h"
 #include "kernel.h"
 #include "script/interpreter.h"
 #include "timedata.h"
+#include "txdb.h"
 #include "util.h"
 #include "stakeinput.h"
 #include "zbwichain.h"
@@ -36,6 +39,9 @@ unsigned int getIntervalVersion(bool fTestNet)
 static std::map<int, unsigned int> mapStakeModifierCheckpoints =
     boost::assign::map_list_of(0, 0xfd11f4e7u);
 
+// Set by the validation signal when the active tip moves, so a stake search can stop without cs_main
+static std::atomic<bool> fStakeTipChanged(false);
+
 // Get time weight
 int64_t GetWeight(int64_t nIntervalBeginning, int64_t nIntervalEnd)
 {
@@ -65,7 +71,7 @@ static int64_t GetStakeModifierSelectionIntervalSection(int nSection)
 }
 
 // Get stake modifier selection interval (in seconds)
-static int64_t GetStakeModifierSelectionInterval()
+int64_t GetStakeModifierSelectionInterval()
 {
     int64_t nSelectionInterval = 0;
     for (int nSection = 0; nSection < 64; nSection++) {
@@ -243,8 +249,113 @@ bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeMod
     return true;
 }
 
-// The stake modifier used to hash for a stake kernel is chosen as the stake
-// modifier about a selection interval later than the coin generating the kernel
+namespace {
+
+/**
+ * Lookup structures for GetKernelStakeModifier, which otherwise walks the active chain forward from the
+ * block being staked from on every call. Keeps the modifier-generating blocks of the active chain in
+ * height order, together with the running maximum of their block times, so that the first generating
+ * block past the selection interval is found by binary search. Results are also remembered per
+ * hashBlockFrom for as long as the block they point to stays in the active chain, dropping the least
+ * recently used ones beyond MAX_CACHED_BLOCKS.
+ */
+class CStakeModifierCache
+{
+private:
+    std::vector<const CBlockIndex*> vGenerated;
+    std::vector<int64_t> vMaxTime; //! maximum block time of vGenerated[0..i]
+    const CBlockIndex* pindexScanned;
+
+    struct CEntry {
+        const CBlockIndex* pindexModifier;
+        std::list<uint256>::iterator itLRU;
+    };
+    std::map<uint256, CEntry> mapModifierBlock;
+    std::list<uint256> listLRU; //! most recently used hashBlockFrom first
+    CCriticalSection cs_modifiercache;
+
+    static const size_t MAX_CACHED_BLOCKS = 50000;
+
+    //! bring vGenerated in line with the active chain, rewinding past a reorg first
+    void Sync()
+    {
+        if (pindexScanned && !chainActive.Contains(pindexScanned))
+            pindexScanned = chainActive.FindFork(pindexScanned);
+
+        int nHeightScanned = pindexScanned ? pindexScanned->nHeight : -1;
+        while (!vGenerated.empty() && vGenerated.back()->nHeight > nHeightScanned) {
+            vGenerated.pop_back();
+            vMaxTime.pop_back();
+        }
+
+        for (const CBlockIndex* pindex = chainActive[nHeightScanned + 1]; pindex; pindex = chainActive.Next(pindex)) {
+            if (pindex->GeneratedStakeModifier()) {
+                vGenerated.push_back(pindex);
+                vMaxTime.push_back(vMaxTime.empty() ? pindex->GetBlockTime() : std::max(vMaxTime.back(), pindex->GetBlockTime()));
+            }
+            pindexScanned = pindex;
+        }
+    }
+
+public:
+    CStakeModifierCache() : pindexScanned(nullptr) {}
+
+    //! the first modifier-generating block of the active chain above pindexFrom with a block time of at least nTime
+    const CBlockIndex* Find(const CBlockIndex* pindexFrom, int64_t nTime)
+    {
+        LOCK(cs_modifiercache);
+        auto itCached = mapModifierBlock.find(pindexFrom->GetBlockHash());
+        if (itCached != mapModifierBlock.end() && chainActive.Contains(itCached->second.pindexModifier)) {
+            listLRU.splice(listLRU.begin(), listLRU, itCached->second.itLRU);
+            return itCached->second.pindexModifier;
+        }
+
+        Sync();
+
+        auto itFirst = std::upper_bound(vGenerated.begin(), vGenerated.end(), pindexFrom->nHeight,
+            [](int nHeight, const CBlockIndex* pindex) { return nHeight < pindex->nHeight; });
+        size_t nFirst = itFirst - vGenerated.begin();
+
+        size_t nFound = vGenerated.size();
+        if (nFirst == 0 || vMaxTime[nFirst - 1] < nTime) {
+            // No earlier block reaches nTime, so the running maximum first does at the block we look for
+            nFound = std::lower_bound(vMaxTime.begin() + nFirst, vMaxTime.end(), nTime) - vMaxTime.begin();
+        } else {
+            // An earlier block has a time beyond nTime, fall back to scanning the generating blocks
+            for (size_t i = nFirst; i < vGenerated.size(); i++) {
+                if (vGenerated[i]->GetBlockTime() >= nTime) {
+                    nFound = i;
+                    break;
+                }
+            }
+        }
+
+        if (nFound == vGenerated.size())
+            return nullptr;
+
+        if (itCached == mapModifierBlock.end()) {
+            listLRU.push_front(pindexFrom->GetBlockHash());
+            itCached = mapModifierBlock.insert(std::make_pair(pindexFrom->GetBlockHash(), CEntry())).first;
+            itCached->second.itLRU = listLRU.begin();
+        } else {
+            listLRU.splice(listLRU.begin(), listLRU, itCached->second.itLRU);
+        }
+        itCached->second.pindexModifier = vGenerated[nFound];
+
+        while (mapModifierBlock.size() > MAX_CACHED_BLOCKS) {
+            mapModifierBlock.erase(listLRU.back());
+            listLRU.pop_back();
+        }
+        return vGenerated[nFound];
+    }
+};
+
+CStakeModifierCache stakeModifierCache;
+
+}
+
+// The stake modifier used to hash a stake from pindexFrom is the one of the first block on the active chain
+// after it that generated a modifier at least a selection interval later
 bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake)
 {
     nStakeModifier = 0;
@@ -255,21 +366,16 @@ bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int
     nStakeModifierTime = pindexFrom->GetBlockTime();
     int64_t nStakeModifierSelectionInterval = GetStakeModifierSelectionInterval();
     const CBlockIndex* pindex = pindexFrom;
-    CBlockIndex* pindexNext = chainActive[pindexFrom->nHeight + 1];
 
-    // loop to find the stake modifier later by a selection interval
-    while (nStakeModifierTime < pindexFrom->GetBlockTime() + nStakeModifierSelectionInterval) {
-        if (!pindexNext) {
+    if (nStakeModifierSelectionInterval > 0) {
+        pindex = stakeModifierCache.Find(pindexFrom, pindexFrom->GetBlockTime() + nStakeModifierSelectionInterval);
+        if (!pindex) {
             // Should never happen
             return error("Null pindexNext\n");
         }
 
-        pindex = pindexNext;
-        pindexNext = chainActive[pindexNext->nHeight + 1];
-        if (pindex->GeneratedStakeModifier()) {
-            nStakeModifierHeight = pindex->nHeight;
-            nStakeModifierTime = pindex->GetBlockTime();
-        }
+        nStakeModifierHeight = pindex->nHeight;
+        nStakeModifierTime = pindex->GetBlockTime();
     }
     nStakeModifier = pindex->nStakeModifier;
     return true;
@@ -296,7 +402,7 @@ bool CheckStake(const CDataStream& ssUniqueID, CAmount nValueIn, const uint64_t
     return stakeTargetHit(hashProofOfStake, nValueIn, bnTarget);
 }
 
-bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockFrom, unsigned int& nTimeTx, uint256& hashProofOfStake)
+bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockFrom, unsigned int& nTimeTx, uint256& hashProofOfStake, unsigned int nTimeSearchedTo)
 {
     if (nTimeTx < nTimeBlockFrom)
         return error("CheckStakeKernelHash() : nTime violation");
@@ -316,18 +422,28 @@ bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockF
 
     bool fSuccess = false;
     unsigned int nTryTime = 0;
-    int nHeightStart = chainActive.Height();
-    int nHashDrift = 30;
+    int nHeightStart;
+    fStakeTipChanged = false;
+    {
+        LOCK(cs_main);
+        nHeightStart = chainActive.Height();
+    }
+    int nHashDrift = STAKE_HASH_DRIFT;
+    // an input that only reached its min age after the previous pass started was not hashed by it
+    if (nTimeBlockFrom + nStakeMinAge + nHashDrift > nTimeSearchedTo)
+        nTimeSearchedTo = 0;
     CDataStream ssUniqueID = stakeInput->GetUniqueness();
     CAmount nValueIn = stakeInput->GetValue();
     for (int i = 0; i < nHashDrift; i++) //iterate the hashing
     {
         //new block came in, move on
-        if (chainActive.Height() != nHeightStart)
+        if (fStakeTipChanged)
             break;
 
         //hash this iteration
         nTryTime = nTimeTx + nHashDrift - i;
+        if (nTryTime <= nTimeSearchedTo)
+            break;
 
         // if stake hash does not meet the target then continue to next iteration
         if (!CheckStake(ssUniqueID, nValueIn, nStakeModifier, bnTargetPerCoinDay, nTimeBlockFrom, nTryTime, hashProofOfStake))
@@ -340,10 +456,234 @@ bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockF
     }
 
     mapHashedBlocks.clear();
-    mapHashedBlocks[chainActive.Tip()->nHeight] = GetTime(); //store a time stamp of when we last hashed on this block
+    mapHashedBlocks[nHeightStart] = GetTime(); //store a time stamp of when we last hashed on this block
     return fSuccess;
 }
 
+bool CStakeKernelTable::IsStale(const CBlockIndex* pindexTip, unsigned int nBitsIn, int64_t nTime) const
+{
+    // inputs that reach their min age are only picked up by a rebuild, so don't keep a table for long
+    return !pindexTip || pindexTip->GetBlockHash() != hashTip || nBitsIn != nBits || nTime - nTimeBuilt > 60;
+}
+
+void CStakeKernelTable::Build(std::list<std::unique_ptr<CStakeInput> >& listInputsIn, const CBlockIndex* pindexTip, unsigned int nBitsIn, int64_t nTime)
+{
+    std::map<std::vector<unsigned char>, unsigned int> mapSearchedTo;
+    if (pindexTip->GetBlockHash() == hashTip && nBitsIn == nBits) {
+        for (const CCandidate& candidate : vCandidates)
+            mapSearchedTo[candidate.vchKernel] = candidate.nTimeSearchedTo;
+    }
+
+    Clear();
+    listInputs.swap(listInputsIn);
+    hashTip = pindexTip->GetBlockHash();
+    nBits = nBitsIn;
+    nTimeBuilt = nTime;
+
+    uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits);
+
+    vCandidates.reserve(listInputs.size());
+    for (std::unique_ptr<CStakeInput>& stakeInput : listInputs) {
+        CBlockIndex* pindex = stakeInput->GetIndexFrom();
+        if (!pindex || pindex->nHeight < 1) {
+            LogPrintf("*** no pindexfrom\n");
+            continue;
+        }
+
+        uint64_t nStakeModifier = 0;
+        if (!stakeInput->GetModifier(nStakeModifier)) {
+            LogPrint("staking", "%s : failed to get kernel stake modifier\n", __func__);
+            continue;
+        }
+
+        // same serialization as CheckStake, with nTimeTx filled in by the sweep
+        CCandidate candidate;
+        candidate.pinput = stakeInput.get();
+        candidate.nTimeBlockFrom = pindex->GetBlockTime();
+        CDataStream ss(SER_GETHASH, 0);
+        ss << nStakeModifier << candidate.nTimeBlockFrom << stakeInput->GetUniqueness() << (unsigned int)0;
+        candidate.vchKernel.assign(ss.begin(), ss.end());
+        candidate.bnTarget = (uint256(stakeInput->GetValue()) / 100) * bnTargetPerCoinDay;
+
+        std::map<std::vector<unsigned char>, unsigned int>::const_iterator it = mapSearchedTo.find(candidate.vchKernel);
+        candidate.nTimeSearchedTo = it != mapSearchedTo.end() ? it->second : 0;
+        vCandidates.push_back(candidate);
+    }
+    LogPrint("staking", "%s : %u kernel candidates at height %d\n", __func__, vCandidates.size(), pindexTip->nHeight);
+}
+
+void CStakeKernelTable::Clear()
+{
+    vCandidates.clear();
+    listInputs.clear();
+    hashTip = 0;
+    nBits = 0;
+    nTimeBuilt = 0;
+}
+
+// One shard of a sweep, run on the stake kernel check queue
+class CStakeKernelCheck
+{
+private:
+    CStakeKernelTable* ptable;
+    size_t nBegin;
+    size_t nEnd;
+    unsigned int nTimeTx;
+    CStakeKernelTable::CSweepResult* presult;
+
+public:
+    CStakeKernelCheck() : ptable(nullptr), nBegin(0), nEnd(0), nTimeTx(0), presult(nullptr) {}
+    CStakeKernelCheck(CStakeKernelTable* ptableIn, size_t nBeginIn, size_t nEndIn, unsigned int nTimeTxIn, CStakeKernelTable::CSweepResult* presultIn) :
+        ptable(ptableIn), nBegin(nBeginIn), nEnd(nEndIn), nTimeTx(nTimeTxIn), presult(presultIn) {}
+
+    bool operator()()
+    {
+        return ptable->SweepRange(nBegin, nEnd, nTimeTx, *presult);
+    }
+
+    void swap(CStakeKernelCheck& check)
+    {
+        std::swap(ptable, check.ptable);
+        std::swap(nBegin, check.nBegin);
+        std::swap(nEnd, check.nEnd);
+        std::swap(nTimeTx, check.nTimeTx);
+        std::swap(presult, check.presult);
+    }
+};
+
+namespace
+{
+// candidates per shard, also how often a shard checks for a new tip
+const size_t STAKE_SWEEP_SHARD_SIZE = 256;
+
+// A shard that finds a kernel returns false, which makes the queue skip the remaining shards
+CCheckQueue<CStakeKernelCheck> stakekernelcheckqueue(4);
+}
+
+int nStakeThreads = DEFAULT_STAKE_THREADS;
+
+void ThreadStakeKernelCheck()
+{
+    RenameThread("bitwin24-stakecheck");
+    stakekernelcheckqueue.Thread();
+}
+
+void StakeKernelTipChanged(const CBlockIndex* pindexNew)
+{
+    fStakeTipChanged = true;
+}
+
+bool CStakeKernelTable::SweepRange(size_t nBegin, size_t nEnd, unsigned int nTimeTx, CSweepResult& result)
+{
+    unsigned int nTimeTo = nTimeTx + STAKE_HASH_DRIFT;
+    for (size_t i = nBegin; i < nEnd; i++) {
+        if (result.fFound)
+            return false;
+
+        //new block came in, move on
+        if ((i - nBegin) % STAKE_SWEEP_SHARD_SIZE == 0 && fStakeTipChanged)
+            return true;
+
+        CCandidate& candidate = vCandidates[i];
+        if (candidate.nTimeSearchedTo >= nTimeTo || candidate.nTimeBlockFrom + nStakeMinAge > nTimeTx)
+            continue;
+
+        unsigned int nTimeFrom = std::max(candidate.nTimeSearchedTo, nTimeTx);
+        unsigned char* pchTime = &candidate.vchKernel[candidate.vchKernel.size() - 4];
+        for (unsigned int nTryTime = nTimeTo; nTryTime > nTimeFrom; nTryTime--) {
+            WriteLE32(pchTime, nTryTime);
+            uint256 hash = HashX11(candidate.vchKernel.begin(), candidate.vchKernel.end());
+            if (hash < candidate.bnTarget) {
+                boost::unique_lock<boost::mutex> lock(result.mutex);
+                // if another shard got there first, leave this kernel to be found again by the next sweep
+                if (result.fFound)
+                    return false;
+                result.nCandidate = i;
+                result.nTimeTx = nTryTime;
+                result.hashProofOfStake = hash;
+                result.fFound = true;
+                candidate.nTimeSearchedTo = nTimeTo;
+                return false;
+            }
+        }
+        candidate.nTimeSearchedTo = nTimeTo;
+    }
+    return true;
+}
+
+CStakeInput* CStakeKernelTable::Sweep(unsigned int& nTimeTx, uint256& hashProofOfStake)
+{
+    // check the tip once under the lock, after that the shards only watch the flag
+    int nHeightTip;
+    fStakeTipChanged = false;
+    {
+        LOCK(cs_main);
+        if (chainActive.Tip()->GetBlockHash() != hashTip)
+            return nullptr;
+        nHeightTip = chainActive.Height();
+    }
+
+    CSweepResult result;
+    if (nStakeThreads > 1 && vCandidates.size() > STAKE_SWEEP_SHARD_SIZE) {
+        std::vector<CStakeKernelCheck> vChecks;
+        vChecks.reserve(vCandidates.size() / STAKE_SWEEP_SHARD_SIZE + 1);
+        // the queue hands out shards from the back, so add them back to front
+        for (size_t nEnd = vCandidates.size(); nEnd > 0; nEnd -= std::min(nEnd, STAKE_SWEEP_SHARD_SIZE))
+            vChecks.push_back(CStakeKernelCheck(this, nEnd - std::min(nEnd, STAKE_SWEEP_SHARD_SIZE), nEnd, nTimeTx, &result));
+
+        CCheckQueueControl<CStakeKernelCheck> control(&stakekernelcheckqueue);
+        control.Add(vChecks);
+        control.Wait();
+    } else {
+        SweepRange(0, vCandidates.size(), nTimeTx, result);
+    }
+
+    mapHashedBlocks.clear();
+    mapHashedBlocks[nHeightTip] = GetTime(); //store a time stamp of when we last hashed on this block
+
+    if (!result.fFound)
+        return nullptr;
+    nTimeTx = result.nTimeTx;
+    hashProofOfStake = result.hashProofOfStake;
+    return vCandidates[result.nCandidate].pinput;
+}
+
+// Find the output a coinstake kernel spends and the block it was created in,
+// without reading either the previous transaction or its block from disk
+bool GetKernelInput(const COutPoint& prevout, CTxOut& txout, CBlockIndex*& pindexFrom)
+{
+    LOCK(cs_main);
+
+    // Unspent: the coins view knows the output and its height
+    const CCoins* coins = pcoinsTip->AccessCoins(prevout.hash);
+    if (coins && coins->IsAvailable(prevout.n) && chainActive[coins->nHeight]) {
+        txout = coins->vout[prevout.n];
+        pindexFrom = chainActive[coins->nHeight];
+        return true;
+    }
+
+    // Already staked on the active chain, e.g. by a competing block at the same height
+    uint256 hashBlockFrom;
+    if (pblocktree->ReadStakeInput(prevout, hashBlockFrom, txout)) {
+        BlockMap::const_iterator mi = mapBlockIndex.find(hashBlockFrom);
+        if (mi != mapBlockIndex.end() && chainActive.Contains(mi->second)) {
+            pindexFrom = mi->second;
+            return true;
+        }
+    }
+
+    // Fall back to the transaction index or a block scan
+    uint256 hashBlock;
+    CTransaction txPrev;
+    if (!GetTransaction(prevout.hash, txPrev, hashBlock, true) || prevout.n >= txPrev.vout.size())
+        return false;
+    txout = txPrev.vout[prevout.n];
+    BlockMap::const_iterator mi = mapBlockIndex.find(hashBlock);
+    pindexFrom = mi != mapBlockIndex.end() && chainActive.Contains(mi->second) ? mi->second : nullptr;
+    return true;
+}
+
 // Check kernel hash target and coinstake signature
 bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::unique_ptr<CStakeInput>& stake)
 {
@@ -362,18 +702,17 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
 
         stake = std::unique_ptr<CStakeInput>(new CZBWIStake(spend));
     } else {
-        // First try finding the previous transaction in database
-        uint256 hashBlock;
-        CTransaction txPrev;
-        if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
+        CTxOut txoutPrev;
+        CBlockIndex* pindexFrom = nullptr;
+        if (!GetKernelInput(txin.prevout, txoutPrev, pindexFrom))
             return error("CheckProofOfStake() : INFO: read txPrev failed");
 
         //verify signature and script
-        if (!VerifyScript(txin.scriptSig, txPrev.vout[txin.prevout.n].scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
+        if (!VerifyScript(txin.scriptSig, txoutPrev.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
             return error("CheckProofOfStake() : VerifySignature failed on coinstake %s", tx.GetHash().ToString().c_str());
 
         CBitWin24Stake* bitwin24Input = new CBitWin24Stake();
-        bitwin24Input->SetInput(txPrev, txin.prevout.n);
+        bitwin24Input->SetInput(txin.prevout, txoutPrev, pindexFrom);
         stake = std::unique_ptr<CStakeInput>(bitwin24Input);
     }
 
@@ -381,11 +720,6 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
     if (!pindex)
         return error("%s: Failed to find the block index", __func__);
 
-    // Read block header
-    CBlock blockprev;
-    if (!ReadBlockFromDisk(blockprev, pindex->GetBlockPos()))
-        return error("CheckProofOfStake(): INFO: failed to find block");
-
     uint256 bnTargetPerCoinDay;
     bnTargetPerCoinDay.SetCompact(block.nBits);
 
@@ -393,7 +727,7 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
     if (!stake->GetModifier(nStakeModifier))
         return error("%s failed to get modifier for stake input\n", __func__);
 
-    unsigned int nBlockFromTime = blockprev.nTime;
+    unsigned int nBlockFromTime = pindex->nTime;
     unsigned int nTxTime = block.nTime;
     if (!CheckStake(stake->GetUniqueness(), stake->GetValue(), nStakeModifier, bnTargetPerCoinDay, nBlockFromTime,
                     nTxTime, hashProofOfStake)) {
@@ -10,6 +10,11 @@
 #include "main.h"
 #include "stakeinput.h"
 
+#include <atomic>
+#include <list>
+
+#include <boost/thread/mutex.hpp>
+
 
 // MODIFIER_INTERVAL: time to elapse before new modifier is computed
 static const unsigned int MODIFIER_INTERVAL = 60;
@@ -21,13 +26,87 @@ extern unsigned int getIntervalVersion(bool fTestNet);
 // ratio of group interval length between the last group and the first group
 static const int MODIFIER_INTERVAL_RATIO = 3;
 
+// STAKE_HASH_DRIFT: how far ahead of the adjusted time a coinstake timestamp is hashed
+static const int STAKE_HASH_DRIFT = 30;
+
+// -stakethreads default and maximum number of kernel search threads, including the stake minter
+static const int DEFAULT_STAKE_THREADS = 1;
+static const int MAX_STAKE_THREADS = 16;
+extern int nStakeThreads;
+
+// Worker thread for sharded kernel searches
+void ThreadStakeKernelCheck();
+// Connected to the UpdatedBlockTip signal, stops running kernel searches
+void StakeKernelTipChanged(const CBlockIndex* pindexNew);
+
+// Get stake modifier selection interval (in seconds)
+int64_t GetStakeModifierSelectionInterval();
+
 // Compute the hash modifier for proof-of-stake
 bool GetKernelStakeModifier(uint256 hashBlockFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight, int64_t& nStakeModifierTime, bool fPrintProofOfStake);
 bool ComputeNextStakeModifier(const CBlockIndex* pindexPrev, uint64_t& nStakeModifier, bool& fGeneratedStakeModifier);
 
 bool CheckStake(const CDataStream& ssUniqueID, CAmount nValueIn, const uint64_t nStakeModifier, const uint256& bnTarget, unsigned int nTimeBlockFrom, unsigned int& nTimeTx, uint256& hashProofOfStake);
 bool stakeTargetHit(uint256 hashProofOfStake, int64_t nValueIn, uint256 bnTargetPerCoinDay);
-bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockFrom, unsigned int& nTimeTx, uint256& hashProofOfStake);
+// Hash the timestamps (nTimeTx, nTimeTx + STAKE_HASH_DRIFT], latest first, skipping those
+// at or below nTimeSearchedTo that an earlier pass already hashed for this input
+bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockFrom, unsigned int& nTimeTx, uint256& hashProofOfStake, unsigned int nTimeSearchedTo = 0);
+
+/**
+ * The wallet's stake inputs reduced to what the kernel hash needs, built once per tip.
+ * Each sweep only hashes the timestamps that entered the hash drift window since the last one.
+ */
+class CStakeKernelTable
+{
+    friend class CStakeKernelCheck;
+
+private:
+    struct CCandidate {
+        CStakeInput* pinput;
+        std::vector<unsigned char> vchKernel; // nStakeModifier, nTimeBlockFrom and uniqueness, followed by nTimeTx
+        unsigned int nTimeBlockFrom;
+        uint256 bnTarget;             // target weighted by the input value
+        unsigned int nTimeSearchedTo; // every timestamp up to here has been hashed
+    };
+
+    // First kernel found by any of the shards of a sweep
+    struct CSweepResult {
+        std::atomic<bool> fFound;
+        boost::mutex mutex;
+        size_t nCandidate;
+        unsigned int nTimeTx;
+        uint256 hashProofOfStake;
+
+        CSweepResult() : fFound(false), nCandidate(0), nTimeTx(0), hashProofOfStake(0) {}
+    };
+
+    std::list<std::unique_ptr<CStakeInput> > listInputs;
+    std::vector<CCandidate> vCandidates;
+    uint256 hashTip;
+    unsigned int nBits;
+    int64_t nTimeBuilt;
+
+    // Sweep the candidates [nBegin, nEnd). Returns false once any shard found a kernel.
+    bool SweepRange(size_t nBegin, size_t nEnd, unsigned int nTimeTx, CSweepResult& result);
+
+public:
+    CStakeKernelTable() : hashTip(0), nBits(0), nTimeBuilt(0) {}
+
+    // Whether the table belongs to another tip or target, or may be missing inputs that matured since
+    bool IsStale(const CBlockIndex* pindexTip, unsigned int nBitsIn, int64_t nTime) const;
+    // Replace the candidates, keeping the sweep progress of inputs that stay in the table
+    void Build(std::list<std::unique_ptr<CStakeInput> >& listInputsIn, const CBlockIndex* pindexTip, unsigned int nBitsIn, int64_t nTime);
+    void Clear();
+    // Hash the timestamps in (nTimeTx, nTimeTx + STAKE_HASH_DRIFT] not hashed before, latest first,
+    // resuming after the previous hit. Large tables are sharded over nStakeThreads threads.
+    // Returns the input whose kernel meets the target, or nullptr.
+    CStakeInput* Sweep(unsigned int& nTimeTx, uint256& hashProofOfStake);
+    size_t size() const { return vCandidates.size(); }
+};
+
+// Find the output a coinstake kernel spends and the block it was created in:
+// the coins view first, then the stake input index, then GetTransaction
+bool GetKernelInput(const COutPoint& prevout, CTxOut& txout, CBlockIndex*& pindexFrom);
 
 // Check kernel hash target and coinstake signature
 // Sets hashProofOfStake on success return
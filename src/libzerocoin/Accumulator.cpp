@@ -43,7 +43,30 @@ Accumulator::Accumulator(const ZerocoinParams* p, const CoinDenomination d, cons
 
 void Accumulator::increment(const CBigNum& bnValue) {
     // Compute new accumulator = "old accumulator"^{element} mod N
-    this->value = this->value.pow_mod(bnValue, this->params->accumulatorModulus);
+    if (this->params->accumulatorModulusContext)
+        this->value = this->value.pow_mod(bnValue, *this->params->accumulatorModulusContext);
+    else
+        this->value = this->value.pow_mod(bnValue, this->params->accumulatorModulus);
+}
+
+void Accumulator::increment(const std::vector<CBigNum>& vValues) {
+    if (vValues.empty())
+        return;
+
+    // Multiplying the exponents is cheap next to a modular exponentiation.
+    // Multiply them pairwise so the operands of each product stay balanced.
+    std::vector<CBigNum> vProduct(vValues);
+    while (vProduct.size() > 1) {
+        std::vector<CBigNum> vNext;
+        vNext.reserve((vProduct.size() + 1) / 2);
+        for (size_t i = 0; i + 1 < vProduct.size(); i += 2)
+            vNext.push_back(vProduct[i] * vProduct[i + 1]);
+        if (vProduct.size() % 2)
+            vNext.push_back(vProduct.back());
+        vProduct.swap(vNext);
+    }
+
+    increment(vProduct[0]);
 }
 
 void Accumulator::accumulate(const PublicCoin& coin) {
@@ -62,6 +62,15 @@ public:
     void accumulate(const PublicCoin &coin);
     void increment(const CBigNum& bnValue);
 
+    /**
+     * Accumulate several raw values with a single exponentiation, by
+     * raising the accumulator to the product of the values. The result
+     * is the same as calling increment() for each of them.
+     *
+     * @param vValues    the pubcoin values to accumulate, not validated.
+     **/
+    void increment(const std::vector<CBigNum>& vValues);
+
     CoinDenomination getDenomination() const;
     /** Get the accumulator result
      *
@@ -16,6 +16,13 @@
 
 namespace libzerocoin {
 
+/** prod(bases[i]^exps[i]) mod the accumulator modulus */
+static CBigNum AccumulatorMultiPow(const AccumulatorAndProofParams* params, const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps) {
+	if (params->accumulatorModulusContext)
+		return CBigNum::pow_mod_multi(bases, exps, *params->accumulatorModulusContext);
+	return CBigNum::pow_mod_multi(bases, exps, params->accumulatorModulus);
+}
+
 AccumulatorProofOfKnowledge::AccumulatorProofOfKnowledge(const AccumulatorAndProofParams* p): params(p) {}
 
 AccumulatorProofOfKnowledge::AccumulatorProofOfKnowledge(const AccumulatorAndProofParams* p,
@@ -118,14 +125,17 @@ bool AccumulatorProofOfKnowledge:: Verify(const Accumulator& a, const CBigNum& v
 
 	CBigNum c = CBigNum(hasher.GetHash()); //this hash should be of length k_prime bits
 
-	CBigNum st_1_prime = (valueOfCommitmentToCoin.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * sg.pow_mod(s_alpha, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(s_phi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	CBigNum st_2_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * ((valueOfCommitmentToCoin * sg.inverse(params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(s_gamma, params->accumulatorPoKCommitmentGroup.modulus)) * sh.pow_mod(s_psi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	CBigNum st_3_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * (sg * valueOfCommitmentToCoin).pow_mod(s_sigma, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(s_xi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-
-	CBigNum t_1_prime = (C_r.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_zeta, params->accumulatorModulus) * g_n.pow_mod(s_epsilon, params->accumulatorModulus)) % params->accumulatorModulus;
-	CBigNum t_2_prime = (C_e.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_eta, params->accumulatorModulus) * g_n.pow_mod(s_alpha, params->accumulatorModulus)) % params->accumulatorModulus;
-	CBigNum t_3_prime = ((a.getValue()).pow_mod(c, params->accumulatorModulus) * C_u.pow_mod(s_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) % params->accumulatorModulus;
-	CBigNum t_4_prime = (C_r.pow_mod(s_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_delta, params->accumulatorModulus)) * ((g_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) % params->accumulatorModulus;
+	// Each of these is a product of three powers: compute them as one multi-exponentiation
+	const IntegerGroupParams& pok = params->accumulatorPoKCommitmentGroup;
+	CBigNum st_1_prime = pok.multiPowMod({valueOfCommitmentToCoin, sg, sh}, {c, s_alpha, s_phi});
+	CBigNum st_2_prime = pok.multiPowMod({sg, valueOfCommitmentToCoin * sg.inverse(pok.modulus), sh}, {c, s_gamma, s_psi});
+	CBigNum st_3_prime = pok.multiPowMod({sg, sg * valueOfCommitmentToCoin, sh}, {c, s_sigma, s_xi});
+
+	CBigNum h_n_inverse = h_n.inverse(params->accumulatorModulus);
+	CBigNum t_1_prime = AccumulatorMultiPow(params, {C_r, h_n, g_n}, {c, s_zeta, s_epsilon});
+	CBigNum t_2_prime = AccumulatorMultiPow(params, {C_e, h_n, g_n}, {c, s_eta, s_alpha});
+	CBigNum t_3_prime = AccumulatorMultiPow(params, {a.getValue(), C_u, h_n_inverse}, {c, s_alpha, s_beta});
+	CBigNum t_4_prime = AccumulatorMultiPow(params, {C_r, h_n_inverse, g_n.inverse(params->accumulatorModulus)}, {s_alpha, s_delta, s_beta});
 
 	bool result_st1 = (st_1 == st_1_prime);
 	bool result_st2 = (st_2 == st_2_prime);
@@ -26,6 +26,12 @@ ZerocoinParams::ZerocoinParams(CBigNum N, uint32_t securityLevel) {
 	// Generate the parameters
 	CalculateParams(*this, N, ZEROCOIN_PROTOCOL_VERSION, securityLevel);
 
+	// Precompute the tables for the generators of the commitment groups
+	this->coinCommitmentGroup.precompute();
+	this->serialNumberSoKCommitmentGroup.precompute();
+	this->accumulatorParams.accumulatorPoKCommitmentGroup.precompute();
+	this->accumulatorParams.accumulatorModulusContext = std::make_shared<const CBigNumModulus>(this->accumulatorParams.accumulatorModulus);
+
 	this->accumulatorParams.initialized = true;
 	this->initialized = true;
 }
@@ -42,7 +48,44 @@ CBigNum IntegerGroupParams::randomElement() const {
 	// The generator of the group raised
 	// to a random number less than the order of the group
 	// provides us with a uniformly distributed random number.
-	return this->g.pow_mod(CBigNum::randBignum(this->groupOrder),this->modulus);
+	return this->gPow(CBigNum::randBignum(this->groupOrder));
+}
+
+void IntegerGroupParams::precompute() {
+	this->modulusContext = std::make_shared<const CBigNumModulus>(this->modulus);
+
+	// The tables reduce exponents modulo the group order, which is only
+	// correct if both generators really have an order dividing it.
+	if (!this->g.pow_mod(this->groupOrder, this->modulus).isOne() ||
+	        !this->h.pow_mod(this->groupOrder, this->modulus).isOne())
+		return;
+
+	this->gTable = std::make_shared<const CBigNumFixedBase>(this->g, this->modulusContext, this->groupOrder);
+	this->hTable = std::make_shared<const CBigNumFixedBase>(this->h, this->modulusContext, this->groupOrder);
+}
+
+CBigNum IntegerGroupParams::gPow(const CBigNum& e) const {
+	if (this->gTable)
+		return this->gTable->pow_mod(e);
+	return this->g.pow_mod(e, this->modulus);
+}
+
+CBigNum IntegerGroupParams::hPow(const CBigNum& e) const {
+	if (this->hTable)
+		return this->hTable->pow_mod(e);
+	return this->h.pow_mod(e, this->modulus);
+}
+
+CBigNum IntegerGroupParams::powMod(const CBigNum& base, const CBigNum& e) const {
+	if (this->modulusContext)
+		return base.pow_mod(e, *this->modulusContext);
+	return base.pow_mod(e, this->modulus);
+}
+
+CBigNum IntegerGroupParams::multiPowMod(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps) const {
+	if (this->modulusContext)
+		return CBigNum::pow_mod_multi(bases, exps, *this->modulusContext);
+	return CBigNum::pow_mod_multi(bases, exps, this->modulus);
 }
 
 } /* namespace libzerocoin */
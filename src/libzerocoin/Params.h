@@ -56,6 +56,39 @@ public:
 	 */
 	CBigNum groupOrder;
 
+	/**
+	 * Cached context for the modulus and fixed-base tables for g and h.
+	 * Filled in by precompute(), not serialized.
+	 */
+	std::shared_ptr<const CBigNumModulus> modulusContext;
+	std::shared_ptr<const CBigNumFixedBase> gTable;
+	std::shared_ptr<const CBigNumFixedBase> hTable;
+
+	/**
+	 * Builds the fixed-base tables for g and h and the modulus context.
+	 */
+	void precompute();
+
+	/**
+	 * @return g^e mod modulus
+	 */
+	CBigNum gPow(const CBigNum& e) const;
+
+	/**
+	 * @return h^e mod modulus
+	 */
+	CBigNum hPow(const CBigNum& e) const;
+
+	/**
+	 * @return base^e mod modulus
+	 */
+	CBigNum powMod(const CBigNum& base, const CBigNum& e) const;
+
+	/**
+	 * @return prod(bases[i]^exps[i]) mod modulus, for verifiers only
+	 */
+	CBigNum multiPowMod(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps) const;
+
 	ADD_SERIALIZE_METHODS;
   template <typename Stream, typename Operation>  inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
 		    READWRITE(initialized);
@@ -128,6 +161,11 @@ public:
 	 */
 	IntegerGroupParams accumulatorQRNCommitmentGroup;
 
+	/**
+	 * Cached context for accumulatorModulus, not serialized.
+	 */
+	std::shared_ptr<const CBigNumModulus> accumulatorModulusContext;
+
 	/**
 	 * Security parameter.
 	 * Bit length of the challenges used in the accumulator proof.
@@ -13,9 +13,84 @@
 
 #include <streams.h>
 #include "SerialNumberSignatureOfKnowledge.h"
+#include "checkqueue.h"
+
+#include <atomic>
+#include <functional>
 
 namespace libzerocoin {
 
+namespace {
+
+/** One iteration of a signature of knowledge, run on the SoK check queue */
+class CSoKIterationCheck
+{
+private:
+	const std::function<void(uint32_t)>* pfunc;
+	uint32_t nIteration;
+
+public:
+	CSoKIterationCheck() : pfunc(NULL), nIteration(0) {}
+	CSoKIterationCheck(const std::function<void(uint32_t)>& func, uint32_t nIterationIn) : pfunc(&func), nIteration(nIterationIn) {}
+
+	bool operator()() {
+		try {
+			(*pfunc)(nIteration);
+		} catch (const std::exception&) {
+			return false;
+		}
+		return true;
+	}
+
+	void swap(CSoKIterationCheck& check) {
+		std::swap(pfunc, check.pfunc);
+		std::swap(nIteration, check.nIteration);
+	}
+};
+
+CCheckQueue<CSoKIterationCheck> sokcheckqueue(4);
+// The queue serves one master at a time; callers that find it busy run serially
+boost::mutex cs_sokcheckqueue;
+std::atomic<int> nSoKCheckThreads(0);
+
+/**
+ * Runs func(i) for every i < nIterations, spread over the SoK worker threads
+ * when there are any and no other proof is using them. Results must be stored
+ * per iteration by func; anything order dependent happens after this returns.
+ */
+void RunSoKIterations(uint32_t nIterations, const std::function<void(uint32_t)>& func) {
+	if (nSoKCheckThreads > 0) {
+		boost::unique_lock<boost::mutex> lock(cs_sokcheckqueue, boost::try_to_lock);
+		if (lock.owns_lock()) {
+			std::vector<CSoKIterationCheck> vChecks;
+			vChecks.reserve(nIterations);
+			for (uint32_t i = 0; i < nIterations; i++)
+				vChecks.push_back(CSoKIterationCheck(func, i));
+			CCheckQueueControl<CSoKIterationCheck> control(&sokcheckqueue);
+			control.Add(vChecks);
+			if (control.Wait())
+				return;
+			// An iteration threw: redo the work here so the exception reaches the caller
+		}
+	}
+
+	for (uint32_t i = 0; i < nIterations; i++)
+		func(i);
+}
+
+} // anon namespace
+
+void ThreadSerialNumberSoKCheck() {
+	nSoKCheckThreads++;
+	try {
+		sokcheckqueue.Thread();
+	} catch (...) {
+		// interrupted on shutdown
+		nSoKCheckThreads--;
+		throw;
+	}
+}
+
 SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const ZerocoinParams* p): params(p) { }
 
 // Use one 256 bit seed and concatenate 4 unique 256 bit hashes to make a 1024 bit hash
@@ -50,11 +125,6 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
 		throw std::runtime_error("Groups are not structured correctly.");
 	}
 
-	CBigNum a = params->coinCommitmentGroup.g;
-	CBigNum b = params->coinCommitmentGroup.h;
-	CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-	CBigNum h = params->serialNumberSoKCommitmentGroup.h;
-
 	CHashWriter hasher(0,0);
 	hasher << *params << commitmentToCoin.getCommitmentValue() << coin.getSerialNumber() << msghash;
 
@@ -80,21 +150,20 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
         }
 	}
 
-	for(uint32_t i=0; i < params->zkp_iterations; i++) {
+	RunSoKIterations(params->zkp_iterations, [&](uint32_t i) {
 		// compute g^{ {a^x b^r} h^v} mod p2
 		c[i] = challengeCalculation(coin.getSerialNumber(), r[i], v_expanded[i]);
-	}
+	});
 
-	// We can't hash data in parallel either
-	// because OPENMP cannot not guarantee loops
-	// execute in order.
+	// The iterations above may run on several threads, but the
+	// hash has to be taken over the results in order.
 	for(uint32_t i=0; i < params->zkp_iterations; i++) {
 		hasher << c[i];
 	}
 	this->hash = hasher.GetHash();
 	unsigned char *hashbytes =  (unsigned char*) &hash;
 
-	for(uint32_t i = 0; i < params->zkp_iterations; i++) {
+	RunSoKIterations(params->zkp_iterations, [&](uint32_t i) {
 		int bit = i % 8;
 		int byte = i / 8;
 
@@ -105,50 +174,41 @@ SerialNumberSignatureOfKnowledge::SerialNumberSignatureOfKnowledge(const
 		} else {
 			s_notprime[i]       = r[i] - coin.getRandomness();
 			sprime[i]           = v_expanded[i] - (commitmentToCoin.getRandomness() *
-			                              b.pow_mod(r[i] - coin.getRandomness(), params->serialNumberSoKCommitmentGroup.groupOrder));
+			                              params->coinCommitmentGroup.hPow(r[i] - coin.getRandomness()));
 		}
-	}
+	});
 }
 
 inline CBigNum SerialNumberSignatureOfKnowledge::challengeCalculation(const CBigNum& a_exp,const CBigNum& b_exp,
         const CBigNum& h_exp) const {
 
-	CBigNum a = params->coinCommitmentGroup.g;
-	CBigNum b = params->coinCommitmentGroup.h;
-	CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-	CBigNum h = params->serialNumberSoKCommitmentGroup.h;
+	// a = coinCommitmentGroup.g and b = coinCommitmentGroup.h, whose modulus is
+	// the order of the SoK group, so both sides can use the fixed-base tables.
+	CBigNum exponent = (params->coinCommitmentGroup.gPow(a_exp)
+	                   * params->coinCommitmentGroup.hPow(b_exp)) % params->serialNumberSoKCommitmentGroup.groupOrder;
 
-	CBigNum exponent = (a.pow_mod(a_exp, params->serialNumberSoKCommitmentGroup.groupOrder)
-	                   * b.pow_mod(b_exp, params->serialNumberSoKCommitmentGroup.groupOrder)) % params->serialNumberSoKCommitmentGroup.groupOrder;
-
-	return (g.pow_mod(exponent, params->serialNumberSoKCommitmentGroup.modulus) * h.pow_mod(h_exp, params->serialNumberSoKCommitmentGroup.modulus)) % params->serialNumberSoKCommitmentGroup.modulus;
+	return (params->serialNumberSoKCommitmentGroup.gPow(exponent) * params->serialNumberSoKCommitmentGroup.hPow(h_exp)) % params->serialNumberSoKCommitmentGroup.modulus;
 }
 
 bool SerialNumberSignatureOfKnowledge::Verify(const CBigNum& coinSerialNumber, const CBigNum& valueOfCommitmentToCoin,
         const uint256 msghash) const {
-	CBigNum a = params->coinCommitmentGroup.g;
-	CBigNum b = params->coinCommitmentGroup.h;
-	CBigNum g = params->serialNumberSoKCommitmentGroup.g;
-	CBigNum h = params->serialNumberSoKCommitmentGroup.h;
 	CHashWriter hasher(0,0);
 	hasher << *params << valueOfCommitmentToCoin << coinSerialNumber << msghash;
 
 	vector<CBigNum> tprime(params->zkp_iterations);
 	unsigned char *hashbytes = (unsigned char*) &this->hash;
 
-	for(uint32_t i = 0; i < params->zkp_iterations; i++) {
+	RunSoKIterations(params->zkp_iterations, [&](uint32_t i) {
 		int bit = i % 8;
 		int byte = i / 8;
 		bool challenge_bit = ((hashbytes[byte] >> bit) & 0x01);
 		if(challenge_bit) {
 			tprime[i] = challengeCalculation(coinSerialNumber, s_notprime[i], SeedTo1024(sprime[i].getuint256()));
 		} else {
-			CBigNum exp = b.pow_mod(s_notprime[i], params->serialNumberSoKCommitmentGroup.groupOrder);
-			tprime[i] = ((valueOfCommitmentToCoin.pow_mod(exp, params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus) *
-			             (h.pow_mod(sprime[i], params->serialNumberSoKCommitmentGroup.modulus) % params->serialNumberSoKCommitmentGroup.modulus)) %
-			            params->serialNumberSoKCommitmentGroup.modulus;
+			CBigNum exp = params->coinCommitmentGroup.hPow(s_notprime[i]);
+			tprime[i] = params->serialNumberSoKCommitmentGroup.multiPowMod({valueOfCommitmentToCoin, params->serialNumberSoKCommitmentGroup.h}, {exp, sprime[i]});
 		}
-	}
+	});
 	for(uint32_t i = 0; i < params->zkp_iterations; i++) {
 		hasher << tprime[i];
 	}
@@ -71,5 +71,12 @@ private:
 	                                   const CBigNum& h_exp) const;
 };
 
+/**
+ * Worker loop that computes signature of knowledge iterations in parallel for
+ * proof creation and verification. Without any running worker, proofs are
+ * computed on the calling thread only.
+ */
+void ThreadSerialNumberSoKCheck();
+
 } /* namespace libzerocoin */
 #endif /* SERIALNUMBERPROOF_H_ */
@@ -10,6 +10,8 @@
 #include "bitwin24-config.h"
 #endif
 
+#include <algorithm>
+#include <memory>
 #include <stdexcept>
 #include <vector>
 #if defined(USE_NUM_GMP)
@@ -31,6 +33,9 @@ public:
     explicit bignum_error(const std::string& str) : std::runtime_error(str) {}
 };
 
+class CBigNumModulus;
+class CBigNumFixedBase;
+
 #if defined(USE_NUM_OPENSSL)
 
 
@@ -467,6 +472,25 @@ public:
         return ret;
     }
 
+    /**
+     * modular exponentiation: this^e mod m, reusing the context cached in m
+     * @param e exponent
+     * @param m modulus
+     */
+    CBigNum pow_mod(const CBigNum& e, const CBigNumModulus& m) const;
+
+    /**
+     * simultaneous modular multi-exponentiation: prod(bases[i]^exps[i]) mod m
+     * All terms share one chain of squarings, which is cheaper than multiplying
+     * separate pow_mod results. The running time depends on the exponents, so
+     * only use it where they are public, i.e. when verifying proofs.
+     * @param bases the bases
+     * @param exps the exponents, one for each base
+     * @param m modulus
+     */
+    static CBigNum pow_mod_multi(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps, const CBigNum& m);
+    static CBigNum pow_mod_multi(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps, const CBigNumModulus& m);
+
    /**
     * Calculates the inverse of this element mod m.
     * i.e. i such this*i = 1 mod m
@@ -639,6 +663,8 @@ public:
     friend inline bool operator>=(const CBigNum& a, const CBigNum& b);
     friend inline bool operator<(const CBigNum& a, const CBigNum& b);
     friend inline bool operator>(const CBigNum& a, const CBigNum& b);
+    friend class CBigNumModulus;
+    friend class CBigNumFixedBase;
 };
 
 inline const CBigNum operator+(const CBigNum& a, const CBigNum& b)
@@ -714,6 +740,194 @@ inline bool operator<(const CBigNum& a, const CBigNum& b)  { return (BN_cmp(a.bn
 inline bool operator>(const CBigNum& a, const CBigNum& b)  { return (BN_cmp(a.bn, b.bn) > 0); }
 inline std::ostream& operator<<(std::ostream &strm, const CBigNum &b) { return strm << b.ToString(10); }
 
+/**
+ * A modulus together with its Montgomery context, so that repeated exponentiations
+ * modulo the same value do not set up a new context every time.
+ */
+class CBigNumModulus
+{
+private:
+    CBigNum modulus;
+    BN_MONT_CTX* pmont;
+
+    CBigNumModulus(const CBigNumModulus&);
+    CBigNumModulus& operator=(const CBigNumModulus&);
+
+public:
+    explicit CBigNumModulus(const CBigNum& m) : modulus(m), pmont(NULL)
+    {
+        // Montgomery reduction only works for odd moduli, others use plain BN_mod_exp
+        if (!BN_is_odd(modulus.bn))
+            return;
+        CAutoBN_CTX pctx;
+        pmont = BN_MONT_CTX_new();
+        if (pmont == NULL || !BN_MONT_CTX_set(pmont, modulus.bn, pctx)) {
+            if (pmont != NULL)
+                BN_MONT_CTX_free(pmont);
+            throw bignum_error("CBigNumModulus : BN_MONT_CTX_set failed");
+        }
+    }
+
+    ~CBigNumModulus()
+    {
+        if (pmont != NULL)
+            BN_MONT_CTX_free(pmont);
+    }
+
+    const CBigNum& get() const { return modulus; }
+
+    friend class CBigNum;
+    friend class CBigNumFixedBase;
+};
+
+inline CBigNum CBigNum::pow_mod(const CBigNum& e, const CBigNumModulus& m) const
+{
+    if (m.pmont == NULL)
+        return pow_mod(e, m.modulus);
+
+    CAutoBN_CTX pctx;
+    CBigNum ret;
+    if (e < 0) {
+        // g^-x = (g^-1)^x
+        CBigNum inv = this->inverse(m.modulus);
+        CBigNum posE = e * -1;
+        if (!BN_mod_exp_mont(ret.bn, inv.bn, posE.bn, m.modulus.bn, pctx, m.pmont))
+            throw bignum_error("CBigNum::pow_mod: BN_mod_exp_mont failed on negative exponent");
+    } else if (!BN_mod_exp_mont(ret.bn, bn, e.bn, m.modulus.bn, pctx, m.pmont))
+        throw bignum_error("CBigNum::pow_mod : BN_mod_exp_mont failed");
+
+    return ret;
+}
+
+inline CBigNum CBigNum::pow_mod_multi(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps, const CBigNum& m)
+{
+    CBigNumModulus modulus(m);
+    return pow_mod_multi(bases, exps, modulus);
+}
+
+inline CBigNum CBigNum::pow_mod_multi(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps, const CBigNumModulus& m)
+{
+    if (bases.size() != exps.size())
+        throw bignum_error("CBigNum::pow_mod_multi : number of bases and exponents differ");
+
+    const CBigNum& mod = m.modulus;
+    CBigNum ret = CBigNum(1) % mod;
+    if (m.pmont == NULL) {
+        for (size_t i = 0; i < bases.size(); i++)
+            ret = ret.mul_mod(bases[i].pow_mod(exps[i], mod), mod);
+        return ret;
+    }
+
+    // BN_mod_exp2_mont wants non-negative exponents, and would turn 0^0 into 0:
+    // invert the base for negative exponents and drop terms with a zero exponent
+    CAutoBN_CTX pctx;
+    std::vector<CBigNum> vBases, vExps;
+    for (size_t i = 0; i < bases.size(); i++) {
+        if (exps[i] == 0)
+            continue;
+        if (exps[i] < 0) {
+            vBases.push_back(bases[i].inverse(mod));
+            vExps.push_back(exps[i] * -1);
+        } else {
+            vBases.push_back(bases[i]);
+            vExps.push_back(exps[i]);
+        }
+        if (!BN_nnmod(vBases.back().bn, vBases.back().bn, mod.bn, pctx))
+            throw bignum_error("CBigNum::pow_mod_multi : BN_nnmod failed");
+    }
+
+    CBigNum term;
+    size_t i = 0;
+    for (; i + 1 < vBases.size(); i += 2) {
+        if (!BN_mod_exp2_mont(term.bn, vBases[i].bn, vExps[i].bn, vBases[i + 1].bn, vExps[i + 1].bn, mod.bn, pctx, m.pmont))
+            throw bignum_error("CBigNum::pow_mod_multi : BN_mod_exp2_mont failed");
+        ret = ret.mul_mod(term, mod);
+    }
+    if (i < vBases.size()) {
+        if (!BN_mod_exp_mont(term.bn, vBases[i].bn, vExps[i].bn, mod.bn, pctx, m.pmont))
+            throw bignum_error("CBigNum::pow_mod_multi : BN_mod_exp_mont failed");
+        ret = ret.mul_mod(term, mod);
+    }
+    return ret;
+}
+
+/**
+ * Precomputed powers of a fixed base, for fast exponentiation of group generators.
+ * The table holds base^(d * 2^(i * nWindowBits)) for every window i and digit d, so
+ * base^e is a product of one table entry per window of e: no squarings are needed.
+ * Exponents are first reduced modulo the order of the base, which also covers negative ones.
+ */
+class CBigNumFixedBase
+{
+private:
+    std::shared_ptr<const CBigNumModulus> pmodulus;
+    CBigNum order;
+    unsigned int nWindowBits;
+    unsigned int nWindows;
+    unsigned int nEntries;
+    //! vTable[i * nEntries + d], in Montgomery form
+    std::vector<CBigNum> vTable;
+
+public:
+    CBigNumFixedBase(const CBigNum& base, const std::shared_ptr<const CBigNumModulus>& pmodulusIn, const CBigNum& orderIn, unsigned int nWindowBitsIn = 4) :
+        pmodulus(pmodulusIn), order(orderIn), nWindowBits(nWindowBitsIn)
+    {
+        if (!pmodulus || pmodulus->pmont == NULL)
+            throw bignum_error("CBigNumFixedBase : modulus must be odd");
+        if (order <= 1 || nWindowBits == 0 || nWindowBits > 8)
+            throw bignum_error("CBigNumFixedBase : invalid order or window size");
+
+        CAutoBN_CTX pctx;
+        nEntries = 1U << nWindowBits;
+        nWindows = (order.bitSize() + nWindowBits - 1) / nWindowBits;
+        vTable.resize(nWindows * nEntries);
+
+        CBigNum one = 1;
+        CBigNum windowBase = base % pmodulus->modulus;
+        if (!BN_to_montgomery(one.bn, one.bn, pmodulus->pmont, pctx) ||
+            !BN_to_montgomery(windowBase.bn, windowBase.bn, pmodulus->pmont, pctx))
+            throw bignum_error("CBigNumFixedBase : BN_to_montgomery failed");
+
+        for (unsigned int i = 0; i < nWindows; i++) {
+            CBigNum* pWindow = &vTable[i * nEntries];
+            pWindow[0] = one;
+            pWindow[1] = windowBase;
+            for (unsigned int d = 2; d < nEntries; d++) {
+                if (!BN_mod_mul_montgomery(pWindow[d].bn, pWindow[d - 1].bn, windowBase.bn, pmodulus->pmont, pctx))
+                    throw bignum_error("CBigNumFixedBase : BN_mod_mul_montgomery failed");
+            }
+            // base for the next window: windowBase^(2^nWindowBits)
+            if (!BN_mod_mul_montgomery(windowBase.bn, pWindow[nEntries - 1].bn, windowBase.bn, pmodulus->pmont, pctx))
+                throw bignum_error("CBigNumFixedBase : BN_mod_mul_montgomery failed");
+        }
+    }
+
+    /**
+     * fixed-base modular exponentiation: base^e mod modulus
+     * @param e exponent
+     */
+    CBigNum pow_mod(const CBigNum& e) const
+    {
+        CAutoBN_CTX pctx;
+        CBigNum exp = e % order;
+        CBigNum acc = vTable[0];
+        for (unsigned int i = 0; i < nWindows; i++) {
+            unsigned int d = 0;
+            for (unsigned int b = 0; b < nWindowBits; b++)
+                d |= (BN_is_bit_set(exp.bn, i * nWindowBits + b) ? 1U : 0U) << b;
+            if (d && !BN_mod_mul_montgomery(acc.bn, acc.bn, vTable[i * nEntries + d].bn, pmodulus->pmont, pctx))
+                throw bignum_error("CBigNumFixedBase::pow_mod : BN_mod_mul_montgomery failed");
+        }
+
+        CBigNum ret;
+        if (!BN_from_montgomery(ret.bn, acc.bn, pmodulus->pmont, pctx))
+            throw bignum_error("CBigNumFixedBase::pow_mod : BN_from_montgomery failed");
+        return ret;
+    }
+
+    const CBigNum& getModulus() const { return pmodulus->get(); }
+};
+
 #endif
 #if defined(USE_NUM_GMP)
 /** C++ wrapper for BIGNUM (Gmp bignum) */
@@ -983,6 +1197,25 @@ public:
         return ret;
     }
 
+    /**
+     * modular exponentiation: this^e mod m, reusing the context cached in m
+     * @param e exponent
+     * @param m modulus
+     */
+    CBigNum pow_mod(const CBigNum& e, const CBigNumModulus& m) const;
+
+    /**
+     * simultaneous modular multi-exponentiation: prod(bases[i]^exps[i]) mod m
+     * All terms share one chain of squarings, which is cheaper than multiplying
+     * separate pow_mod results. The running time depends on the exponents, so
+     * only use it where they are public, i.e. when verifying proofs.
+     * @param bases the bases
+     * @param exps the exponents, one for each base
+     * @param m modulus
+     */
+    static CBigNum pow_mod_multi(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps, const CBigNum& m);
+    static CBigNum pow_mod_multi(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps, const CBigNumModulus& m);
+
    /**
     * Calculates the inverse of this element mod m.
     * i.e. i such this*i = 1 mod m
@@ -1126,6 +1359,8 @@ public:
     friend inline bool operator>=(const CBigNum& a, const CBigNum& b);
     friend inline bool operator<(const CBigNum& a, const CBigNum& b);
     friend inline bool operator>(const CBigNum& a, const CBigNum& b);
+    friend class CBigNumModulus;
+    friend class CBigNumFixedBase;
 };
 
 inline const CBigNum operator+(const CBigNum& a, const CBigNum& b)
@@ -1191,6 +1426,270 @@ inline bool operator>=(const CBigNum& a, const CBigNum& b) { return (mpz_cmp(a.b
 inline bool operator<(const CBigNum& a, const CBigNum& b)  { return (mpz_cmp(a.bn, b.bn) < 0); }
 inline bool operator>(const CBigNum& a, const CBigNum& b)  { return (mpz_cmp(a.bn, b.bn) > 0); }
 inline std::ostream& operator<<(std::ostream &strm, const CBigNum &b) { return strm << b.ToString(10); }
+
+/**
+ * A modulus for pow_mod, pow_mod_multi and CBigNumFixedBase. GMP keeps its own
+ * reduction state inside mpz_powm, so for pow_mod this only mirrors the OpenSSL
+ * interface; for odd moduli it also holds what pow_mod_multi needs for
+ * Montgomery multiplication on the raw limbs.
+ */
+class CBigNumModulus
+{
+private:
+    CBigNum modulus;
+    mp_size_t nLimbs;
+    //! -modulus^-1 mod 2^GMP_NUMB_BITS, or 0 when Montgomery reduction cannot be used
+    mp_limb_t minv;
+
+    CBigNumModulus(const CBigNumModulus&);
+    CBigNumModulus& operator=(const CBigNumModulus&);
+
+    //! r = t / 2^(nLimbs * GMP_NUMB_BITS) mod modulus; t holds 2 * nLimbs limbs and is clobbered
+    void redc(mp_limb_t* r, mp_limb_t* t) const
+    {
+        const mp_limb_t* mp = mpz_limbs_read(modulus.bn);
+        for (mp_size_t i = 0; i < nLimbs; i++)
+            t[i] = mpn_addmul_1(t + i, mp, nLimbs, t[i] * minv);
+        if (mpn_add_n(r, t + nLimbs, t, nLimbs) || mpn_cmp(r, mp, nLimbs) >= 0)
+            mpn_sub_n(r, r, mp, nLimbs);
+    }
+
+    void mont_mul(mp_limb_t* r, const mp_limb_t* a, const mp_limb_t* b, mp_limb_t* scratch) const
+    {
+        mpn_mul_n(scratch, a, b, nLimbs);
+        redc(r, scratch);
+    }
+
+    void mont_sqr(mp_limb_t* r, const mp_limb_t* a, mp_limb_t* scratch) const
+    {
+        mpn_sqr(scratch, a, nLimbs);
+        redc(r, scratch);
+    }
+
+    void to_mont(mp_limb_t* r, const CBigNum& a) const
+    {
+        CBigNum t;
+        mpz_mul_2exp(t.bn, a.bn, nLimbs * GMP_NUMB_BITS);
+        mpz_mod(t.bn, t.bn, modulus.bn);
+        for (mp_size_t j = 0; j < nLimbs; j++)
+            r[j] = mpz_getlimbn(t.bn, j);
+    }
+
+    void from_mont(CBigNum& r, const mp_limb_t* a, mp_limb_t* scratch) const
+    {
+        mpn_copyi(scratch, a, nLimbs);
+        mpn_zero(scratch + nLimbs, nLimbs);
+        redc(mpz_limbs_write(r.bn, nLimbs), scratch);
+        mpz_limbs_finish(r.bn, nLimbs);
+    }
+
+public:
+    explicit CBigNumModulus(const CBigNum& m) : modulus(m), nLimbs(mpz_size(m.bn)), minv(0)
+    {
+#if GMP_NAIL_BITS == 0
+        if (modulus > 1 && mpz_odd_p(modulus.bn)) {
+            // Newton iteration for the inverse of the low limb, doubling the correct bits each step
+            mp_limb_t m0 = mpz_getlimbn(modulus.bn, 0);
+            mp_limb_t inv = m0;
+            for (int i = 0; i < 6; i++)
+                inv *= 2 - m0 * inv;
+            minv = -inv;
+        }
+#endif
+    }
+
+    const CBigNum& get() const { return modulus; }
+
+    friend class CBigNum;
+    friend class CBigNumFixedBase;
+};
+
+inline CBigNum CBigNum::pow_mod(const CBigNum& e, const CBigNumModulus& m) const
+{
+    return pow_mod(e, m.modulus);
+}
+
+inline CBigNum CBigNum::pow_mod_multi(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps, const CBigNum& m)
+{
+    CBigNumModulus modulus(m);
+    return pow_mod_multi(bases, exps, modulus);
+}
+
+/**
+ * Interleaved sliding windows (Straus): every exponent is cut into odd windows of
+ * up to nWindowBits bits, each base gets a table of its odd powers, and a single
+ * pass over the bits squares the accumulator once and multiplies in the table
+ * entry of every window ending at that bit.
+ */
+inline CBigNum CBigNum::pow_mod_multi(const std::vector<CBigNum>& bases, const std::vector<CBigNum>& exps, const CBigNumModulus& m)
+{
+    if (bases.size() != exps.size())
+        throw bignum_error("CBigNum::pow_mod_multi : number of bases and exponents differ");
+
+    const CBigNum& mod = m.modulus;
+    CBigNum ret = CBigNum(1) % mod;
+    if (m.minv == 0) {
+        for (size_t i = 0; i < bases.size(); i++)
+            ret = ret.mul_mod(bases[i].pow_mod(exps[i], mod), mod);
+        return ret;
+    }
+
+    const mp_size_t n = m.nLimbs;
+    //! odd powers base^1, base^3, ... of each base, in Montgomery form
+    std::vector<std::vector<mp_limb_t> > vTables;
+    //! (lowest bit, odd digit) of each window of each exponent, most significant first
+    std::vector<std::vector<std::pair<size_t, unsigned int> > > vWindows;
+    std::vector<mp_limb_t> vAcc(n), vSquare(n), vScratch(2 * n);
+    size_t nMaxBits = 0;
+
+    CBigNum base, e;
+    for (size_t i = 0; i < bases.size(); i++) {
+        if (exps[i] == 0)
+            continue;
+        mpz_mod(base.bn, bases[i].bn, mod.bn);
+        e = exps[i];
+        if (e < 0) {
+            // g^-x = (g^-1)^x; without an inverse leave the term to pow_mod
+            if (mpz_invert(base.bn, base.bn, mod.bn) == 0) {
+                ret = ret.mul_mod(bases[i].pow_mod(exps[i], mod), mod);
+                continue;
+            }
+            mpz_neg(e.bn, e.bn);
+        }
+
+        const size_t nBits = mpz_sizeinbase(e.bn, 2);
+        const unsigned int nWindowBits = nBits > 512 ? 5 : nBits > 160 ? 4 : nBits > 48 ? 3 : nBits > 12 ? 2 : 1;
+        nMaxBits = std::max(nMaxBits, nBits);
+
+        vWindows.push_back(std::vector<std::pair<size_t, unsigned int> >());
+        std::vector<std::pair<size_t, unsigned int> >& windows = vWindows.back();
+        size_t top = nBits;
+        while (top > 0) {
+            if (!mpz_tstbit(e.bn, top - 1)) {
+                top--;
+                continue;
+            }
+            size_t low = top > nWindowBits ? top - nWindowBits : 0;
+            while (!mpz_tstbit(e.bn, low))
+                low++;
+            unsigned int digit = 0;
+            for (size_t k = top; k > low; k--)
+                digit = (digit << 1) | mpz_tstbit(e.bn, k - 1);
+            windows.push_back(std::make_pair(low, digit));
+            top = low;
+        }
+
+        vTables.push_back(std::vector<mp_limb_t>(((size_t)1 << (nWindowBits - 1)) * n));
+        std::vector<mp_limb_t>& table = vTables.back();
+        m.to_mont(&table[0], base);
+        m.mont_sqr(&vSquare[0], &table[0], &vScratch[0]);
+        for (size_t j = n; j < table.size(); j += n)
+            m.mont_mul(&table[j], &table[j - n], &vSquare[0], &vScratch[0]);
+    }
+
+    if (vTables.empty())
+        return ret;
+
+    std::vector<size_t> vNext(vTables.size(), 0);
+    bool fStarted = false;
+    for (size_t bit = nMaxBits; bit > 0; bit--) {
+        if (fStarted)
+            m.mont_sqr(&vAcc[0], &vAcc[0], &vScratch[0]);
+        for (size_t k = 0; k < vTables.size(); k++) {
+            if (vNext[k] == vWindows[k].size() || vWindows[k][vNext[k]].first != bit - 1)
+                continue;
+            const mp_limb_t* entry = &vTables[k][(vWindows[k][vNext[k]].second >> 1) * n];
+            if (fStarted) {
+                m.mont_mul(&vAcc[0], &vAcc[0], entry, &vScratch[0]);
+            } else {
+                mpn_copyi(&vAcc[0], entry, n);
+                fStarted = true;
+            }
+            vNext[k]++;
+        }
+    }
+
+    CBigNum product;
+    m.from_mont(product, &vAcc[0], &vScratch[0]);
+    return ret.mul_mod(product, mod);
+}
+
+/**
+ * Precomputed powers of a fixed base, for fast exponentiation of group generators.
+ * The table holds base^(d * 2^(i * nWindowBits)) for every window i and digit d, so
+ * base^e is a product of one table entry per window of e: no squarings are needed.
+ * Exponents are first reduced modulo the order of the base, which also covers negative ones.
+ * Entries are stored as fixed-size limb arrays and picked with mpn_sec_tabselect, so the
+ * memory access pattern does not depend on the (possibly secret) exponent, like mpz_powm_sec.
+ */
+class CBigNumFixedBase
+{
+private:
+    std::shared_ptr<const CBigNumModulus> pmodulus;
+    CBigNum order;
+    unsigned int nWindowBits;
+    unsigned int nWindows;
+    unsigned int nEntries;
+    mp_size_t nLimbs;
+    //! limbs of entry d of window i start at vTable[(i * nEntries + d) * nLimbs]
+    std::vector<mp_limb_t> vTable;
+
+public:
+    CBigNumFixedBase(const CBigNum& base, const std::shared_ptr<const CBigNumModulus>& pmodulusIn, const CBigNum& orderIn, unsigned int nWindowBitsIn = 4) :
+        pmodulus(pmodulusIn), order(orderIn), nWindowBits(nWindowBitsIn)
+    {
+        if (!pmodulus || pmodulus->modulus <= 1)
+            throw bignum_error("CBigNumFixedBase : invalid modulus");
+        if (order <= 1 || nWindowBits == 0 || nWindowBits > 8)
+            throw bignum_error("CBigNumFixedBase : invalid order or window size");
+
+        const CBigNum& m = pmodulus->modulus;
+        nEntries = 1U << nWindowBits;
+        nWindows = (order.bitSize() + nWindowBits - 1) / nWindowBits;
+        nLimbs = mpz_size(m.bn);
+        vTable.resize((size_t)nWindows * nEntries * nLimbs);
+
+        CBigNum windowBase = base % m;
+        CBigNum entry;
+        for (unsigned int i = 0; i < nWindows; i++) {
+            entry = 1;
+            for (unsigned int d = 0; d < nEntries; d++) {
+                if (d > 0)
+                    entry = entry.mul_mod(windowBase, m);
+                mp_limb_t* p = &vTable[((size_t)i * nEntries + d) * nLimbs];
+                for (mp_size_t j = 0; j < nLimbs; j++)
+                    p[j] = mpz_getlimbn(entry.bn, j);
+            }
+            // base for the next window: windowBase^(2^nWindowBits)
+            windowBase = entry.mul_mod(windowBase, m);
+        }
+    }
+
+    /**
+     * fixed-base modular exponentiation: base^e mod modulus
+     * @param e exponent
+     */
+    CBigNum pow_mod(const CBigNum& e) const
+    {
+        const CBigNum& m = pmodulus->modulus;
+        CBigNum exp = e % order;
+        CBigNum acc = 1;
+        CBigNum entry;
+        for (unsigned int i = 0; i < nWindows; i++) {
+            unsigned int d = 0;
+            for (unsigned int b = 0; b < nWindowBits; b++)
+                d |= (unsigned int)mpz_tstbit(exp.bn, i * nWindowBits + b) << b;
+            mp_limb_t* p = mpz_limbs_write(entry.bn, nLimbs);
+            mpn_sec_tabselect(p, &vTable[(size_t)i * nEntries * nLimbs], nLimbs, nEntries, d);
+            mpz_limbs_finish(entry.bn, nLimbs);
+            mpz_mul(acc.bn, acc.bn, entry.bn);
+            mpz_mod(acc.bn, acc.bn, m.bn);
+        }
+        return acc;
+    }
+
+    const CBigNum& getModulus() const { return pmodulus->get(); }
+};
 #endif
 
 typedef CBigNum Bignum;
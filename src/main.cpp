@@ -16,6 +16,7 @@
 #include "blocksignature.h"
 #include "chainparams.h"
 #include "checkpoints.h"
+#include "blockcache.h"
 #include "checkqueue.h"
 #include "init.h"
 #include "kernel.h"
@@ -36,6 +37,7 @@
 #include "utilmoneystr.h"
 #include "validationinterface.h"
 #include "zbwichain.h"
+#include "zbwispendcache.h"
 
 #include "primitives/zerocoin.h"
 #include "libzerocoin/Denominations.h"
@@ -64,6 +66,8 @@ using namespace libzerocoin;
 CCriticalSection cs_main;
 
 BlockMap mapBlockIndex;
+//! Storage of the entries in mapBlockIndex
+static CBlockIndexArena blockIndexArena;
 map<uint256, uint256> mapProofOfStake;
 set<pair<COutPoint, unsigned int> > setStakeSeen;
 map<unsigned int, unsigned int> mapHashedBlocks;
@@ -73,13 +77,14 @@ int64_t nTimeBestReceived = 0;
 CWaitableCriticalSection csBestBlock;
 CConditionVariable cvBlockChange;
 int nScriptCheckThreads = 0;
+int nBlockPrefetch = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
-unsigned int nCoinCacheSize = 5000;
+size_t nCoinCacheUsage = 5000 * 300;
 bool fAlerts = DEFAULT_ALERTS;
 
 unsigned int nStakeMinAge = 60 * 60;
@@ -537,8 +542,10 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 }
 
 CCoinsViewCache* pcoinsTip = NULL;
+CCoinsViewAsyncDB* pcoinsAsync = NULL;
 CBlockTreeDB* pblocktree = NULL;
 CZerocoinDB* zerocoinDB = NULL;
+CZerocoinViewCache* pzerocoinTip = NULL;
 CSporkDB* pSporkDB = NULL;
 
 //////////////////////////////////////////////////////////////////////////////
@@ -894,7 +901,7 @@ bool ContextualCheckZerocoinMint(const CTransaction& tx, const PublicCoin& coin,
         //See if this coin has already been added to the blockchain
         uint256 txid;
         int nHeight;
-        if (zerocoinDB->ReadCoinMint(coin.getValue(), txid) && IsTransactionInChain(txid, nHeight))
+        if (pzerocoinTip->ReadCoinMint(coin.getValue(), txid) && IsTransactionInChain(txid, nHeight))
             return error("%s: pubcoin %s was already accumulated in tx %s", __func__,
                          coin.getValue().GetHex().substr(0, 10),
                          txid.GetHex());
@@ -935,7 +942,18 @@ bool ContextualCheckZerocoinSpend(const CTransaction& tx, const CoinSpend& spend
     return true;
 }
 
-bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state)
+bool CZerocoinSpendCheck::operator()()
+{
+    Accumulator accumulator(Params().Zerocoin_Params(fUseV1Params), pspend->getDenomination(), bnAccumulatorValue);
+
+    //Check that the coin has been accumulated
+    if (!CachingVerifyZerocoinSpend(*pspend, accumulator, fUseV1Params, cacheStore))
+        return ::error("CZerocoinSpendCheck(): zerocoin spend with serial %s did not verify", pspend->getCoinSerialNumber().GetHex());
+
+    return true;
+}
+
+bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvChecks)
 {
     //max needed non-mint outputs should be 2 - one for redemption address and a possible 2nd for change
     if (tx.vout.size() > 2) {
@@ -985,17 +1003,18 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
         if (fVerifySignature) {
             //see if we have record of the accumulator used in the spend tx
             CBigNum bnAccumulatorValue = 0;
-            if (!zerocoinDB->ReadAccumulatorValue(newSpend.getAccumulatorChecksum(), bnAccumulatorValue)) {
+            if (!pzerocoinTip->ReadAccumulatorValue(newSpend.getAccumulatorChecksum(), bnAccumulatorValue)) {
                 uint32_t nChecksum = newSpend.getAccumulatorChecksum();
                 return state.DoS(100, error("%s: Zerocoinspend could not find accumulator associated with checksum %s", __func__, HexStr(BEGIN(nChecksum), END(nChecksum))));
             }
 
-            Accumulator accumulator(Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start()),
-                                    newSpend.getDenomination(), bnAccumulatorValue);
-
-            //Check that the coin has been accumulated
-            if(!newSpend.Verify(accumulator))
-                    return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+            CZerocoinSpendCheck check(newSpend, bnAccumulatorValue, chainActive.Height() < Params().Zerocoin_Block_V2_Start());
+            if (pvChecks) {
+                pvChecks->push_back(CZerocoinSpendCheck());
+                check.swap(pvChecks->back());
+            } else if (!check()) {
+                return state.DoS(100, error("CheckZerocoinSpend(): zerocoin spend did not verify"));
+            }
         }
 
         if (serials.count(newSpend.getCoinSerialNumber()))
@@ -1015,7 +1034,7 @@ bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidati
     return fValidated;
 }
 
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state)
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvZerocoinChecks)
 {
     // Basic checks that don't depend on any context
     if (tx.vin.empty())
@@ -1071,7 +1090,7 @@ bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fReject
 
             // Do not require signature verification if this is initial sync and a block over 24 hours old
             bool fVerifySignature = !IsInitialBlockDownload() && (GetTime() - chainActive.Tip()->GetBlockTime() < (60*60*24));
-            if (!CheckZerocoinSpend(tx, fVerifySignature, state))
+            if (!CheckZerocoinSpend(tx, fVerifySignature, state, pvZerocoinChecks))
                 return state.DoS(100, error("CheckTransaction() : invalid zerocoin spend"));
         }
     }
@@ -1175,9 +1194,13 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
     if ((!Params().ZeroCoinEnabled() || GetAdjustedTime() > GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE)) && tx.ContainsZerocoins())
         return state.DoS(10, error("AcceptToMemoryPool : Zerocoin transactions are temporarily disabled for maintenance"), REJECT_INVALID, "bad-tx");
 
-    if (!CheckTransaction(tx, chainActive.Height() >= Params().Zerocoin_StartHeight(), true, state))
+    std::vector<CZerocoinSpendCheck> vZerocoinChecks;
+    if (!CheckTransaction(tx, chainActive.Height() >= Params().Zerocoin_StartHeight(), true, state, &vZerocoinChecks))
         return state.DoS(100, error("AcceptToMemoryPool: : CheckTransaction failed"), REJECT_INVALID, "bad-tx");
 
+    if (!RunZerocoinSpendChecks(vZerocoinChecks, true))
+        return state.DoS(100, error("AcceptToMemoryPool: : zerocoin spend did not verify"), REJECT_INVALID, "bad-tx");
+
     // Coinbase is only valid in a block, not as a loose transaction
     if (tx.IsCoinBase())
         return state.DoS(100, error("AcceptToMemoryPool: : coinbase as individual tx"),
@@ -1344,6 +1367,13 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
                                         hash.ToString(), nFees, txMinFee),
                     REJECT_INSUFFICIENTFEE, "insufficient fee");
 
+            // Once the pool had to evict, only transactions paying more than the evicted ones get in
+            CAmount mempoolRejectFee = pool.GetMinFee(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) << 20).GetFee(nSize);
+            if (mempoolRejectFee > 0 && nFees < mempoolRejectFee && !tx.IsZerocoinSpend())
+                return state.DoS(0, error("AcceptToMemoryPool : mempool min fee not met %s, %d < %d",
+                                        hash.ToString(), nFees, mempoolRejectFee),
+                    REJECT_INSUFFICIENTFEE, "mempool min fee not met");
+
             // Require that free transactions have sufficient priority to be mined in the next block.
             if (tx.IsZerocoinMint()) {
                 if(nFees < Params().Zerocoin_MintFee() * tx.GetZerocoinMintCount())
@@ -1402,6 +1432,14 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
         // Store transaction in memory
         pool.addUnchecked(hash, entry);
+
+        // Make room for it by evicting the cheapest transactions, which may include this one
+        std::list<CTransaction> evicted;
+        pool.TrimToSize(GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) << 20, evicted);
+        if (!evicted.empty())
+            LogPrint("mempool", "AcceptToMemoryPool: evicted %u transactions, mempool usage %u bytes\n", evicted.size(), pool.DynamicMemoryUsage());
+        if (!pool.exists(hash))
+            return state.DoS(0, false, REJECT_INSUFFICIENTFEE, "mempool full");
     }
 
     SyncWithWallets(tx, NULL);
@@ -1729,14 +1767,59 @@ bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos)
     return true;
 }
 
-bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
+bool ReadRawBlockFromDisk(CDataStream& ss, const CDiskBlockPos& pos)
+{
+    // WriteBlockToDisk puts the network magic and the block size in front of each block
+    if (pos.nPos < MESSAGE_START_SIZE + sizeof(unsigned int))
+        return error("%s : no block at file %d offset %u", __func__, pos.nFile, pos.nPos);
+    CDiskBlockPos posHeader(pos.nFile, pos.nPos - MESSAGE_START_SIZE - sizeof(unsigned int));
+    CAutoFile filein(OpenBlockFile(posHeader, true), SER_DISK, CLIENT_VERSION);
+    if (filein.IsNull())
+        return error("%s : OpenBlockFile failed", __func__);
+
+    const size_t nStart = ss.size();
+    try {
+        MessageStartChars pchMessageStart;
+        unsigned int nSize;
+        filein >> FLATDATA(pchMessageStart) >> nSize;
+        if (memcmp(pchMessageStart, Params().MessageStart(), MESSAGE_START_SIZE) || nSize > MAX_BLOCK_SIZE_CURRENT)
+            return error("%s : no block at file %d offset %u", __func__, pos.nFile, pos.nPos);
+
+        // straight into the caller's buffer, without deserializing
+        ss.resize(nStart + nSize);
+        filein.read(&ss[nStart], nSize);
+    } catch (std::exception& e) {
+        ss.resize(nStart);
+        return error("%s : I/O error - %s", __func__, e.what());
+    }
+
+    return true;
+}
+
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex)
 {
-    if (!ReadBlockFromDisk(block, pindex->GetBlockPos()))
+    pblock = blockcache.Get(pindex->GetBlockHash());
+    if (pblock)
+        return true;
+
+    std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+    if (!ReadBlockFromDisk(*pblockNew, pindex->GetBlockPos()))
         return false;
-    if (block.GetHash() != pindex->GetBlockHash()) {
-        LogPrintf("%s : block=%s index=%s\n", __func__, block.GetHash().ToString().c_str(), pindex->GetBlockHash().ToString().c_str());
+    if (pblockNew->GetHash() != pindex->GetBlockHash()) {
+        LogPrintf("%s : block=%s index=%s\n", __func__, pblockNew->GetHash().ToString().c_str(), pindex->GetBlockHash().ToString().c_str());
         return error("ReadBlockFromDisk(CBlock&, CBlockIndex*) : GetHash() doesn't match index");
     }
+    pblock = pblockNew;
+    blockcache.Insert(pblock);
+    return true;
+}
+
+bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
+{
+    std::shared_ptr<const CBlock> pblock;
+    if (!ReadBlockFromDisk(pblock, pindex))
+        return false;
+    block = *pblock;
     return true;
 }
 
@@ -1986,7 +2069,7 @@ void AddInvalidSpendsToMap(const CBlock& block)
                     CBigNum bnActualSerial = spend.CalculateValidSerial(Params().Zerocoin_Params(false));
                     uint256 txHash;
 
-                    if (zerocoinDB->ReadCoinSpend(bnActualSerial, txHash)) {
+                    if (pzerocoinTip->ReadCoinSpend(bnActualSerial, txHash)) {
                         mapInvalidSerials[bnActualSerial] = spend.getDenomination() * COIN;
 
                         CTransaction txPrev;
@@ -2170,7 +2253,7 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
                 for (const CTxIn& txin : tx.vin) {
                     if (txin.scriptSig.IsZerocoinSpend()) {
                         CoinSpend spend = TxInToZerocoinSpend(txin);
-                        if (!zerocoinDB->EraseCoinSpend(spend.getCoinSerialNumber()))
+                        if (!pzerocoinTip->EraseCoinSpend(spend.getCoinSerialNumber()))
                             return error("failed to erase spent zerocoin in block");
 
                         //if this was our spend, then mark it unspent now
@@ -2195,7 +2278,7 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
                     if (!TxOutToPublicCoin(txout, pubCoin, state))
                         return error("DisconnectBlock(): TxOutToPublicCoin() failed");
 
-                    if(!zerocoinDB->EraseCoinMint(pubCoin.getValue()))
+                    if(!pzerocoinTip->EraseCoinMint(pubCoin.getValue()))
                         return error("DisconnectBlock(): Failed to erase coin mint");
                 }
             }
@@ -2265,6 +2348,13 @@ bool DisconnectBlock(CBlock& block, CValidationState& state, CBlockIndex* pindex
             if(!EraseAccumulatorValues(nCheckpoint, pindex->pprev->nAccumulatorCheckpoint))
                 return error("DisconnectBlock(): failed to erase checkpoint");
         }
+
+        if (!pzerocoinTip->EraseBlockPubcoins(pindex->nHeight))
+            return error("DisconnectBlock(): failed to erase block pubcoins");
+
+        if (block.IsProofOfStake() && !block.vtx[1].IsZerocoinSpend())
+            if (!pblocktree->EraseStakeInput(block.vtx[1].vin[0].prevout))
+                return error("DisconnectBlock(): failed to erase stake input");
     }
 
     if (pfClean) {
@@ -2308,6 +2398,45 @@ void ThreadScriptCheck()
     scriptcheckqueue.Thread();
 }
 
+// Each zerocoin spend proof is expensive, so hand them out one at a time
+static CCheckQueue<CZerocoinSpendCheck> zerocoinspendcheckqueue(1);
+// CheckBlock and AcceptToMemoryPool are not always serialized by cs_main, but the queue only serves one master at a time
+static boost::mutex cs_zerocoinspendcheckqueue;
+
+void ThreadZerocoinSpendCheck()
+{
+    RenameThread("bitwin24-zcspendch");
+    zerocoinspendcheckqueue.Thread();
+}
+
+void ThreadZerocoinSoKCheck()
+{
+    RenameThread("bitwin24-zcsokch");
+    libzerocoin::ThreadSerialNumberSoKCheck();
+}
+
+bool RunZerocoinSpendChecks(std::vector<CZerocoinSpendCheck>& vChecks, bool cacheStore)
+{
+    if (vChecks.empty())
+        return true;
+
+    for (CZerocoinSpendCheck& check : vChecks)
+        check.SetCacheStore(cacheStore);
+
+    if (!nScriptCheckThreads || vChecks.size() == 1) {
+        for (CZerocoinSpendCheck& check : vChecks) {
+            if (!check())
+                return false;
+        }
+        return true;
+    }
+
+    boost::unique_lock<boost::mutex> lock(cs_zerocoinspendcheckqueue);
+    CCheckQueueControl<CZerocoinSpendCheck> control(&zerocoinspendcheckqueue);
+    control.Add(vChecks);
+    return control.Wait();
+}
+
 void RecalculateZBWIMinted()
 {
     CBlockIndex *pindex = chainActive[Params().Zerocoin_StartHeight()];
@@ -2631,6 +2760,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
     vector<uint256> vSpendsInBlock;
     uint256 hashBlock = block.GetHash();
+    std::pair<COutPoint, std::pair<uint256, CTxOut> > stakeInput;
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const CTransaction& tx = block.vtx[i];
 
@@ -2735,6 +2865,15 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         }
         nValueOut += tx.GetValueOut();
 
+        // Remember where the kernel input came from before it is spent, so stake checks
+        // against it never need the block holding it
+        if (tx.IsCoinStake() && !tx.IsZerocoinSpend()) {
+            const COutPoint& prevout = tx.vin[0].prevout;
+            const CCoins* coins = view.AccessCoins(prevout.hash);
+            if (coins && coins->IsAvailable(prevout.n) && pindex->GetAncestor(coins->nHeight))
+                stakeInput = make_pair(prevout, make_pair(pindex->GetAncestor(coins->nHeight)->GetBlockHash(), coins->vout[prevout.n]));
+        }
+
         CTxUndo undoDummy;
         if (i > 0) {
             blockundo.vtxundo.push_back(CTxUndo());
@@ -2844,8 +2983,15 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
     }
 
     // Flush spend/mint info to disk
-    if (!zerocoinDB->WriteCoinSpendBatch(vSpends)) return state.Abort(("Failed to record coin serials to database"));
-    if (!zerocoinDB->WriteCoinMintBatch(vMints)) return state.Abort(("Failed to record new mints to database"));
+    if (!pzerocoinTip->WriteCoinSpendBatch(vSpends, pindex->nHeight)) return state.Abort(("Failed to record coin serials to database"));
+    if (!pzerocoinTip->WriteCoinMintBatch(vMints)) return state.Abort(("Failed to record new mints to database"));
+
+    // Index the block's pubcoins so accumulator and witness code does not have to read the whole block again
+    if (pindex->nHeight >= Params().Zerocoin_StartHeight()) {
+        BlockPubcoinMap mapPubcoins;
+        if (BlockToPubcoinMap(block, mapPubcoins) && !pzerocoinTip->WriteBlockPubcoins(pindex->nHeight, pindex->GetBlockHash(), mapPubcoins))
+            return state.Abort("Failed to record block pubcoins to database");
+    }
 
     //Record accumulator checksums
     DatabaseChecksums(mapAccumulators);
@@ -2854,6 +3000,20 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
         if (!pblocktree->WriteTxIndex(vPos))
             return state.Abort("Failed to write transaction index");
 
+    if (!stakeInput.second.first.IsNull())
+        if (!pblocktree->WriteStakeInput(stakeInput.first, stakeInput.second.first, stakeInput.second.second))
+            return state.Abort("Failed to write stake input index");
+
+    // Stake inputs spent deeper than the maximum reorg can't be staked again on any
+    // acceptable fork, so drop them and keep the index bounded
+    int nHeightStakePrune = pindex->nHeight - GetArg("-maxreorg", Params().MaxReorganizationDepth()) - 1;
+    if (nHeightStakePrune > 0) {
+        const CBlockIndex* pindexPrune = pindex->GetAncestor(nHeightStakePrune);
+        if (pindexPrune && pindexPrune->IsProofOfStake() && !pindexPrune->prevoutStake.IsNull())
+            if (!pblocktree->EraseStakeInput(pindexPrune->prevoutStake))
+                return state.Abort("Failed to prune stake input index");
+    }
+
     // add this block to the view's block chain
     view.SetBestBlock(pindex->GetBlockHash());
 
@@ -2900,8 +3060,9 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
     LOCK(cs_main);
     static int64_t nLastWrite = 0;
     try {
+        const size_t cacheSize = pcoinsTip->DynamicMemoryUsage() + pzerocoinTip->DynamicMemoryUsage();
         if ((mode == FLUSH_STATE_ALWAYS) ||
-            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && pcoinsTip->GetCacheSize() > nCoinCacheSize) ||
+            ((mode == FLUSH_STATE_PERIODIC || mode == FLUSH_STATE_IF_NEEDED) && cacheSize > nCoinCacheUsage) ||
             (mode == FLUSH_STATE_PERIODIC && GetTimeMicros() > nLastWrite + DATABASE_WRITE_INTERVAL * 1000000)) {
             // Typical CCoins structures on disk are around 100 bytes in size.
             // Pushing a new one to the database can cause it to be written
@@ -2912,6 +3073,10 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
                 return state.Error("out of disk space");
             // First make sure all block and undo data is flushed to disk.
             FlushBlockFile();
+            // Let the background coins write from the previous flush finish, so the block index and zerocoin
+            // entries written below only ever run ahead of the snapshot this flush hands over, never an older one.
+            if (pcoinsAsync && !pcoinsAsync->Wait())
+                return state.Abort("Failed to write to coin database");
             // Then update all block file information (which may refer to block and undo files).
             bool fileschanged = false;
             for (set<int>::iterator it = setDirtyFileInfo.begin(); it != setDirtyFileInfo.end();) {
@@ -2931,9 +3096,24 @@ bool static FlushStateToDisk(CValidationState& state, FlushStateMode mode)
                 setDirtyBlockIndex.erase(it++);
             }
             pblocktree->Sync();
+            // Zerocoin entries go in their own synced batch before the chainstate, not atomically with it, so
+            // after a crash they may be ahead of it but never behind. The consensus checks only count a spend or mint
+            // once its transaction is found in the active chain and block pubcoins carry their block hash, so entries
+            // of blocks past the chainstate are ignored until those blocks are connected again and rewrite them.
+            if (!pzerocoinTip->Flush())
+                return state.Abort("Failed to write to zerocoin database");
             // Finally flush the chainstate (which may refer to block index entries).
+            const unsigned int nCoinsEntries = pcoinsTip->GetCacheSize();
+            const size_t nCoinsPoolUsage = pcoinsTip->GetPoolUsage();
+            const int64_t nTimeCoins = GetTimeMicros();
+            // With a background writer this only hands the dirty coins over; the database's best block
+            // marker is written in the same batch, so it never runs ahead of the coins.
             if (!pcoinsTip->Flush())
                 return state.Abort("Failed to write to coin database");
+            if (pcoinsAsync && mode == FLUSH_STATE_ALWAYS && !pcoinsAsync->Wait())
+                return state.Abort("Failed to write to coin database");
+            LogPrint("bench", "  - Flush %u coins entries: %.2fms (%.1fMiB pooled, %.0f bytes/entry)\n", nCoinsEntries,
+                (GetTimeMicros() - nTimeCoins) * 0.001, nCoinsPoolUsage * (1.0 / (1 << 20)), nCoinsEntries ? (double)nCoinsPoolUsage / nCoinsEntries : 0.0);
             // Update best block in wallet (so we can detect restored wallets).
             if (mode != FLUSH_STATE_IF_NEEDED) {
                 GetMainSignals().SetBestChain(chainActive.GetLocator());
@@ -3012,6 +3192,7 @@ bool static DisconnectTip(CValidationState& state)
         assert(view.Flush());
     }
     LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
+    blockcache.Erase(pindexDelete->GetBlockHash());
     // Write the chain state to disk, if necessary.
     if (!FlushStateToDisk(state, FLUSH_STATE_ALWAYS))
         return false;
@@ -3035,7 +3216,125 @@ bool static DisconnectTip(CValidationState& state)
     return true;
 }
 
+/**
+ * Read a block for ConnectTip into an object no other thread shares. Cached blocks are shared read-only,
+ * and ConnectBlock() rebuilds the merkle tree the block carries, so a cached one is copied first.
+ */
+static std::shared_ptr<const CBlock> ReadBlockForConnect(const uint256& hash, const CDiskBlockPos& pos)
+{
+    std::shared_ptr<const CBlock> pblockCached = blockcache.Get(hash);
+    if (pblockCached)
+        return std::make_shared<const CBlock>(*pblockCached);
+
+    std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>();
+    if (!ReadBlockFromDisk(*pblockNew, pos) || pblockNew->GetHash() != hash)
+        return std::shared_ptr<const CBlock>();
+    return pblockNew;
+}
+
+namespace
+{
+/**
+ * Reads and deserializes the blocks ConnectTip is about to need on a background
+ * thread, so disk I/O for the next blocks overlaps validation of the current one.
+ */
+class CBlockPrefetcher
+{
+private:
+    boost::mutex cs;
+    //! Signalled when blocks are queued for reading
+    boost::condition_variable condWork;
+    //! Signalled when a read finishes
+    boost::condition_variable condReady;
+    std::deque<std::pair<uint256, CDiskBlockPos> > queueRequests;
+    std::map<uint256, std::shared_ptr<const CBlock> > mapReady;
+    //! The block the worker is reading right now, if any
+    uint256 hashReading;
+
+public:
+    /** Replace the read-ahead window with the given path, in connect order. Requires cs_main. */
+    void Request(const std::vector<CBlockIndex*>& vpindex)
+    {
+        AssertLockHeld(cs_main);
+        boost::unique_lock<boost::mutex> lock(cs);
+        std::set<uint256> setWanted;
+        queueRequests.clear();
+        for (CBlockIndex* pindex : vpindex) {
+            if (!(pindex->nStatus & BLOCK_HAVE_DATA))
+                break;
+            const uint256 hash = pindex->GetBlockHash();
+            setWanted.insert(hash);
+            if (hash != hashReading && !mapReady.count(hash))
+                queueRequests.push_back(std::make_pair(hash, pindex->GetBlockPos()));
+        }
+
+        // drop blocks that fell off the path, e.g. after a reorg
+        for (std::map<uint256, std::shared_ptr<const CBlock> >::iterator it = mapReady.begin(); it != mapReady.end();) {
+            if (setWanted.count(it->first))
+                ++it;
+            else
+                mapReady.erase(it++);
+        }
+        if (!queueRequests.empty())
+            condWork.notify_one();
+    }
+
+    /** Hand over the block for pindex if it was read ahead, waiting for a read in progress */
+    std::shared_ptr<const CBlock> Take(const CBlockIndex* pindex)
+    {
+        const uint256 hash = pindex->GetBlockHash();
+        boost::unique_lock<boost::mutex> lock(cs);
+        while (hashReading == hash)
+            condReady.wait(lock);
+
+        std::shared_ptr<const CBlock> pblock;
+        std::map<uint256, std::shared_ptr<const CBlock> >::iterator it = mapReady.find(hash);
+        if (it != mapReady.end()) {
+            pblock = it->second;
+            mapReady.erase(it);
+        }
+        return pblock;
+    }
+
+    void Thread()
+    {
+        while (true) {
+            std::pair<uint256, CDiskBlockPos> request;
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                while (queueRequests.empty())
+                    condWork.wait(lock);
+                request = queueRequests.front();
+                queueRequests.pop_front();
+                hashReading = request.first;
+            }
+
+            // Failures are left to the synchronous read in ConnectTip, which reports them
+            std::shared_ptr<const CBlock> pblock = ReadBlockForConnect(request.first, request.second);
+
+            {
+                boost::unique_lock<boost::mutex> lock(cs);
+                if (pblock)
+                    mapReady[request.first] = pblock;
+                hashReading = 0;
+            }
+            condReady.notify_all();
+        }
+    }
+};
+
+CBlockPrefetcher blockprefetcher;
+} // anon namespace
+
+void ThreadBlockPrefetch()
+{
+    RenameThread("bitwin24-prefetch");
+    blockprefetcher.Thread();
+}
+
 static int64_t nTimeReadFromDisk = 0;
+static int64_t nBlocksRead = 0;
+static int64_t nBlocksPrefetched = 0;
 static int64_t nTimeConnectTotal = 0;
 static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
@@ -3054,23 +3353,28 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
     if (pblock == NULL)
         fAlreadyChecked = false;
 
-    // Read block from disk.
+    // Read block from disk, unless the prefetch thread already did.
     int64_t nTime1 = GetTimeMicros();
-    CBlock block;
+    std::shared_ptr<const CBlock> pblockRead;
     if (!pblock) {
-        if (!ReadBlockFromDisk(block, pindexNew))
+        if (nBlockPrefetch)
+            pblockRead = blockprefetcher.Take(pindexNew);
+        if (pblockRead)
+            nBlocksPrefetched++;
+        else if (!(pblockRead = ReadBlockForConnect(pindexNew->GetBlockHash(), pindexNew->GetBlockPos())))
             return state.Abort("Failed to read block");
-        pblock = &block;
+        nBlocksRead++;
     }
+    const CBlock& block = pblock ? *pblock : *pblockRead;
     // Apply the block atomically to the chain state.
     int64_t nTime2 = GetTimeMicros();
     nTimeReadFromDisk += nTime2 - nTime1;
     int64_t nTime3;
-    LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
+    LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs] (%d of %d prefetched)\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001, nBlocksPrefetched, nBlocksRead);
     {
         CInv inv(MSG_BLOCK, pindexNew->GetBlockHash());
-        bool rv = ConnectBlock(*pblock, state, pindexNew, view, false, fAlreadyChecked);
-        GetMainSignals().BlockChecked(*pblock, state);
+        bool rv = ConnectBlock(block, state, pindexNew, view, false, fAlreadyChecked);
+        GetMainSignals().BlockChecked(block, state);
         if (!rv) {
             if (state.IsInvalid())
                 InvalidBlockFound(pindexNew, state);
@@ -3098,7 +3402,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
 
     // Remove conflicting transactions from the mempool.
     list<CTransaction> txConflicted;
-    mempool.removeForBlock(pblock->vtx, pindexNew->nHeight, txConflicted);
+    mempool.removeForBlock(block.vtx, pindexNew->nHeight, txConflicted);
     mempool.check(pcoinsTip);
     // Update chainActive & related variables.
     UpdateTip(pindexNew);
@@ -3108,9 +3412,11 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
         SyncWithWallets(tx, NULL);
     }
     // ... and about transactions that got confirmed:
-    BOOST_FOREACH (const CTransaction& tx, pblock->vtx) {
-        SyncWithWallets(tx, pblock);
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        SyncWithWallets(tx, &block);
     }
+    // a new tip is what peers ask for next; from here on the block is only read
+    blockcache.Insert(pblockRead ? pblockRead : std::make_shared<const CBlock>(block));
 
     int64_t nTime6 = GetTimeMicros();
     nTimePostConnect += nTime6 - nTime5;
@@ -3276,6 +3582,25 @@ static void PruneBlockIndexCandidates()
     assert(!setBlockIndexCandidates.empty());
 }
 
+/**
+ * Read ahead the nBlockPrefetch blocks following pindexFrom on the path to pindexMostWork. If
+ * fHaveLast the caller already holds pindexMostWork's block in memory.
+ */
+static void RequestBlockPrefetch(const CBlockIndex* pindexFrom, CBlockIndex* pindexMostWork, bool fHaveLast)
+{
+    std::vector<CBlockIndex*> vpindexPrefetch;
+    int nHeightFrom = pindexFrom ? pindexFrom->nHeight : -1;
+    CBlockIndex* pindexIter = pindexMostWork->GetAncestor(std::min(nHeightFrom + nBlockPrefetch, pindexMostWork->nHeight));
+    if (pindexIter == pindexMostWork && fHaveLast)
+        pindexIter = pindexIter->pprev;
+    while (pindexIter && pindexIter->nHeight > nHeightFrom) {
+        vpindexPrefetch.push_back(pindexIter);
+        pindexIter = pindexIter->pprev;
+    }
+    std::reverse(vpindexPrefetch.begin(), vpindexPrefetch.end());
+    blockprefetcher.Request(vpindexPrefetch);
+}
+
 /**
  * Try to make some progress towards making pindexMostWork the active block.
  * pblock is either NULL or a pointer to a CBlock corresponding to pindexMostWork.
@@ -3295,6 +3620,10 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
             return false;
     }
 
+    // Start reading the blocks after the fork while the first ones are connected.
+    if (nBlockPrefetch)
+        RequestBlockPrefetch(pindexFork, pindexMostWork, pblock != NULL);
+
     // Build list of new blocks to connect.
     std::vector<CBlockIndex*> vpindexToConnect;
     bool fContinue = true;
@@ -3334,6 +3663,9 @@ static bool ActivateBestChainStep(CValidationState& state, CBlockIndex* pindexMo
                     fContinue = false;
                     break;
                 }
+                // Keep the read-ahead window nBlockPrefetch blocks ahead of the new tip.
+                if (nBlockPrefetch)
+                    RequestBlockPrefetch(chainActive.Tip(), pindexMostWork, pblock != NULL);
             }
         }
     }
@@ -3495,8 +3827,7 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         return it->second;
 
     // Construct new block index object
-    CBlockIndex* pindexNew = new CBlockIndex(block);
-    assert(pindexNew);
+    CBlockIndex* pindexNew = blockIndexArena.New(block);
     // We assign the sequence id to blocks only when the full data is available,
     // to avoid miners withholding blocks but broadcasting headers, to get a
     // competitive advantage.
@@ -3514,21 +3845,25 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
         pindexNew->nHeight = pindexNew->pprev->nHeight + 1;
         pindexNew->BuildSkip();
 
+        // Every block after the last PoW block is proof of stake, so the type is known from a
+        // header alone. Retargeting and stake modifier selection below depend on the flag.
+        if (pindexNew->nHeight > Params().LAST_POW_BLOCK())
+            pindexNew->SetProofOfStake();
+
         //update previous block pointer
         pindexNew->pprev->pnext = pindexNew;
 
-        // ppcoin: compute chain trust score
-        pindexNew->bnChainTrust = (pindexNew->pprev ? pindexNew->pprev->bnChainTrust : 0) + pindexNew->GetBlockTrust();
-
         // ppcoin: compute stake entropy bit for stake modifier
         if (!pindexNew->SetStakeEntropyBit(pindexNew->GetStakeEntropyBit()))
             LogPrintf("AddToBlockIndex() : SetStakeEntropyBit() failed \n");
 
         // ppcoin: record proof-of-stake hash value
         if (pindexNew->IsProofOfStake()) {
-            if (!mapProofOfStake.count(hash))
+            map<uint256, uint256>::const_iterator itProofOfStake = mapProofOfStake.find(hash);
+            if (itProofOfStake == mapProofOfStake.end())
                 LogPrintf("AddToBlockIndex() : hashProofOfStake not found in map \n");
-            pindexNew->hashProofOfStake = mapProofOfStake[hash];
+            else
+                pindexNew->hashProofOfStake = itProofOfStake->second;
         }
 
         // ppcoin: compute stake modifier
@@ -3558,8 +3893,15 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
 /** Mark a block as having its data received and checked (up to BLOCK_VALID_TRANSACTIONS). */
 bool ReceivedBlockTransactions(const CBlock& block, CValidationState& state, CBlockIndex* pindexNew, const CDiskBlockPos& pos)
 {
-    if (block.IsProofOfStake())
+    if (block.IsProofOfStake()) {
         pindexNew->SetProofOfStake();
+        // indexed from a header first, the stake is only known now
+        if (pindexNew->prevoutStake.IsNull()) {
+            pindexNew->prevoutStake = block.vtx[1].vin[0].prevout;
+            pindexNew->nStakeTime = block.nTime;
+            setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
+        }
+    }
     pindexNew->nTx = block.vtx.size();
     pindexNew->nChainTx = 0;
     pindexNew->nFile = pos.nFile;
@@ -3819,8 +4161,9 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
     // Check transactions
     bool fZerocoinActive = block.GetBlockTime() > Params().Zerocoin_StartTime();
     vector<CBigNum> vBlockSerials;
+    std::vector<CZerocoinSpendCheck> vZerocoinChecks;
     for (const CTransaction& tx : block.vtx) {
-        if (!CheckTransaction(tx, fZerocoinActive, chainActive.Height() + 1 >= Params().Zerocoin_Block_EnforceSerialRange(), state))
+        if (!CheckTransaction(tx, fZerocoinActive, chainActive.Height() + 1 >= Params().Zerocoin_Block_EnforceSerialRange(), state, &vZerocoinChecks))
             return error("CheckBlock() : CheckTransaction failed");
 
         // double check that there are no double spent zBWI spends in this block
@@ -3837,6 +4180,11 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW, bo
         }
     }
 
+    // Verify every zerocoin spend proof in the block concurrently and join before accepting it
+    if (!RunZerocoinSpendChecks(vZerocoinChecks))
+        return state.DoS(100, error("CheckBlock() : zerocoin spend did not verify"),
+            REJECT_INVALID, "bad-txns-zerocoinspend");
+
 
     unsigned int nSigOps = 0;
     BOOST_FOREACH (const CTransaction& tx, block.vtx) {
@@ -3862,7 +4210,7 @@ bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev)
     return true;
 }
 
-bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* const pindexPrev)
+bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* const pindexPrev, bool fCheckPOW)
 {
     uint256 hash = block.GetHash();
 
@@ -3885,6 +4233,29 @@ bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& sta
             REJECT_INVALID, "time-too-old");
     }
 
+    // The remaining proof checks need only the header, so a header chain can be validated
+    // before any block body is downloaded. The kernel itself is checked in AcceptBlock.
+    bool fProofOfStake = nHeight > Params().LAST_POW_BLOCK();
+    if (block.GetBlockTime() > GetAdjustedTime() + (fProofOfStake ? 180 : 7200))
+        return state.Invalid(error("%s : block timestamp too far in the future", __func__),
+            REJECT_INVALID, "time-too-new");
+
+    if (block.nBits != GetNextWorkRequired(pindexPrev, &block))
+        return state.DoS(100, error("%s : incorrect difficulty at %d", __func__, nHeight),
+            REJECT_INVALID, "bad-diffbits");
+
+    if (fCheckPOW && !fProofOfStake && !CheckProofOfWork(hash, block.nBits))
+        return state.DoS(50, error("%s : proof of work failed", __func__),
+            REJECT_INVALID, "high-hash");
+
+    if (fProofOfStake) {
+        uint64_t nStakeModifier = 0;
+        bool fGeneratedStakeModifier = false;
+        if (!ComputeNextStakeModifier(pindexPrev, nStakeModifier, fGeneratedStakeModifier))
+            return state.DoS(100, error("%s : no stake modifier for height %d", __func__, nHeight),
+                REJECT_INVALID, "bad-stakemodifier");
+    }
+
     // Check that the block chain matches the known block chain up to a checkpoint
     if (!Checkpoints::CheckBlock(nHeight, hash))
         return state.DoS(100, error("%s : rejected by checkpoint lock-in at %d", __func__, nHeight),
@@ -4022,6 +4393,29 @@ bool AcceptBlockHeader(const CBlock& block, CValidationState& state, CBlockIndex
     return true;
 }
 
+void SetBlockIndexProofOfStake(CBlockIndex* pindex, const uint256& hashProofOfStake)
+{
+    AssertLockHeld(cs_main);
+
+    pindex->hashProofOfStake = hashProofOfStake;
+    setDirtyBlockIndex.insert(pindex);
+
+    // The checksum chains through the parent's, so descendants whose kernel is already known
+    // were computed from the stale value. The walk stops at the first one still waiting for its
+    // body; it is refreshed from here when that body arrives.
+    CBlockIndex* pindexWalk = pindex;
+    while (true) {
+        pindexWalk->nStakeModifierChecksum = GetStakeModifierChecksum(pindexWalk);
+        if (!CheckStakeModifierCheckpoints(pindexWalk->nHeight, pindexWalk->nStakeModifierChecksum))
+            LogPrintf("%s : Rejected by stake modifier checkpoint height=%d, modifier=%s \n", __func__, pindexWalk->nHeight, boost::lexical_cast<std::string>(pindexWalk->nStakeModifier));
+
+        CBlockIndex* pindexNext = pindexWalk->pnext;
+        if (!pindexNext || pindexNext->pprev != pindexWalk || pindexNext->hashProofOfStake == 0)
+            break;
+        pindexWalk = pindexNext;
+    }
+}
+
 bool ContextualCheckZerocoinStake(int nHeight, CStakeInput* stake)
 {
     if (nHeight < Params().Zerocoin_Block_V2_Start())
@@ -4092,14 +4486,19 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
         if (stake->IsZBWI() && !ContextualCheckZerocoinStake(pindexPrev->nHeight, stake.get()))
             return state.DoS(100, error("%s: staked zBWI fails context checks", __func__));
 
-        uint256 hash = block.GetHash();
-        if(!mapProofOfStake.count(hash)) // add to mapProofOfStake
-            mapProofOfStake.insert(make_pair(hash, hashProofOfStake));
+        mapProofOfStake[block.GetHash()] = hashProofOfStake;
     }
 
     if (!AcceptBlockHeader(block, state, &pindex))
         return false;
 
+    // the header may have been indexed before its kernel was checked
+    if (pindex->IsProofOfStake()) {
+        map<uint256, uint256>::const_iterator itProofOfStake = mapProofOfStake.find(pindex->GetBlockHash());
+        if (itProofOfStake != mapProofOfStake.end() && itProofOfStake->second != pindex->hashProofOfStake)
+            SetBlockIndexProofOfStake(pindex, itProofOfStake->second);
+    }
+
     if (pindex->nStatus & BLOCK_HAVE_DATA) {
         // TODO: deal better with duplicate blocks.
         // return state.DoS(20, error("AcceptBlock() : already have block %d %s", pindex->nHeight, pindex->GetBlockHash().ToString()), REJECT_DUPLICATE, "duplicate");
@@ -4289,7 +4688,7 @@ bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex
     indexDummy.nHeight = pindexPrev->nHeight + 1;
 
     // NOTE: CheckBlockHeader is called by CheckBlock
-    if (!ContextualCheckBlockHeader(block, state, pindexPrev))
+    if (!ContextualCheckBlockHeader(block, state, pindexPrev, fCheckPOW))
         return false;
     if (!CheckBlock(block, state, fCheckPOW, fCheckMerkleRoot))
         return false;
@@ -4374,9 +4773,7 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
         return (*mi).second;
 
     // Create new
-    CBlockIndex* pindexNew = new CBlockIndex();
-    if (!pindexNew)
-        throw runtime_error("LoadBlockIndex() : new CBlockIndex failed");
+    CBlockIndex* pindexNew = blockIndexArena.New();
     mi = mapBlockIndex.insert(make_pair(hash, pindexNew)).first;
 
     //mark as PoS seen
@@ -4390,8 +4787,11 @@ CBlockIndex* InsertBlockIndex(uint256 hash)
 
 bool static LoadBlockIndexDB(string& strError)
 {
+    int64_t nStart = GetTimeMillis();
     if (!pblocktree->LoadBlockIndexGuts())
         return false;
+    LogPrintf("%s: loaded %u block index entries in %dms, %.1fMiB\n", __func__, mapBlockIndex.size(), GetTimeMillis() - nStart,
+        blockIndexArena.DynamicUsage() * (1.0 / (1 << 20)));
 
     boost::this_thread::interruption_point();
 
@@ -4544,7 +4944,7 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
             }
         }
         // check level 3: check for inconsistencies during memory-only disconnect of tip blocks
-        if (nCheckLevel >= 3 && pindex == pindexState && (coins.GetCacheSize() + pcoinsTip->GetCacheSize()) <= nCoinCacheSize) {
+        if (nCheckLevel >= 3 && pindex == pindexState && (coins.DynamicMemoryUsage() + pcoinsTip->DynamicMemoryUsage()) <= nCoinCacheUsage) {
             bool fClean = true;
             if (!DisconnectBlock(block, state, pindex, coins, &fClean))
                 return error("VerifyDB() : *** irrecoverable inconsistency in block data at %d, hash=%s", pindex->nHeight, pindex->GetBlockHash().ToString());
@@ -5041,13 +5441,30 @@ void static ProcessGetData(CNode* pfrom)
                 // Don't send not-validated blocks
                 if (send && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
                     // Send block from disk
-                    CBlock block;
-                    if (!ReadBlockFromDisk(block, (*mi).second))
-                        assert(!"cannot load block from disk");
-                    if (inv.type == MSG_BLOCK)
-                        pfrom->PushMessage("block", block);
-                    else // MSG_FILTERED_BLOCK)
+                    if (inv.type == MSG_BLOCK) {
+                        // The stored bytes are sent as they are, without deserializing the block
+                        std::shared_ptr<const std::vector<char> > praw = blockcache.GetRaw(inv.hash);
+                        if (praw) {
+                            char* pbegin = const_cast<char*>(praw->data());
+                            pfrom->PushMessage("block", CFlatData(pbegin, pbegin + praw->size()));
+                        } else {
+                            pfrom->BeginMessage("block");
+                            const size_t nStart = pfrom->ssSend.size();
+                            if (!ReadRawBlockFromDisk(pfrom->ssSend, mi->second->GetBlockPos())) {
+                                pfrom->AbortMessage();
+                                assert(!"cannot load block from disk");
+                            }
+                            // Most peers ask for the same few blocks at the tip, keep those in memory
+                            if (chainActive.Height() - mi->second->nHeight < BLOCK_CACHE_RAW_DEPTH)
+                                blockcache.InsertRaw(inv.hash, std::make_shared<const std::vector<char> >(pfrom->ssSend.begin() + nStart, pfrom->ssSend.end()));
+                            pfrom->EndMessage();
+                        }
+                    } else // MSG_FILTERED_BLOCK)
                     {
+                        std::shared_ptr<const CBlock> pblock;
+                        if (!ReadBlockFromDisk(pblock, (*mi).second))
+                            assert(!"cannot load block from disk");
+                        const CBlock& block = *pblock;
                         LOCK(pfrom->cs_filter);
                         if (pfrom->pfilter) {
                             CMerkleBlock merkleBlock(block, *pfrom->pfilter);
@@ -5516,7 +5933,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
-    else if (strCommand == "getblocks" || strCommand == "getheaders") {
+    else if (strCommand == "getblocks" || (strCommand == "getheaders" && !Params().HeadersFirstSyncingActive())) {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
@@ -5548,7 +5965,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
     }
 
 
-    else if (strCommand == "headers" && Params().HeadersFirstSyncingActive()) {
+    else if (strCommand == "getheaders" && Params().HeadersFirstSyncingActive()) {
         CBlockLocator locator;
         uint256 hashStop;
         vRecv >> locator >> hashStop;
@@ -5775,9 +6192,8 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
                 return error("non-continuous headers sequence");
             }
 
-            /*TODO: this has a CBlock cast on it so that it will compile. There should be a solution for this
-             * before headers are reimplemented on mainnet
-             */
+            // The block type is implied by the height, so the cast to a CBlock without
+            // transactions still gets the proof of stake header checks
             if (!AcceptBlockHeader((CBlock)header, state, &pindexLast)) {
                 int nDoS;
                 if (state.IsInvalid(nDoS)) {
@@ -6499,10 +6915,8 @@ public:
     ~CMainCleanup()
     {
         // block headers
-        BlockMap::iterator it1 = mapBlockIndex.begin();
-        for (; it1 != mapBlockIndex.end(); it1++)
-            delete (*it1).second;
         mapBlockIndex.clear();
+        blockIndexArena.Clear();
 
         // orphan transactions
         mapOrphanTransactions.clear();
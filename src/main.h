@@ -35,6 +35,7 @@
 #include <algorithm>
 #include <exception>
 #include <map>
+#include <memory>
 #include <set>
 #include <stdint.h>
 #include <string>
@@ -48,10 +49,13 @@
 class CBlockIndex;
 class CBlockTreeDB;
 class CZerocoinDB;
+class CZerocoinViewCache;
+class CCoinsViewAsyncDB;
 class CSporkDB;
 class CBloomFilter;
 class CInv;
 class CScriptCheck;
+class CZerocoinSpendCheck;
 class CValidationInterface;
 class CValidationState;
 
@@ -76,6 +80,8 @@ static const unsigned int MAX_P2SH_SIGOPS = 15;
 /** The maximum number of sigops we're willing to relay/mine in a single tx */
 static const unsigned int MAX_TX_SIGOPS_CURRENT = MAX_BLOCK_SIGOPS_CURRENT / 5;
 static const unsigned int MAX_TX_SIGOPS_LEGACY = MAX_BLOCK_SIGOPS_LEGACY / 5;
+/** Default for -maxmempool, maximum megabytes of mempool memory usage */
+static const unsigned int DEFAULT_MAX_MEMPOOL_SIZE = 300;
 /** Default for -maxorphantx, maximum number of orphan transactions kept in memory */
 static const unsigned int DEFAULT_MAX_ORPHAN_TRANSACTIONS = 100;
 /** The maximum size of a blk?????.dat file (since 0.8) */
@@ -92,6 +98,10 @@ static const unsigned int LOCKTIME_THRESHOLD = 500000000; // Tue Nov  5 00:53:20
 static const int MAX_SCRIPTCHECK_THREADS = 16;
 /** -par default (number of script-checking threads, 0 = auto) */
 static const int DEFAULT_SCRIPTCHECK_THREADS = 0;
+/** Maximum number of blocks read ahead of ConnectTip */
+static const int MAX_BLOCK_PREFETCH = 256;
+/** -blockprefetch default (number of blocks read ahead of ConnectTip, 0 = off) */
+static const int DEFAULT_BLOCK_PREFETCH = 16;
 /** Number of blocks that can be requested at any given time from a single peer. */
 static const int MAX_BLOCKS_IN_TRANSIT_PER_PEER = 16;
 /** Timeout in seconds during which a peer must stall block download progress before being disconnected. */
@@ -140,10 +150,11 @@ extern CConditionVariable cvBlockChange;
 extern bool fImporting;
 extern bool fReindex;
 extern int nScriptCheckThreads;
+extern int nBlockPrefetch;
 extern bool fTxIndex;
 extern bool fIsBareMultisigStd;
 extern bool fCheckBlockIndex;
-extern unsigned int nCoinCacheSize;
+extern size_t nCoinCacheUsage;
 extern CFeeRate minRelayTxFee;
 extern bool fAlerts;
 extern bool fVerifyingBlocks;
@@ -159,6 +170,7 @@ extern int64_t nReserveBalance;
 extern std::map<uint256, int64_t> mapRejectedBlocks;
 extern std::map<unsigned int, unsigned int> mapHashedBlocks;
 extern std::set<std::pair<COutPoint, unsigned int> > setStakeSeen;
+extern std::map<uint256, uint256> mapProofOfStake;
 extern std::map<uint256, int64_t> mapZerocoinspends; //txid, time received
 
 /** Best header we've seen so far (used for getheaders queries' starting points). */
@@ -213,6 +225,12 @@ bool ProcessMessages(CNode* pfrom);
 bool SendMessages(CNode* pto, bool fSendTrickle);
 /** Run an instance of the script checking thread */
 void ThreadScriptCheck();
+/** Run the thread reading blocks ahead of ConnectTip */
+void ThreadBlockPrefetch();
+/** Run an instance of the zerocoin spend proof checking thread */
+void ThreadZerocoinSpendCheck();
+/** Run an instance of the thread computing zerocoin serial number signature of knowledge iterations */
+void ThreadZerocoinSoKCheck();
 
 /** Check whether we are doing an initial block download (synchronizing from disk or network) */
 bool IsInitialBlockDownload();
@@ -336,10 +354,18 @@ bool CheckInputs(const CTransaction& tx, CValidationState& state, const CCoinsVi
 /** Apply the effects of this transaction on the UTXO set represented by view */
 void UpdateCoins(const CTransaction& tx, CValidationState& state, CCoinsViewCache& inputs, CTxUndo& txundo, int nHeight);
 
-/** Context-independent validity checks */
-bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state);
+/**
+ * Context-independent validity checks. If pvZerocoinChecks is not NULL, zerocoin spend proof
+ * verifications are pushed onto it instead of being performed inline.
+ */
+bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fRejectBadUTXO, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvZerocoinChecks = NULL);
 bool CheckZerocoinMint(const uint256& txHash, const CTxOut& txout, CValidationState& state, bool fCheckOnly = false);
-bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state);
+bool CheckZerocoinSpend(const CTransaction& tx, bool fVerifySignature, CValidationState& state, std::vector<CZerocoinSpendCheck>* pvChecks = NULL);
+/**
+ * Verify a batch of zerocoin spend proofs, on the check queue workers when -par allows it.
+ * If cacheStore is set, successfully verified proofs are added to the zerocoin spend cache.
+ */
+bool RunZerocoinSpendChecks(std::vector<CZerocoinSpendCheck>& vChecks, bool cacheStore = false);
 bool ContextualCheckZerocoinSpend(const CTransaction& tx, const libzerocoin::CoinSpend& spend, CBlockIndex* pindex);
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx, CTransaction& tx);
 bool IsTransactionInChain(const uint256& txId, int& nHeightTx);
@@ -420,11 +446,48 @@ public:
     ScriptError GetScriptError() const { return error; }
 };
 
+/**
+ * Closure representing one zerocoin spend proof verification
+ * (commitment PoK, accumulator PoK and serial number SoK)
+ */
+class CZerocoinSpendCheck
+{
+private:
+    std::shared_ptr<const libzerocoin::CoinSpend> pspend;
+    CBigNum bnAccumulatorValue;
+    bool fUseV1Params;
+    bool cacheStore;
+
+public:
+    CZerocoinSpendCheck() : fUseV1Params(false), cacheStore(false) {}
+    CZerocoinSpendCheck(const libzerocoin::CoinSpend& spendIn, const CBigNum& bnAccumulatorValueIn, bool fUseV1ParamsIn) : pspend(std::make_shared<const libzerocoin::CoinSpend>(spendIn)),
+                                                                                                                          bnAccumulatorValue(bnAccumulatorValueIn), fUseV1Params(fUseV1ParamsIn), cacheStore(false) {}
+
+    bool operator()();
+
+    void swap(CZerocoinSpendCheck& check)
+    {
+        pspend.swap(check.pspend);
+        std::swap(bnAccumulatorValue, check.bnAccumulatorValue);
+        std::swap(fUseV1Params, check.fUseV1Params);
+        std::swap(cacheStore, check.cacheStore);
+    }
+
+    void SetCacheStore(bool cacheStoreIn) { cacheStore = cacheStoreIn; }
+};
+
 
 /** Functions for disk access for blocks */
 bool WriteBlockToDisk(CBlock& block, CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CDiskBlockPos& pos);
 bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex);
+/** Append the serialized block stored at pos to ss, without deserializing it */
+bool ReadRawBlockFromDisk(CDataStream& ss, const CDiskBlockPos& pos);
+/**
+ * Like ReadBlockFromDisk, but shares the block with the block cache instead of copying it. Other threads
+ * may read the same object, so it must not be passed to anything that rebuilds its merkle tree, like CheckBlock().
+ */
+bool ReadBlockFromDisk(std::shared_ptr<const CBlock>& pblock, const CBlockIndex* pindex);
 
 
 /** Functions for validating blocks and updating the block tree */
@@ -447,7 +510,7 @@ bool CheckBlock(const CBlock& block, CValidationState& state, bool fCheckPOW = t
 bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev);
 
 /** Context-dependent validity checks */
-bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* pindexPrev);
+bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* pindexPrev, bool fCheckPOW = true);
 bool ContextualCheckBlock(const CBlock& block, CValidationState& state, CBlockIndex* pindexPrev);
 
 /** Check a block is completely valid from start to finish (only works on top of our current best block, with cs_main held) */
@@ -456,6 +519,10 @@ bool TestBlockValidity(CValidationState& state, const CBlock& block, CBlockIndex
 /** Store block on disk. If dbp is provided, the file is known to already reside on disk */
 bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** pindex, CDiskBlockPos* dbp = NULL, bool fAlreadyCheckedBlock = false);
 bool AcceptBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex** ppindex = NULL);
+CBlockIndex* AddToBlockIndex(const CBlock& block);
+
+/** Record the kernel hash of a PoS block whose index entry may have been created from its header alone, refreshing the stake modifier checksums that depend on it */
+void SetBlockIndexProofOfStake(CBlockIndex* pindex, const uint256& hashProofOfStake);
 
 
 class CBlockFileInfo
@@ -613,12 +680,18 @@ extern CChain chainActive;
 /** Global variable that points to the active CCoinsView (protected by cs_main) */
 extern CCoinsViewCache* pcoinsTip;
 
+/** Global variable that points to the background writer below pcoinsTip, NULL if flushes are synchronous */
+extern CCoinsViewAsyncDB* pcoinsAsync;
+
 /** Global variable that points to the active block tree (protected by cs_main) */
 extern CBlockTreeDB* pblocktree;
 
 /** Global variable that points to the zerocoin database (protected by cs_main) */
 extern CZerocoinDB* zerocoinDB;
 
+/** Global variable that points to the zerocoin cache on top of zerocoinDB, all reads and writes go through it */
+extern CZerocoinViewCache* pzerocoinTip;
+
 /** Global variable that points to the spork database (protected by cs_main) */
 extern CSporkDB* pSporkDB;
 
@@ -30,6 +30,7 @@
 #include "zbwichain.h"
 
 
+#include <boost/bind.hpp>
 #include <boost/thread.hpp>
 #include <boost/tuple/tuple.hpp>
 
@@ -97,65 +98,31 @@ void UpdateTime(CBlockHeader* pblock, const CBlockIndex* pindexPrev)
         pblock->nBits = GetNextWorkRequired(pindexPrev, pblock);
 }
 
-std::pair<int, std::pair<uint256, uint256> > pCheckpointCache;
-CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake)
-{
-    CReserveKey reservekey(pwallet);
-
-    // Create new block
-    unique_ptr<CBlockTemplate> pblocktemplate(new CBlockTemplate());
-    if (!pblocktemplate.get())
-        return NULL;
-    CBlock* pblock = &pblocktemplate->block; // pointer for convenience
-
-    // -regtest only: allow overriding block.nVersion with
-    // -blockversion=N to test forking scenarios
-    if (Params().MineBlocksOnDemand())
-        pblock->nVersion = GetArg("-blockversion", pblock->nVersion);
-
-    // Make sure to create the correct block version after zerocoin is enabled
-    bool fZerocoinActive = GetAdjustedTime() >= Params().Zerocoin_StartTime();
-    if (fZerocoinActive)
-        pblock->nVersion = 4;
-    else
-        pblock->nVersion = 3;
-
-    // Create coinbase tx
-    CMutableTransaction txNew;
-    txNew.vin.resize(1);
-    txNew.vin[0].prevout.SetNull();
-    txNew.vout.resize(1);
-    txNew.vout[0].scriptPubKey = scriptPubKeyIn;
-    pblock->vtx.push_back(txNew);
-    pblocktemplate->vTxFees.push_back(-1);   // updated at end
-    pblocktemplate->vTxSigOps.push_back(-1); // updated at end
-
-    // ppcoin: if coinstake available add coinstake tx
-    static int64_t nLastCoinStakeSearchTime = GetAdjustedTime(); // only initialized at startup
+/** Mempool transactions selected for a block on top of hashPrevBlock, without coinbase and coinstake */
+struct CBlockBody {
+    uint256 hashPrevBlock;
+    unsigned int nTransactionsUpdated; // mempool.GetTransactionsUpdated() when the body was selected
+    int64_t nTimeCreated;
+    std::vector<CTransaction> vtx;
+    std::vector<CAmount> vTxFees;
+    std::vector<int64_t> vTxSigOps;
+    CAmount nFees;
+    uint64_t nBlockSize;
+    uint64_t nBlockTx;
+
+    CBlockBody() : hashPrevBlock(0), nTransactionsUpdated(0), nTimeCreated(0), nFees(0), nBlockSize(0), nBlockTx(0) {}
+};
 
-    if (fProofOfStake) {
-        boost::this_thread::interruption_point();
-        pblock->nTime = GetAdjustedTime();
-        CBlockIndex* pindexPrev = chainActive.Tip();
-        pblock->nBits = GetNextWorkRequired(pindexPrev, pblock);
-        CMutableTransaction txCoinStake;
-        int64_t nSearchTime = pblock->nTime; // search to current time
-        bool fStakeFound = false;
-        if (nSearchTime >= nLastCoinStakeSearchTime) {
-            unsigned int nTxNewTime = 0;
-            if (pwallet->CreateCoinStake(*pwallet, pblock->nBits, nSearchTime - nLastCoinStakeSearchTime, txCoinStake, nTxNewTime)) {
-                pblock->nTime = nTxNewTime;
-                pblock->vtx[0].vout[0].SetEmpty();
-                pblock->vtx.push_back(CTransaction(txCoinStake));
-                fStakeFound = true;
-            }
-            nLastCoinStakeSearchInterval = nSearchTime - nLastCoinStakeSearchTime;
-            nLastCoinStakeSearchTime = nSearchTime;
-        }
+// Select the mempool transactions for a block on top of pindexPrev
+static void CreateBlockBody(CBlockBody& body, CBlockIndex* pindexPrev)
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(mempool.cs);
 
-        if (!fStakeFound)
-            return NULL;
-    }
+    body = CBlockBody();
+    body.hashPrevBlock = pindexPrev->GetBlockHash();
+    body.nTransactionsUpdated = mempool.GetTransactionsUpdated();
+    body.nTimeCreated = GetTimeMillis();
 
     // Largest block you're willing to create:
     unsigned int nBlockMaxSize = GetArg("-blockmaxsize", DEFAULT_BLOCK_MAX_SIZE);
@@ -173,254 +140,433 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
     unsigned int nBlockMinSize = GetArg("-blockminsize", DEFAULT_BLOCK_MIN_SIZE);
     nBlockMinSize = std::min(nBlockMaxSize, nBlockMinSize);
 
-    // Collect memory pool transactions into the block
-    CAmount nFees = 0;
+    const int nHeight = pindexPrev->nHeight + 1;
+    CCoinsViewCache view(pcoinsTip);
+
+    // Priority order to process transactions
+    list<COrphan> vOrphan; // list memory doesn't move
+    map<uint256, vector<COrphan*> > mapDependers;
+    bool fPrintPriority = GetBoolArg("-printpriority", false);
+
+    // This vector will be sorted into a priority queue:
+    vector<TxPriority> vecPriority;
+    vecPriority.reserve(mempool.mapTx.size());
+    for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
+         mi != mempool.mapTx.end(); ++mi) {
+        const CTransaction& tx = mi->second.GetTx();
+        if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight)){
+            continue;
+        }
+        if((!Params().ZeroCoinEnabled() || GetAdjustedTime() > GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE)) && tx.ContainsZerocoins()) {
+            continue;
+        }
 
-    {
-        LOCK2(cs_main, mempool.cs);
+        COrphan* porphan = NULL;
+        double dPriority = 0;
+        CAmount nTotalIn = 0;
+        bool fMissingInputs = false;
+        uint256 txid = tx.GetHash();
+        for (const CTxIn& txin : tx.vin) {
+            //zerocoinspend has special vin
+            if (tx.IsZerocoinSpend()) {
+                nTotalIn = tx.GetZerocoinSpent();
+
+                //Give a high priority to zerocoinspends to get into the next block
+                //Priority = (age^6+100000)*amount - gives higher priority to zbwis that have been in mempool long
+                //and higher priority to zbwis that are large in value
+                int64_t nTimeSeen = GetAdjustedTime();
+                double nConfs = 100000;
+
+                auto it = mapZerocoinspends.find(txid);
+                if (it != mapZerocoinspends.end()) {
+                    nTimeSeen = it->second;
+                } else {
+                    //for some reason not in map, add it
+                    mapZerocoinspends[txid] = nTimeSeen;
+                }
+
+                double nTimePriority = std::pow(GetAdjustedTime() - nTimeSeen, 6);
+
+                // zBWI spends can have very large priority, use non-overflowing safe functions
+                dPriority = double_safe_addition(dPriority, (nTimePriority * nConfs));
+                dPriority = double_safe_multiplication(dPriority, nTotalIn);
 
-        CBlockIndex* pindexPrev = chainActive.Tip();
-        const int nHeight = pindexPrev->nHeight + 1;
-        CCoinsViewCache view(pcoinsTip);
-
-        // Priority order to process transactions
-        list<COrphan> vOrphan; // list memory doesn't move
-        map<uint256, vector<COrphan*> > mapDependers;
-        bool fPrintPriority = GetBoolArg("-printpriority", false);
-
-        // This vector will be sorted into a priority queue:
-        vector<TxPriority> vecPriority;
-        vecPriority.reserve(mempool.mapTx.size());
-        for (map<uint256, CTxMemPoolEntry>::iterator mi = mempool.mapTx.begin();
-             mi != mempool.mapTx.end(); ++mi) {
-            const CTransaction& tx = mi->second.GetTx();
-            if (tx.IsCoinBase() || tx.IsCoinStake() || !IsFinalTx(tx, nHeight)){
-                continue;
-            }
-            if((!Params().ZeroCoinEnabled() || GetAdjustedTime() > GetSporkValue(SPORK_16_ZEROCOIN_MAINTENANCE_MODE)) && tx.ContainsZerocoins()) {
                 continue;
             }
 
-            COrphan* porphan = NULL;
-            double dPriority = 0;
-            CAmount nTotalIn = 0;
-            bool fMissingInputs = false;
-            uint256 txid = tx.GetHash();
-            for (const CTxIn& txin : tx.vin) {
-                //zerocoinspend has special vin
-                if (tx.IsZerocoinSpend()) {
-                    nTotalIn = tx.GetZerocoinSpent();
-
-                    //Give a high priority to zerocoinspends to get into the next block
-                    //Priority = (age^6+100000)*amount - gives higher priority to zbwis that have been in mempool long
-                    //and higher priority to zbwis that are large in value
-                    int64_t nTimeSeen = GetAdjustedTime();
-                    double nConfs = 100000;
-
-                    auto it = mapZerocoinspends.find(txid);
-                    if (it != mapZerocoinspends.end()) {
-                        nTimeSeen = it->second;
-                    } else {
-                        //for some reason not in map, add it
-                        mapZerocoinspends[txid] = nTimeSeen;
-                    }
+            // Read prev transaction
+            if (!view.HaveCoins(txin.prevout.hash)) {
+                // This should never happen; all transactions in the memory
+                // pool should connect to either transactions in the chain
+                // or other transactions in the memory pool.
+                if (!mempool.mapTx.count(txin.prevout.hash)) {
+                    LogPrintf("ERROR: mempool transaction missing input\n");
+                    if (fDebug) assert("mempool transaction missing input" == 0);
+                    fMissingInputs = true;
+                    if (porphan)
+                        vOrphan.pop_back();
+                    break;
+                }
 
-                    double nTimePriority = std::pow(GetAdjustedTime() - nTimeSeen, 6);
+                // Has to wait for dependencies
+                if (!porphan) {
+                    // Use list for automatic deletion
+                    vOrphan.push_back(COrphan(&tx));
+                    porphan = &vOrphan.back();
+                }
+                mapDependers[txin.prevout.hash].push_back(porphan);
+                porphan->setDependsOn.insert(txin.prevout.hash);
+                nTotalIn += mempool.mapTx[txin.prevout.hash].GetTx().vout[txin.prevout.n].nValue;
+                continue;
+            }
 
-                    // zBWI spends can have very large priority, use non-overflowing safe functions
-                    dPriority = double_safe_addition(dPriority, (nTimePriority * nConfs));
-                    dPriority = double_safe_multiplication(dPriority, nTotalIn);
+            //Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
+            if (invalid_out::ContainsOutPoint(txin.prevout)) {
+                LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
+                fMissingInputs = true;
+                break;
+            }
 
-                    continue;
-                }
+            const CCoins* coins = view.AccessCoins(txin.prevout.hash);
+            assert(coins);
 
-                // Read prev transaction
-                if (!view.HaveCoins(txin.prevout.hash)) {
-                    // This should never happen; all transactions in the memory
-                    // pool should connect to either transactions in the chain
-                    // or other transactions in the memory pool.
-                    if (!mempool.mapTx.count(txin.prevout.hash)) {
-                        LogPrintf("ERROR: mempool transaction missing input\n");
-                        if (fDebug) assert("mempool transaction missing input" == 0);
-                        fMissingInputs = true;
-                        if (porphan)
-                            vOrphan.pop_back();
-                        break;
-                    }
+            CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
+            nTotalIn += nValueIn;
 
-                    // Has to wait for dependencies
-                    if (!porphan) {
-                        // Use list for automatic deletion
-                        vOrphan.push_back(COrphan(&tx));
-                        porphan = &vOrphan.back();
-                    }
-                    mapDependers[txin.prevout.hash].push_back(porphan);
-                    porphan->setDependsOn.insert(txin.prevout.hash);
-                    nTotalIn += mempool.mapTx[txin.prevout.hash].GetTx().vout[txin.prevout.n].nValue;
-                    continue;
-                }
+            int nConf = nHeight - coins->nHeight;
 
-                //Check for invalid/fraudulent inputs. They shouldn't make it through mempool, but check anyways.
-                if (invalid_out::ContainsOutPoint(txin.prevout)) {
-                    LogPrintf("%s : found invalid input %s in tx %s", __func__, txin.prevout.ToString(), tx.GetHash().ToString());
-                    fMissingInputs = true;
-                    break;
-                }
+            // zBWI spends can have very large priority, use non-overflowing safe functions
+            dPriority = double_safe_addition(dPriority, ((double)nValueIn * nConf));
 
-                const CCoins* coins = view.AccessCoins(txin.prevout.hash);
-                assert(coins);
+        }
+        if (fMissingInputs) continue;
 
-                CAmount nValueIn = coins->vout[txin.prevout.n].nValue;
-                nTotalIn += nValueIn;
+        // Priority is sum(valuein * age) / modified_txsize
+        unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        dPriority = tx.ComputePriority(dPriority, nTxSize);
 
-                int nConf = nHeight - coins->nHeight;
+        uint256 hash = tx.GetHash();
+        mempool.ApplyDeltas(hash, dPriority, nTotalIn);
 
-                // zBWI spends can have very large priority, use non-overflowing safe functions
-                dPriority = double_safe_addition(dPriority, ((double)nValueIn * nConf));
+        CFeeRate feeRate(nTotalIn - tx.GetValueOut(), nTxSize);
 
-            }
-            if (fMissingInputs) continue;
+        if (porphan) {
+            porphan->dPriority = dPriority;
+            porphan->feeRate = feeRate;
+        } else
+            vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->second.GetTx()));
+    }
 
-            // Priority is sum(valuein * age) / modified_txsize
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            dPriority = tx.ComputePriority(dPriority, nTxSize);
+    // Collect transactions into block
+    uint64_t nBlockSize = 1000;
+    uint64_t nBlockTx = 0;
+    int nBlockSigOps = 100;
+    bool fSortedByFee = (nBlockPrioritySize <= 0);
+
+    TxPriorityCompare comparer(fSortedByFee);
+    std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
+
+    vector<CBigNum> vBlockSerials;
+    vector<CBigNum> vTxSerials;
+    while (!vecPriority.empty()) {
+        // Take highest priority transaction off the priority queue:
+        double dPriority = vecPriority.front().get<0>();
+        CFeeRate feeRate = vecPriority.front().get<1>();
+        const CTransaction& tx = *(vecPriority.front().get<2>());
+
+        std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
+        vecPriority.pop_back();
+
+        // Size limits
+        unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+        if (nBlockSize + nTxSize >= nBlockMaxSize)
+            continue;
 
-            uint256 hash = tx.GetHash();
-            mempool.ApplyDeltas(hash, dPriority, nTotalIn);
+        // Legacy limits on sigOps:
+        unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
+        unsigned int nTxSigOps = GetLegacySigOpCount(tx);
+        if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
+            continue;
 
-            CFeeRate feeRate(nTotalIn - tx.GetValueOut(), nTxSize);
+        // Skip free transactions if we're past the minimum block size:
+        const uint256& hash = tx.GetHash();
+        double dPriorityDelta = 0;
+        CAmount nFeeDelta = 0;
+        mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
+        if (!tx.IsZerocoinSpend() && fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+            continue;
 
-            if (porphan) {
-                porphan->dPriority = dPriority;
-                porphan->feeRate = feeRate;
-            } else
-                vecPriority.push_back(TxPriority(dPriority, feeRate, &mi->second.GetTx()));
+        // Prioritise by fee once past the priority size or we run out of high-priority
+        // transactions:
+        if (!fSortedByFee &&
+            ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
+            fSortedByFee = true;
+            comparer = TxPriorityCompare(fSortedByFee);
+            std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
         }
 
-        // Collect transactions into block
-        uint64_t nBlockSize = 1000;
-        uint64_t nBlockTx = 0;
-        int nBlockSigOps = 100;
-        bool fSortedByFee = (nBlockPrioritySize <= 0);
-
-        TxPriorityCompare comparer(fSortedByFee);
-        std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-
-        vector<CBigNum> vBlockSerials;
-        vector<CBigNum> vTxSerials;
-        while (!vecPriority.empty()) {
-            // Take highest priority transaction off the priority queue:
-            double dPriority = vecPriority.front().get<0>();
-            CFeeRate feeRate = vecPriority.front().get<1>();
-            const CTransaction& tx = *(vecPriority.front().get<2>());
-
-            std::pop_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            vecPriority.pop_back();
-
-            // Size limits
-            unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
-            if (nBlockSize + nTxSize >= nBlockMaxSize)
-                continue;
+        if (!view.HaveInputs(tx))
+            continue;
 
-            // Legacy limits on sigOps:
-            unsigned int nMaxBlockSigOps = MAX_BLOCK_SIGOPS_CURRENT;
-            unsigned int nTxSigOps = GetLegacySigOpCount(tx);
-            if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
+        // double check that there are no double spent zBWI spends in this block or tx
+        if (tx.IsZerocoinSpend()) {
+            int nHeightTx = 0;
+            if (IsTransactionInChain(tx.GetHash(), nHeightTx))
                 continue;
 
-            // Skip free transactions if we're past the minimum block size:
-            const uint256& hash = tx.GetHash();
-            double dPriorityDelta = 0;
-            CAmount nFeeDelta = 0;
-            mempool.ApplyDeltas(hash, dPriorityDelta, nFeeDelta);
-            if (!tx.IsZerocoinSpend() && fSortedByFee && (dPriorityDelta <= 0) && (nFeeDelta <= 0) && (feeRate < ::minRelayTxFee) && (nBlockSize + nTxSize >= nBlockMinSize))
+            bool fDoubleSerial = false;
+            for (const CTxIn& txIn : tx.vin) {
+                if (txIn.scriptSig.IsZerocoinSpend()) {
+                    libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
+                    bool fUseV1Params = libzerocoin::ExtractVersionFromSerial(spend.getCoinSerialNumber()) < libzerocoin::PrivateCoin::PUBKEY_VERSION;
+                    if (!spend.HasValidSerial(Params().Zerocoin_Params(fUseV1Params)))
+                        fDoubleSerial = true;
+                    if (count(vBlockSerials.begin(), vBlockSerials.end(), spend.getCoinSerialNumber()))
+                        fDoubleSerial = true;
+                    if (count(vTxSerials.begin(), vTxSerials.end(), spend.getCoinSerialNumber()))
+                        fDoubleSerial = true;
+                    if (fDoubleSerial)
+                        break;
+                    vTxSerials.emplace_back(spend.getCoinSerialNumber());
+                }
+            }
+            //This zBWI serial has already been included in the block, do not add this tx.
+            if (fDoubleSerial)
                 continue;
+        }
 
-            // Prioritise by fee once past the priority size or we run out of high-priority
-            // transactions:
-            if (!fSortedByFee &&
-                ((nBlockSize + nTxSize >= nBlockPrioritySize) || !AllowFree(dPriority))) {
-                fSortedByFee = true;
-                comparer = TxPriorityCompare(fSortedByFee);
-                std::make_heap(vecPriority.begin(), vecPriority.end(), comparer);
-            }
+        CAmount nTxFees = view.GetValueIn(tx) - tx.GetValueOut();
 
-            if (!view.HaveInputs(tx))
-                continue;
+        nTxSigOps += GetP2SHSigOpCount(tx, view);
+        if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
+            continue;
 
-            // double check that there are no double spent zBWI spends in this block or tx
-            if (tx.IsZerocoinSpend()) {
-                int nHeightTx = 0;
-                if (IsTransactionInChain(tx.GetHash(), nHeightTx))
-                    continue;
+        // Note that flags: we don't want to set mempool/IsStandard()
+        // policy here, but we still have to ensure that the block we
+        // create only contains transactions that are valid in new blocks.
+        CValidationState state;
+        if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
+            continue;
+
+        CTxUndo txundo;
+        UpdateCoins(tx, state, view, txundo, nHeight);
+
+        // Added
+        body.vtx.push_back(tx);
+        body.vTxFees.push_back(nTxFees);
+        body.vTxSigOps.push_back(nTxSigOps);
+        nBlockSize += nTxSize;
+        ++nBlockTx;
+        nBlockSigOps += nTxSigOps;
+        body.nFees += nTxFees;
+
+        for (const CBigNum& bnSerial : vTxSerials)
+            vBlockSerials.emplace_back(bnSerial);
+
+        if (fPrintPriority) {
+            LogPrintf("priority %.1f fee %s txid %s\n",
+                dPriority, feeRate.ToString(), tx.GetHash().ToString());
+        }
 
-                bool fDoubleSerial = false;
-                for (const CTxIn& txIn : tx.vin) {
-                    if (txIn.scriptSig.IsZerocoinSpend()) {
-                        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(txIn);
-                        bool fUseV1Params = libzerocoin::ExtractVersionFromSerial(spend.getCoinSerialNumber()) < libzerocoin::PrivateCoin::PUBKEY_VERSION;
-                        if (!spend.HasValidSerial(Params().Zerocoin_Params(fUseV1Params)))
-                            fDoubleSerial = true;
-                        if (count(vBlockSerials.begin(), vBlockSerials.end(), spend.getCoinSerialNumber()))
-                            fDoubleSerial = true;
-                        if (count(vTxSerials.begin(), vTxSerials.end(), spend.getCoinSerialNumber()))
-                            fDoubleSerial = true;
-                        if (fDoubleSerial)
-                            break;
-                        vTxSerials.emplace_back(spend.getCoinSerialNumber());
+        // Add transactions that depend on this one to the priority queue
+        if (mapDependers.count(hash)) {
+            BOOST_FOREACH (COrphan* porphan, mapDependers[hash]) {
+                if (!porphan->setDependsOn.empty()) {
+                    porphan->setDependsOn.erase(hash);
+                    if (porphan->setDependsOn.empty()) {
+                        vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
+                        std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
                     }
                 }
-                //This zBWI serial has already been included in the block, do not add this tx.
-                if (fDoubleSerial)
-                    continue;
             }
+        }
+    }
 
-            CAmount nTxFees = view.GetValueIn(tx) - tx.GetValueOut();
+    body.nBlockSize = nBlockSize;
+    body.nBlockTx = nBlockTx;
+}
 
-            nTxSigOps += GetP2SHSigOpCount(tx, view);
-            if (nBlockSigOps + nTxSigOps >= nMaxBlockSigOps)
-                continue;
+// Block body kept ready by the stake minter so that a kernel hit doesn't wait for transaction selection, guarded by cs_main
+static CBlockBody blockBodyStake;
 
-            // Note that flags: we don't want to set mempool/IsStandard()
-            // policy here, but we still have to ensure that the block we
-            // create only contains transactions that are valid in new blocks.
-            CValidationState state;
+// Whether a transaction in the body spends the coinstake's input, or for zPoS the same serial
+static bool BodyConflictsWithStake(const CBlockBody& body, const CTxIn& txinStake)
+{
+    const bool fZerocoinStake = txinStake.scriptSig.IsZerocoinSpend();
+    CBigNum bnSerialStake;
+    if (fZerocoinStake)
+        bnSerialStake = TxInToZerocoinSpend(txinStake).getCoinSerialNumber();
+
+    for (const CTransaction& tx : body.vtx) {
+        for (const CTxIn& txin : tx.vin) {
+            if (!fZerocoinStake && txin.prevout == txinStake.prevout)
+                return true;
+            if (fZerocoinStake && txin.scriptSig.IsZerocoinSpend() && TxInToZerocoinSpend(txin).getCoinSerialNumber() == bnSerialStake)
+                return true;
+        }
+    }
+    return false;
+}
+
+// Check the transactions of a body the way ConnectBlock() would on top of pindexPrev. TestBlockValidity()
+// needs the coinstake, which is only found later, so the body is tested on its own while it is selected.
+static bool TestBlockBodyValidity(const CBlockBody& body, CBlockIndex* pindexPrev)
+{
+    AssertLockHeld(cs_main);
+
+    const int nHeight = pindexPrev->nHeight + 1;
+    const bool fZerocoinActive = GetAdjustedTime() >= Params().Zerocoin_StartTime();
+    CCoinsViewCache view(pcoinsTip);
+    std::set<CBigNum> setSerials;
+    unsigned int nSigOps = 0;
+    for (const CTransaction& tx : body.vtx) {
+        CValidationState state;
+        if (!CheckTransaction(tx, fZerocoinActive, true, state))
+            return error("%s : CheckTransaction failed for tx %s", __func__, tx.GetHash().GetHex());
+        if (!IsFinalTx(tx, nHeight, GetAdjustedTime()))
+            return error("%s : tx %s is not final", __func__, tx.GetHash().GetHex());
+
+        nSigOps += GetLegacySigOpCount(tx);
+        if (tx.IsZerocoinSpend()) {
+            int nHeightTx = 0;
+            if (IsTransactionInChain(tx.GetHash(), nHeightTx))
+                return error("%s : tx %s is already in block %d", __func__, tx.GetHash().GetHex(), nHeightTx);
+            for (const CTxIn& txin : tx.vin) {
+                if (!txin.scriptSig.IsZerocoinSpend())
+                    continue;
+                const CBigNum bnSerial = TxInToZerocoinSpend(txin).getCoinSerialNumber();
+                if (!setSerials.insert(bnSerial).second || IsSerialInBlockchain(bnSerial, nHeightTx))
+                    return error("%s : serial %s in tx %s is already spent", __func__, bnSerial.GetHex(), tx.GetHash().GetHex());
+            }
+        } else {
+            if (!view.HaveInputs(tx))
+                return error("%s : inputs of tx %s are missing or spent", __func__, tx.GetHash().GetHex());
+            for (const CTxIn& txin : tx.vin) {
+                if (!ValidOutPoint(txin.prevout, nHeight))
+                    return error("%s : tx %s spends invalid input %s", __func__, tx.GetHash().GetHex(), txin.prevout.ToString());
+            }
+            nSigOps += GetP2SHSigOpCount(tx, view);
             if (!CheckInputs(tx, state, view, true, MANDATORY_SCRIPT_VERIFY_FLAGS, true))
-                continue;
+                return error("%s : CheckInputs failed for tx %s", __func__, tx.GetHash().GetHex());
+        }
+        if (nSigOps > MAX_BLOCK_SIGOPS_CURRENT)
+            return error("%s : too many sigops", __func__);
 
-            CTxUndo txundo;
-            UpdateCoins(tx, state, view, txundo, nHeight);
+        CTxUndo txundo;
+        UpdateCoins(tx, state, view, txundo, nHeight);
+    }
+    return true;
+}
 
-            // Added
-            pblock->vtx.push_back(tx);
-            pblocktemplate->vTxFees.push_back(nTxFees);
-            pblocktemplate->vTxSigOps.push_back(nTxSigOps);
-            nBlockSize += nTxSize;
-            ++nBlockTx;
-            nBlockSigOps += nTxSigOps;
-            nFees += nTxFees;
+// Reselect the stake minter's block body after a tip change, or after a mempool change once it is a few seconds old
+static void UpdateBlockBodyStake()
+{
+    LOCK2(cs_main, mempool.cs);
+    CBlockIndex* pindexPrev = chainActive.Tip();
+    if (blockBodyStake.hashPrevBlock == pindexPrev->GetBlockHash() &&
+        (blockBodyStake.nTransactionsUpdated == mempool.GetTransactionsUpdated() || GetTimeMillis() - blockBodyStake.nTimeCreated < 5000))
+        return;
 
-            for (const CBigNum& bnSerial : vTxSerials)
-                vBlockSerials.emplace_back(bnSerial);
+    int64_t nTimeStart = GetTimeMillis();
+    CreateBlockBody(blockBodyStake, pindexPrev);
+    // a body that fails is dropped, so the next kernel gets a block selected as before
+    if (!TestBlockBodyValidity(blockBodyStake, pindexPrev)) {
+        LogPrintf("%s : block body for height %d failed validation\n", __func__, pindexPrev->nHeight + 1);
+        blockBodyStake = CBlockBody();
+        return;
+    }
+    LogPrint("staking", "%s : %u transactions selected for height %d in %dms\n", __func__, blockBodyStake.nBlockTx, pindexPrev->nHeight + 1, GetTimeMillis() - nTimeStart);
+}
 
-            if (fPrintPriority) {
-                LogPrintf("priority %.1f fee %s txid %s\n",
-                    dPriority, feeRate.ToString(), tx.GetHash().ToString());
-            }
+// Forget the stake minter's block body, so that the next block does not reuse one that was rejected
+static void ClearBlockBodyStake()
+{
+    LOCK(cs_main);
+    blockBodyStake = CBlockBody();
+}
 
-            // Add transactions that depend on this one to the priority queue
-            if (mapDependers.count(hash)) {
-                BOOST_FOREACH (COrphan* porphan, mapDependers[hash]) {
-                    if (!porphan->setDependsOn.empty()) {
-                        porphan->setDependsOn.erase(hash);
-                        if (porphan->setDependsOn.empty()) {
-                            vecPriority.push_back(TxPriority(porphan->dPriority, porphan->feeRate, porphan->ptx));
-                            std::push_heap(vecPriority.begin(), vecPriority.end(), comparer);
-                        }
-                    }
-                }
-            }
+std::pair<int, std::pair<uint256, uint256> > pCheckpointCache;
+CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake, unsigned int nTimeStakeSearchedTo)
+{
+    CReserveKey reservekey(pwallet);
+
+    // Create new block
+    unique_ptr<CBlockTemplate> pblocktemplate(new CBlockTemplate());
+    if (!pblocktemplate.get())
+        return NULL;
+    CBlock* pblock = &pblocktemplate->block; // pointer for convenience
+
+    // -regtest only: allow overriding block.nVersion with
+    // -blockversion=N to test forking scenarios
+    if (Params().MineBlocksOnDemand())
+        pblock->nVersion = GetArg("-blockversion", pblock->nVersion);
+
+    // Make sure to create the correct block version after zerocoin is enabled
+    bool fZerocoinActive = GetAdjustedTime() >= Params().Zerocoin_StartTime();
+    if (fZerocoinActive)
+        pblock->nVersion = 4;
+    else
+        pblock->nVersion = 3;
+
+    // Create coinbase tx
+    CMutableTransaction txNew;
+    txNew.vin.resize(1);
+    txNew.vin[0].prevout.SetNull();
+    txNew.vout.resize(1);
+    txNew.vout[0].scriptPubKey = scriptPubKeyIn;
+    pblock->vtx.push_back(txNew);
+    pblocktemplate->vTxFees.push_back(-1);   // updated at end
+    pblocktemplate->vTxSigOps.push_back(-1); // updated at end
+
+    // ppcoin: if coinstake available add coinstake tx
+    if (fProofOfStake) {
+        boost::this_thread::interruption_point();
+        pblock->nTime = GetAdjustedTime();
+        CBlockIndex* pindexPrev = chainActive.Tip();
+        pblock->nBits = GetNextWorkRequired(pindexPrev, pblock);
+        CMutableTransaction txCoinStake;
+        int64_t nSearchTime = pblock->nTime; // search to current time
+        bool fStakeFound = false;
+        unsigned int nTxNewTime = 0;
+        if (pwallet->CreateCoinStake(*pwallet, pblock->nBits, nTimeStakeSearchedTo, txCoinStake, nTxNewTime)) {
+            pblock->nTime = nTxNewTime;
+            pblock->vtx[0].vout[0].SetEmpty();
+            pblock->vtx.push_back(CTransaction(txCoinStake));
+            fStakeFound = true;
         }
+        // the timestamps this search hashed, skipping those the scheduler had already searched
+        nLastCoinStakeSearchInterval = nSearchTime + STAKE_HASH_DRIFT - std::max(nSearchTime, (int64_t)nTimeStakeSearchedTo);
+
+        if (!fStakeFound)
+            return NULL;
+    }
+
+    // Collect memory pool transactions into the block
+    CAmount nFees = 0;
+
+    {
+        LOCK2(cs_main, mempool.cs);
+
+        CBlockIndex* pindexPrev = chainActive.Tip();
+        const int nHeight = pindexPrev->nHeight + 1;
+
+        // A body prepared by the stake minter is used as long as it was built on this tip and doesn't
+        // spend the coinstake's input or serial. It was validated when it was selected, and ProcessNewBlock()
+        // validates the whole block again before it is relayed.
+        const bool fPrebuilt = fProofOfStake && blockBodyStake.hashPrevBlock == pindexPrev->GetBlockHash() &&
+                               !BodyConflictsWithStake(blockBodyStake, pblock->vtx[1].vin[0]);
+
+        CBlockBody bodyNew;
+        if (!fPrebuilt)
+            CreateBlockBody(bodyNew, pindexPrev);
+        const CBlockBody& body = fPrebuilt ? blockBodyStake : bodyNew;
+
+        pblock->vtx.insert(pblock->vtx.end(), body.vtx.begin(), body.vtx.end());
+        pblocktemplate->vTxFees.insert(pblocktemplate->vTxFees.end(), body.vTxFees.begin(), body.vTxFees.end());
+        pblocktemplate->vTxSigOps.insert(pblocktemplate->vTxSigOps.end(), body.vTxSigOps.begin(), body.vTxSigOps.end());
+        nFees = body.nFees;
+        uint64_t nBlockSize = body.nBlockSize;
+        uint64_t nBlockTx = body.nBlockTx;
 
         if (!fProofOfStake) {
             txNew.vout[0].nValue = GetBlockValue(nHeight - 1);
@@ -471,11 +617,10 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
         pblocktemplate->vTxSigOps[0] = GetLegacySigOpCount(pblock->vtx[0]);
 
         CValidationState state;
-        if(CBlockIndex(*pblock).nHeight >= 212)
+        if(!fPrebuilt && CBlockIndex(*pblock).nHeight >= 212)
         {
             if (!TestBlockValidity(state, *pblock, pindexPrev, false, false)) {
                 LogPrintf("CreateNewBlock() : TestBlockValidity failed\n");
-                mempool.clear();
                 return NULL;
             }
         }
@@ -519,14 +664,14 @@ void IncrementExtraNonce(CBlock* pblock, CBlockIndex* pindexPrev, unsigned int&
 double dHashesPerSec = 0.0;
 int64_t nHPSTimerStart = 0;
 
-CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet, bool fProofOfStake)
+CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet, bool fProofOfStake, unsigned int nTimeStakeSearchedTo)
 {
     CPubKey pubkey;
     if (!reservekey.GetReservedKey(pubkey))
         return NULL;
 
     CScript scriptPubKey = CScript() << ToByteVector(pubkey) << OP_CHECKSIG;
-    return CreateNewBlock(scriptPubKey, pwallet, fProofOfStake);
+    return CreateNewBlock(scriptPubKey, pwallet, fProofOfStake, nTimeStakeSearchedTo);
 }
 
 bool ProcessBlockFound(CBlock* pblock, CWallet& wallet, CReserveKey& reservekey)
@@ -572,103 +717,213 @@ bool fGenerateBitcoins = false;
 bool fMintableCoins = false;
 int nMintableLastCheck = 0;
 
-// ***TODO*** that part changed in bitcoin, we are using a mix with old one here for now
+namespace
+{
+CCriticalSection cs_stakeMinterStats;
+CStakeMinterStats stakeMinterStats;
+
+/**
+ * Wakes the stake minter when the outcome of a kernel search can change: a new
+ * chain tip (new target and new maturities), a change to the wallet's coins, or,
+ * through the timed wait, a new timestamp slot entering the hash drift window.
+ */
+class CStakeScheduler : public CValidationInterface
+{
+private:
+    boost::signals2::scoped_connection connCoinsChanged;
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    bool fEvent;
+    int64_t nTimeEvent; // GetTimeMillis() of the earliest pending event
+
+    void Notify()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!fEvent) {
+            fEvent = true;
+            nTimeEvent = GetTimeMillis();
+        }
+        cond.notify_one();
+    }
+
+public:
+    explicit CStakeScheduler(CWallet* pwallet) : fEvent(true), nTimeEvent(GetTimeMillis())
+    {
+        RegisterValidationInterface(this);
+        connCoinsChanged = pwallet->NotifyTransactionChanged.connect(boost::bind(&CStakeScheduler::NotifyCoinsChanged, this, _1, _2, _3));
+    }
+
+    ~CStakeScheduler()
+    {
+        connCoinsChanged.disconnect();
+        UnregisterValidationInterface(this);
+    }
+
+    void UpdatedBlockTip(const CBlockIndex* pindex)
+    {
+        Notify();
+    }
+
+    void NotifyCoinsChanged(CWallet* wallet, const uint256& hashTx, ChangeType status)
+    {
+        Notify();
+    }
 
-void BitcoinMiner(CWallet* pwallet, bool fProofOfStake)
+    /** Sleep until an event arrives or until nTimeWake (GetTimeMillis()), whichever is first.
+     *  Returns true and the time of the event if one was pending. */
+    bool Wait(int64_t nTimeWake, int64_t& nTimeEventRet)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (!fEvent) {
+            int64_t nRemaining = nTimeWake - GetTimeMillis();
+            if (nRemaining <= 0)
+                return false;
+            cond.timed_wait(lock, boost::posix_time::milliseconds(nRemaining));
+        }
+        fEvent = false;
+        nTimeEventRet = nTimeEvent;
+        return true;
+    }
+};
+
+bool ProcessStakeFound(CBlock* pblock, CWallet* pwallet, CReserveKey& reservekey)
 {
-    LogPrintf("BITWIN24Miner started\n");
+    LogPrintf("CPUMiner : proof-of-stake block found %s \n", pblock->GetHash().ToString().c_str());
+    if (pblock->IsZerocoinStake()) {
+        //Find the key associated with the zerocoin that is being staked
+        libzerocoin::CoinSpend spend = TxInToZerocoinSpend(pblock->vtx[1].vin[0]);
+        CBigNum bnSerial = spend.getCoinSerialNumber();
+        CKey key;
+        if (!pwallet->GetZerocoinKey(bnSerial, key))
+            return error("%s: failed to find zBWI with serial %s, unable to sign block", __func__, bnSerial.GetHex());
+
+        //Sign block with the zBWI key
+        if (!SignBlockWithKey(*pblock, key))
+            return error("%s: Signing new block with zBWI key failed", __func__);
+    } else if (!SignBlock(*pblock, *pwallet)) {
+        return error("%s: Signing new block with UTXO key failed", __func__);
+    }
+
+    LogPrintf("CPUMiner : proof-of-stake block was signed %s \n", pblock->GetHash().ToString().c_str());
+    SetThreadPriority(THREAD_PRIORITY_NORMAL);
+    bool fAccepted = ProcessBlockFound(pblock, *pwallet, reservekey);
     SetThreadPriority(THREAD_PRIORITY_LOWEST);
-    RenameThread("bitwin24-miner");
+    return fAccepted;
+}
+} // anonymous namespace
+
+void GetStakeMinterStats(CStakeMinterStats& stats)
+{
+    LOCK(cs_stakeMinterStats);
+    stats = stakeMinterStats;
+}
+
+void StakeMinter(CWallet* pwallet)
+{
+    LogPrintf("BITWIN24 stake minter started\n");
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+    RenameThread("bitwin24-staker");
 
-    // Each thread has its own key and counter
     CReserveKey reservekey(pwallet);
     unsigned int nExtraNonce = 0;
 
-    while (fGenerateBitcoins || fProofOfStake) {
-        if (fProofOfStake) {
-            //control the amount of times the client will check for mintable coins
-            if ((GetTime() - nMintableLastCheck > 5 * 60)) // 5 minute check time
-            {
-                nMintableLastCheck = GetTime();
-                fMintableCoins = pwallet->MintableCoins();
-            }
+    CStakeScheduler scheduler(pwallet);
+    unsigned int nTimeSearchedTo = 0; // every kernel timestamp up to here has been hashed for the current tip and coins
+    int64_t nTimeReady = GetTimeMillis(); // when the current tip and coins became known
+    int64_t nTimeWake = 0;
+    while (true) {
+        int64_t nTimeEvent;
+        bool fEvent = scheduler.Wait(nTimeWake, nTimeEvent);
+        boost::this_thread::interruption_point();
 
-            if (chainActive.Tip()->nHeight < Params().LAST_POW_BLOCK()) {
-                MilliSleep(5000);
-                continue;
-            }
+        // wake up again once the next timestamp slot opens, unless an event comes first
+        nTimeWake = (GetTimeMillis() / 1000 + 1) * 1000;
 
-            while (vNodes.empty() || pwallet->IsLocked() || !fMintableCoins || (pwallet->GetBalance() > 0 && nReserveBalance >= pwallet->GetBalance())
-            || !masternodeSync.IsSynced()) {
-                nLastCoinStakeSearchInterval = 0;
-                // Do a separate 1 minute check here to ensure fMintableCoins is updated
-                if (!fMintableCoins) {
-                    if (GetTime() - nMintableLastCheck > 1 * 60) // 1 minute check time
-                    {
-                        nMintableLastCheck = GetTime();
-                        fMintableCoins = pwallet->MintableCoins();
-                    }
-                }
-                MilliSleep(5000);
-                if (!fGenerateBitcoins && !fProofOfStake)
-                    continue;
-            }
+        if (fEvent) {
+            // a new tip or changed coins invalidate what has been hashed so far
+            nTimeSearchedTo = 0;
+            nTimeReady = nTimeEvent;
+        }
 
-            if (mapHashedBlocks.count(chainActive.Tip()->nHeight)) //search our map of hashed blocks, see if bestblock has been hashed yet
-            {
-                if (GetTime() - mapHashedBlocks[chainActive.Tip()->nHeight] < max(pwallet->nHashInterval, (unsigned int)1)) // wait half of the nHashDrift with max wait of 3 minutes
-                {
-                    MilliSleep(5000);
-                    continue;
-                }
-            }
+        //control the amount of times the client will check for mintable coins
+        if (fEvent || GetTime() - nMintableLastCheck > 5 * 60) {
+            nMintableLastCheck = GetTime();
+            fMintableCoins = pwallet->MintableCoins();
         }
 
-        //
-        // Create new block
-        //
-        unsigned int nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+        if (chainActive.Tip()->nHeight < Params().LAST_POW_BLOCK() || vNodes.empty() || pwallet->IsLocked() || !fMintableCoins ||
+            (pwallet->GetBalance() > 0 && nReserveBalance >= pwallet->GetBalance()) || !masternodeSync.IsSynced()) {
+            // none of these raise an event when they clear, so poll them
+            nLastCoinStakeSearchInterval = 0;
+            nTimeWake = GetTimeMillis() + 5000;
+            continue;
+        }
+
+        // only hash when a timestamp has entered the window since the last pass
+        unsigned int nTimeSearch = GetAdjustedTime();
+        if (nTimeSearch + STAKE_HASH_DRIFT <= nTimeSearchedTo)
+            continue;
+
         CBlockIndex* pindexPrev = chainActive.Tip();
         if (!pindexPrev)
             continue;
 
-        unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlockWithKey(reservekey, pwallet, fProofOfStake));
-        if (!pblocktemplate.get())
+        unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlockWithKey(reservekey, pwallet, true, nTimeSearchedTo));
+        nTimeSearchedTo = nTimeSearch + STAKE_HASH_DRIFT;
+        {
+            LOCK(cs_stakeMinterStats);
+            stakeMinterStats.nPasses++;
+        }
+        if (!pblocktemplate.get()) {
+            // get the transactions for the next kernel ready while waiting for it
+            UpdateBlockBodyStake();
             continue;
+        }
 
         CBlock* pblock = &pblocktemplate->block;
         IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
 
-        //Stake miner main
-        if (fProofOfStake) {
-            LogPrintf("CPUMiner : proof-of-stake block found %s \n", pblock->GetHash().ToString().c_str());
-            if (pblock->IsZerocoinStake()) {
-                //Find the key associated with the zerocoin that is being staked
-                libzerocoin::CoinSpend spend = TxInToZerocoinSpend(pblock->vtx[1].vin[0]);
-                CBigNum bnSerial = spend.getCoinSerialNumber();
-                CKey key;
-                if (!pwallet->GetZerocoinKey(bnSerial, key)) {
-                    LogPrintf("%s: failed to find zBWI with serial %s, unable to sign block\n", __func__, bnSerial.GetHex());
-                    continue;
-                }
+        // the kernel could be found from the later of the last event and the moment its timestamp entered the window
+        int64_t nTimeSlotOpen = ((int64_t)pblock->nTime - STAKE_HASH_DRIFT - GetTimeOffset()) * 1000;
+        int64_t nLatency = std::max((int64_t)0, GetTimeMillis() - std::max(nTimeReady, nTimeSlotOpen));
+        {
+            LOCK(cs_stakeMinterStats);
+            stakeMinterStats.nKernelsFound++;
+            stakeMinterStats.nLastKernelLatency = nLatency;
+            stakeMinterStats.nTotalKernelLatency += nLatency;
+        }
+        LogPrint("staking", "%s: kernel found at height %d, %dms after it became possible\n", __func__, pindexPrev->nHeight + 1, nLatency);
 
-                //Sign block with the zBWI key
-                if (!SignBlockWithKey(*pblock, key)) {
-                    LogPrintf("BitcoinMiner(): Signing new block with zBWI key failed \n");
-                    continue;
-                }
-            } else if (!SignBlock(*pblock, *pwallet)) {
-                LogPrintf("BitcoinMiner(): Signing new block with UTXO key failed \n");
-                continue;
-            }
+        if (!ProcessStakeFound(pblock, pwallet, reservekey))
+            ClearBlockBodyStake();
+    }
+}
 
-            LogPrintf("CPUMiner : proof-of-stake block was signed %s \n", pblock->GetHash().ToString().c_str());
-            SetThreadPriority(THREAD_PRIORITY_NORMAL);
-            ProcessBlockFound(pblock, *pwallet, reservekey);
-            SetThreadPriority(THREAD_PRIORITY_LOWEST);
+void BitcoinMiner(CWallet* pwallet)
+{
+    LogPrintf("BITWIN24Miner started\n");
+    SetThreadPriority(THREAD_PRIORITY_LOWEST);
+    RenameThread("bitwin24-miner");
+
+    // Each thread has its own key and counter
+    CReserveKey reservekey(pwallet);
+    unsigned int nExtraNonce = 0;
+
+    while (fGenerateBitcoins) {
+        //
+        // Create new block
+        //
+        unsigned int nTransactionsUpdatedLast = mempool.GetTransactionsUpdated();
+        CBlockIndex* pindexPrev = chainActive.Tip();
+        if (!pindexPrev)
+            continue;
 
+        unique_ptr<CBlockTemplate> pblocktemplate(CreateNewBlockWithKey(reservekey, pwallet, false));
+        if (!pblocktemplate.get())
             continue;
-        }
+
+        CBlock* pblock = &pblocktemplate->block;
+        IncrementExtraNonce(pblock, pindexPrev, nExtraNonce);
 
         LogPrintf("Running BITWIN24Miner with %u transactions in block (%u bytes)\n", pblock->vtx.size(),
             ::GetSerializeSize(*pblock, SER_NETWORK, PROTOCOL_VERSION));
@@ -756,7 +1011,7 @@ void static ThreadBitcoinMiner(void* parg)
     boost::this_thread::interruption_point();
     CWallet* pwallet = (CWallet*)parg;
     try {
-        BitcoinMiner(pwallet, false);
+        BitcoinMiner(pwallet);
         boost::this_thread::interruption_point();
     } catch (std::exception& e) {
         LogPrintf("ThreadBitcoinMiner() exception");
@@ -21,14 +21,28 @@ struct CBlockTemplate;
 /** Run the miner threads */
 void GenerateBitcoins(bool fGenerate, CWallet* pwallet, int nThreads);
 /** Generate a new block, without valid proof-of-work */
-CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake);
-CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet, bool fProofOfStake);
+CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet, bool fProofOfStake, unsigned int nTimeStakeSearchedTo = 0);
+CBlockTemplate* CreateNewBlockWithKey(CReserveKey& reservekey, CWallet* pwallet, bool fProofOfStake, unsigned int nTimeStakeSearchedTo = 0);
 /** Modify the extranonce in a block */
 void IncrementExtraNonce(CBlock* pblock, CBlockIndex* pindexPrev, unsigned int& nExtraNonce);
 /** Check mined block */
 void UpdateTime(CBlockHeader* block, const CBlockIndex* pindexPrev);
 
-void BitcoinMiner(CWallet* pwallet, bool fProofOfStake);
+void BitcoinMiner(CWallet* pwallet);
+
+/** Kernel search statistics of the stake minter */
+struct CStakeMinterStats {
+    uint64_t nPasses;            // kernel search passes over the wallet's stakable inputs
+    uint64_t nKernelsFound;
+    int64_t nLastKernelLatency;  // milliseconds from a kernel becoming possible to it being found
+    int64_t nTotalKernelLatency;
+
+    CStakeMinterStats() : nPasses(0), nKernelsFound(0), nLastKernelLatency(0), nTotalKernelLatency(0) {}
+};
+
+/** Run the stake minter, hashing each new kernel timestamp as soon as it becomes possible */
+void StakeMinter(CWallet* pwallet);
+void GetStakeMinterStats(CStakeMinterStats& stats);
 
 extern double dHashesPerSec;
 extern int64_t nHPSTimerStart;
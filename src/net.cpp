@@ -1562,7 +1562,7 @@ void static ThreadStakeMinter()
     LogPrintf("ThreadStakeMinter started\n");
     CWallet* pwallet = pwalletMain;
     try {
-        BitcoinMiner(pwallet, true);
+        StakeMinter(pwallet);
         boost::this_thread::interruption_point();
     } catch (std::exception& e) {
         LogPrintf("ThreadStakeMinter() exception \n");
@@ -1771,8 +1771,13 @@ void StartNode(boost::thread_group& threadGroup, CScheduler& scheduler)
     scheduler.scheduleEvery(&DumpData, DUMP_ADDRESSES_INTERVAL);
 
     // ppcoin:mint proof-of-stake blocks in the background
-    if (GetBoolArg("-staking", true))
+    if (GetBoolArg("-staking", true)) {
+        LogPrintf("Using %d threads for stake kernel search\n", nStakeThreads);
+        GetMainSignals().UpdatedBlockTip.connect(&StakeKernelTipChanged);
+        for (int i = 0; i < nStakeThreads - 1; i++)
+            threadGroup.create_thread(&ThreadStakeKernelCheck);
         threadGroup.create_thread(boost::bind(&TraceThread<void (*)()>, "stakemint", &ThreadStakeMinter));
+    }
 }
 
 bool StopNode()
@@ -0,0 +1,195 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITWIN24_POOLALLOC_H
+#define BITWIN24_POOLALLOC_H
+
+#include <algorithm>
+#include <memory>
+#include <new>
+#include <stddef.h>
+#include <utility>
+#include <vector>
+
+/**
+ * Hands out small blocks carved from large chunks, with one free list per size class. Node based
+ * containers that use it through CPoolAllocator pay neither the per allocation overhead of the
+ * general purpose allocator nor its scattering of nodes over the heap. Freed blocks are reused
+ * by later allocations of the same size; the chunks are only returned by Release(), once every
+ * block is free again. Not thread safe, like the containers using it.
+ */
+class CPoolResource
+{
+public:
+    static const size_t ALIGN = 16;
+    static const size_t MAX_BLOCK_SIZE = 256;
+
+private:
+    static const size_t MIN_CHUNK_SIZE = 16 << 10;
+    static const size_t MAX_CHUNK_SIZE = 1 << 20;
+
+    struct CFreeBlock {
+        CFreeBlock* pnext;
+    };
+
+    CFreeBlock* vFree[MAX_BLOCK_SIZE / ALIGN];
+    std::vector<char*> vChunks;
+    size_t nChunkSize;
+    //! Unused tail of the last chunk
+    char* pAvailable;
+    size_t nAvailable;
+    size_t nChunkBytes;
+    size_t nUsed;
+
+    CPoolResource(const CPoolResource&);
+    CPoolResource& operator=(const CPoolResource&);
+
+    static size_t SizeClass(size_t nBytes) { return (nBytes + ALIGN - 1) / ALIGN - 1; }
+
+public:
+    CPoolResource() : nChunkSize(MIN_CHUNK_SIZE), pAvailable(NULL), nAvailable(0), nChunkBytes(0), nUsed(0)
+    {
+        std::fill(vFree, vFree + MAX_BLOCK_SIZE / ALIGN, (CFreeBlock*)NULL);
+    }
+
+    ~CPoolResource()
+    {
+        for (char* pchunk : vChunks)
+            ::operator delete(pchunk);
+    }
+
+    static bool IsPooled(size_t nBytes) { return nBytes > 0 && nBytes <= MAX_BLOCK_SIZE; }
+
+    void* Allocate(size_t nBytes)
+    {
+        const size_t nClass = SizeClass(nBytes);
+        nUsed++;
+        if (vFree[nClass]) {
+            CFreeBlock* pblock = vFree[nClass];
+            vFree[nClass] = pblock->pnext;
+            return pblock;
+        }
+        const size_t nBlockSize = (nClass + 1) * ALIGN;
+        if (nAvailable < nBlockSize) {
+            // Put the rest of the old chunk on the free lists before starting a new one
+            while (nAvailable >= ALIGN) {
+                size_t nRest = SizeClass(nAvailable + 1) * ALIGN;
+                Deallocate(pAvailable, nRest);
+                nUsed++;
+                pAvailable += nRest;
+                nAvailable -= nRest;
+            }
+            vChunks.push_back(static_cast<char*>(::operator new(nChunkSize)));
+            pAvailable = vChunks.back();
+            nAvailable = nChunkSize;
+            nChunkBytes += nChunkSize;
+            nChunkSize = std::min(nChunkSize * 2, MAX_CHUNK_SIZE);
+        }
+        void* p = pAvailable;
+        pAvailable += nBlockSize;
+        nAvailable -= nBlockSize;
+        return p;
+    }
+
+    void Deallocate(void* p, size_t nBytes)
+    {
+        const size_t nClass = SizeClass(nBytes);
+        CFreeBlock* pblock = static_cast<CFreeBlock*>(p);
+        pblock->pnext = vFree[nClass];
+        vFree[nClass] = pblock;
+        nUsed--;
+    }
+
+    /** Give the chunks back if no block is in use */
+    void Release()
+    {
+        if (nUsed)
+            return;
+        for (char* pchunk : vChunks)
+            ::operator delete(pchunk);
+        std::vector<char*>().swap(vChunks);
+        std::fill(vFree, vFree + MAX_BLOCK_SIZE / ALIGN, (CFreeBlock*)NULL);
+        nChunkSize = MIN_CHUNK_SIZE;
+        pAvailable = NULL;
+        nAvailable = 0;
+        nChunkBytes = 0;
+    }
+
+    //! Bytes held in chunks, used or not
+    size_t DynamicUsage() const { return nChunkBytes + vChunks.capacity() * sizeof(char*); }
+    //! Blocks handed out and not freed
+    size_t GetUsedBlocks() const { return nUsed; }
+};
+
+/**
+ * Allocator drawing single objects from a shared CPoolResource. Arrays, such as hash table bucket
+ * arrays, and allocators without a resource fall back to operator new.
+ */
+template <typename T>
+class CPoolAllocator
+{
+public:
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+    typedef ptrdiff_t difference_type;
+
+    template <typename U>
+    struct rebind {
+        typedef CPoolAllocator<U> other;
+    };
+
+    std::shared_ptr<CPoolResource> resource;
+
+    CPoolAllocator() {}
+    explicit CPoolAllocator(const std::shared_ptr<CPoolResource>& resourceIn) : resource(resourceIn) {}
+    template <typename U>
+    CPoolAllocator(const CPoolAllocator<U>& other) : resource(other.resource) {}
+
+    T* allocate(size_t n, const void* hint = 0)
+    {
+        if (resource && n == 1 && alignof(T) <= CPoolResource::ALIGN && CPoolResource::IsPooled(sizeof(T)))
+            return static_cast<T*>(resource->Allocate(sizeof(T)));
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t n)
+    {
+        if (resource && n == 1 && alignof(T) <= CPoolResource::ALIGN && CPoolResource::IsPooled(sizeof(T)))
+            resource->Deallocate(p, sizeof(T));
+        else
+            ::operator delete(p);
+    }
+
+    size_t max_size() const { return size_t(-1) / sizeof(T); }
+
+    template <typename U, typename... Args>
+    void construct(U* p, Args&&... args)
+    {
+        ::new ((void*)p) U(std::forward<Args>(args)...);
+    }
+
+    template <typename U>
+    void destroy(U* p)
+    {
+        p->~U();
+    }
+};
+
+template <typename T, typename U>
+bool operator==(const CPoolAllocator<T>& a, const CPoolAllocator<U>& b)
+{
+    return a.resource == b.resource;
+}
+
+template <typename T, typename U>
+bool operator!=(const CPoolAllocator<T>& a, const CPoolAllocator<U>& b)
+{
+    return !(a == b);
+}
+
+#endif // BITWIN24_POOLALLOC_H
@@ -207,6 +207,7 @@ static bool rest_block(HTTPRequest* req,
 
     CBlock block;
     CBlockIndex* pblockindex = NULL;
+    CDiskBlockPos pos;
     {
         LOCK(cs_main);
         if (mapBlockIndex.count(hash) == 0)
@@ -216,12 +217,15 @@ static bool rest_block(HTTPRequest* req,
         if (!(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
 
-        if (!ReadBlockFromDisk(block, pblockindex))
+        // binary and hex output are the stored bytes, only JSON needs the block itself
+        pos = pblockindex->GetBlockPos();
+        if (rf == RF_JSON && !ReadBlockFromDisk(block, pblockindex))
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
     CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
+    if (rf != RF_JSON && !ReadRawBlockFromDisk(ssBlock, pos))
+        return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
 
     switch (rf) {
     case RF_BINARY: {
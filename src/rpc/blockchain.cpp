@@ -6,6 +6,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "blockcache.h"
 #include "checkpoints.h"
 #include "clientversion.h"
 #include "main.h"
@@ -16,6 +17,7 @@
 #include "utilmoneystr.h"
 #include "accumulatormap.h"
 #include "accumulators.h"
+#include "zbwispendcache.h"
 
 #include <stdint.h>
 #include <univalue.h>
@@ -427,6 +429,8 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
             "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
+            "  \"cache_usage\": n,       (numeric) Memory used by the coins and zerocoin caches, in bytes, before this call flushed them\n"
+            "  \"cache_max\": n          (numeric) Usage at which the caches are flushed, in bytes (see -dbcache)\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -437,6 +441,7 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
     UniValue ret(UniValue::VOBJ);
 
     CCoinsStats stats;
+    const size_t nCacheUsage = pcoinsTip->DynamicMemoryUsage() + pzerocoinTip->DynamicMemoryUsage();
     FlushStateToDisk();
     if (pcoinsTip->GetStats(stats)) {
         ret.push_back(Pair("height", (int64_t)stats.nHeight));
@@ -446,6 +451,8 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
         ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
         ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
         ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+        ret.push_back(Pair("cache_usage", (int64_t)nCacheUsage));
+        ret.push_back(Pair("cache_max", (int64_t)nCoinCacheUsage));
     }
     return ret;
 }
@@ -787,7 +794,10 @@ UniValue mempoolInfoToJSON()
     UniValue ret(UniValue::VOBJ);
     ret.push_back(Pair("size", (int64_t) mempool.size()));
     ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalTxSize()));
-    //ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+    ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
+    size_t maxmempool = GetArg("-maxmempool", DEFAULT_MAX_MEMPOOL_SIZE) << 20;
+    ret.push_back(Pair("maxmempool", (int64_t) maxmempool));
+    ret.push_back(Pair("mempoolminfee", ValueFromAmount(mempool.GetMinFee(maxmempool).GetFeePerK())));
 
     return ret;
 }
@@ -803,6 +813,9 @@ UniValue getmempoolinfo(const UniValue& params, bool fHelp)
             "{\n"
             "  \"size\": xxxxx                (numeric) Current tx count\n"
             "  \"bytes\": xxxxx               (numeric) Sum of all tx sizes\n"
+            "  \"usage\": xxxxx               (numeric) Total memory usage for the mempool\n"
+            "  \"maxmempool\": xxxxx          (numeric) Maximum memory usage for the mempool\n"
+            "  \"mempoolminfee\": xxxxx       (numeric) Minimum fee per kB for tx to be accepted\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -912,7 +925,7 @@ UniValue findserial(const UniValue& params, bool fHelp)
 	throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Invalid serial");
 
     uint256 txid = 0;
-    bool fSuccess = zerocoinDB->ReadCoinSpend(bnSerial, txid);
+    bool fSuccess = pzerocoinTip->ReadCoinSpend(bnSerial, txid);
 
     UniValue ret(UniValue::VOBJ);
     ret.push_back(Pair("success", fSuccess));
@@ -951,4 +964,66 @@ UniValue getaccumulatorvalues(const UniValue& params, bool fHelp)
     }
 
     return ret;
-}
\ No newline at end of file
+}
+
+UniValue getblockcacheinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getblockcacheinfo\n"
+            "\nReturns statistics of the cache of recently used blocks.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"blocks\": xxxxx              (numeric) Number of cached blocks\n"
+            "  \"usage\": xxxxx               (numeric) Estimated memory used by the cache, in bytes\n"
+            "  \"maxusage\": xxxxx            (numeric) Memory limit of the cache (-blockcachesize), in bytes\n"
+            "  \"hits\": xxxxx                (numeric) Block reads served from the cache\n"
+            "  \"misses\": xxxxx              (numeric) Block reads that went to disk\n"
+            "  \"rawhits\": xxxxx             (numeric) Blocks sent to peers without serializing them again\n"
+            "  \"rawmisses\": xxxxx           (numeric) Blocks serialized for sending to peers\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getblockcacheinfo", "") + HelpExampleRpc("getblockcacheinfo", ""));
+
+    CBlockCacheStats stats = blockcache.GetStats();
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("blocks", (int64_t)stats.nBlocks));
+    ret.push_back(Pair("usage", (int64_t)stats.nUsage));
+    ret.push_back(Pair("maxusage", (int64_t)stats.nMaxUsage));
+    ret.push_back(Pair("hits", (int64_t)stats.nHits));
+    ret.push_back(Pair("misses", (int64_t)stats.nMisses));
+    ret.push_back(Pair("rawhits", (int64_t)stats.nRawHits));
+    ret.push_back(Pair("rawmisses", (int64_t)stats.nRawMisses));
+    return ret;
+}
+
+UniValue getzerocoinspendcacheinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getzerocoinspendcacheinfo\n"
+            "\nReturns statistics of the cache of verified zerocoin spend proofs.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"size\": xxxxx                (numeric) Number of cached verified spends\n"
+            "  \"maxsize\": xxxxx             (numeric) Maximum number of cached verified spends\n"
+            "  \"hits\": xxxxx                (numeric) Spend verifications skipped thanks to the cache\n"
+            "  \"misses\": xxxxx              (numeric) Spend verifications that were not cached\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getzerocoinspendcacheinfo", "") + HelpExampleRpc("getzerocoinspendcacheinfo", ""));
+
+    CZerocoinSpendCacheStats stats = GetZerocoinSpendCacheStats();
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("size", (int64_t)stats.nSize));
+    ret.push_back(Pair("maxsize", (int64_t)stats.nMaxSize));
+    ret.push_back(Pair("hits", (int64_t)stats.nHits));
+    ret.push_back(Pair("misses", (int64_t)stats.nMisses));
+    return ret;
+}
@@ -10,6 +10,7 @@
 #include "init.h"
 #include "main.h"
 #include "masternode-sync.h"
+#include "miner.h"
 #include "net.h"
 #include "netbase.h"
 #include "rpc/server.h"
@@ -567,6 +568,10 @@ UniValue getstakingstatus(const UniValue& params, bool fHelp)
             "  \"enoughcoins\": true|false,        (boolean) if available coins are greater than reserve balance\n"
             "  \"mnsync\": true|false,             (boolean) if masternode data is synced\n"
             "  \"staking status\": true|false,     (boolean) if the wallet is staking or not\n"
+            "  \"searchpasses\": n,                (numeric) kernel search passes since startup\n"
+            "  \"kernelsfound\": n,                (numeric) kernels found since startup\n"
+            "  \"lastkernellatency\": n,           (numeric) milliseconds from the last kernel becoming possible to it being found\n"
+            "  \"avgkernellatency\": n,            (numeric) average of lastkernellatency over all kernels found\n"
             "}\n"
 
             "\nExamples:\n" +
@@ -595,6 +600,13 @@ UniValue getstakingstatus(const UniValue& params, bool fHelp)
         nStaking = true;
     obj.push_back(Pair("staking status", nStaking));
 
+    CStakeMinterStats stats;
+    GetStakeMinterStats(stats);
+    obj.push_back(Pair("searchpasses", stats.nPasses));
+    obj.push_back(Pair("kernelsfound", stats.nKernelsFound));
+    obj.push_back(Pair("lastkernellatency", stats.nLastKernelLatency));
+    obj.push_back(Pair("avgkernellatency", stats.nKernelsFound ? stats.nTotalKernelLatency / (int64_t)stats.nKernelsFound : 0));
+
     return obj;
 }
 #endif // ENABLE_WALLET
@@ -316,6 +316,8 @@ static const CRPCCommand vRPCCommands[] =
         {"blockchain", "invalidateblock", &invalidateblock, true, true, false},
         {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false},
         {"blockchain", "verifychain", &verifychain, true, false, false},
+        {"blockchain", "getblockcacheinfo", &getblockcacheinfo, true, false, false},
+        {"blockchain", "getzerocoinspendcacheinfo", &getzerocoinspendcacheinfo, true, false, false},
 
         /* Mining */
         {"mining", "getblocktemplate", &getblocktemplate, true, false, false},
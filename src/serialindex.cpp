@@ -0,0 +1,138 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "serialindex.h"
+
+/** Table slots allocated at least, and filter bits per slot */
+static const size_t SERIAL_INDEX_MIN_SLOTS = 1024;
+static const size_t SERIAL_FILTER_BITS_PER_SLOT = 8;
+/** With at most half of the slots used that is 16 bits per serial, about 0.1% false positives */
+static const int SERIAL_FILTER_PROBES = 6;
+
+CSerialIndex::CSerialIndex() : nEntries(0)
+{
+    Rehash(SERIAL_INDEX_MIN_SLOTS);
+}
+
+size_t CSerialIndex::Find(const uint256& hashSerial) const
+{
+    const size_t nMask = vTable.size() - 1;
+    size_t nSlot = hashSerial.Get64(0) & nMask;
+    while (vTable[nSlot].hashSerial != 0 && vTable[nSlot].hashSerial != hashSerial)
+        nSlot = (nSlot + 1) & nMask;
+    return nSlot;
+}
+
+bool CSerialIndex::FilterContains(const uint256& hashSerial) const
+{
+    const uint64_t nBits = vFilter.size() * 64;
+    const uint64_t h1 = hashSerial.Get64(1);
+    const uint64_t h2 = hashSerial.Get64(2) | 1;
+    for (int i = 0; i < SERIAL_FILTER_PROBES; i++) {
+        uint64_t nBit = (h1 + i * h2) & (nBits - 1);
+        if (!(vFilter[nBit >> 6] & ((uint64_t)1 << (nBit & 63))))
+            return false;
+    }
+    return true;
+}
+
+void CSerialIndex::FilterInsert(const uint256& hashSerial)
+{
+    const uint64_t nBits = vFilter.size() * 64;
+    const uint64_t h1 = hashSerial.Get64(1);
+    const uint64_t h2 = hashSerial.Get64(2) | 1;
+    for (int i = 0; i < SERIAL_FILTER_PROBES; i++) {
+        uint64_t nBit = (h1 + i * h2) & (nBits - 1);
+        vFilter[nBit >> 6] |= (uint64_t)1 << (nBit & 63);
+    }
+}
+
+void CSerialIndex::Rehash(size_t nSlots)
+{
+    std::vector<CEntry> vOld;
+    vOld.swap(vTable);
+    CEntry empty;
+    empty.hashSerial = 0;
+    empty.txid = 0;
+    empty.nHeight = -1;
+    vTable.assign(nSlots, empty);
+    vFilter.assign(nSlots * SERIAL_FILTER_BITS_PER_SLOT / 64, 0);
+    for (const CEntry& entry : vOld) {
+        if (entry.hashSerial == 0)
+            continue;
+        vTable[Find(entry.hashSerial)] = entry;
+        FilterInsert(entry.hashSerial);
+    }
+}
+
+void CSerialIndex::Insert(const uint256& hashSerial, const uint256& txid, int nHeight)
+{
+    if ((nEntries + 1) * 2 > vTable.size())
+        Rehash(vTable.size() * 2);
+    CEntry& entry = vTable[Find(hashSerial)];
+    if (entry.hashSerial == 0) {
+        entry.hashSerial = hashSerial;
+        nEntries++;
+        FilterInsert(hashSerial);
+    }
+    entry.txid = txid;
+    entry.nHeight = nHeight;
+}
+
+bool CSerialIndex::Lookup(const uint256& hashSerial, uint256& txid, int& nHeight) const
+{
+    if (!FilterContains(hashSerial))
+        return false;
+    const CEntry& entry = vTable[Find(hashSerial)];
+    if (entry.hashSerial == 0)
+        return false;
+    txid = entry.txid;
+    nHeight = entry.nHeight;
+    return true;
+}
+
+bool CSerialIndex::SetHeight(const uint256& hashSerial, int nHeight)
+{
+    CEntry& entry = vTable[Find(hashSerial)];
+    if (entry.hashSerial == 0)
+        return false;
+    entry.nHeight = nHeight;
+    return true;
+}
+
+bool CSerialIndex::Erase(const uint256& hashSerial)
+{
+    const size_t nMask = vTable.size() - 1;
+    size_t nSlot = Find(hashSerial);
+    if (vTable[nSlot].hashSerial == 0)
+        return false;
+
+    // Shift the following entries of the probe run back, so no lookup stops early at the freed slot
+    size_t nNext = nSlot;
+    while (true) {
+        nNext = (nNext + 1) & nMask;
+        if (vTable[nNext].hashSerial == 0)
+            break;
+        size_t nHome = vTable[nNext].hashSerial.Get64(0) & nMask;
+        if (((nNext - nHome) & nMask) >= ((nNext - nSlot) & nMask)) {
+            vTable[nSlot] = vTable[nNext];
+            nSlot = nNext;
+        }
+    }
+    vTable[nSlot].hashSerial = 0;
+    nEntries--;
+    return true;
+}
+
+void CSerialIndex::Clear()
+{
+    nEntries = 0;
+    vTable.clear();
+    Rehash(SERIAL_INDEX_MIN_SLOTS);
+}
+
+size_t CSerialIndex::DynamicUsage() const
+{
+    return vTable.capacity() * sizeof(CEntry) + vFilter.capacity() * sizeof(uint64_t);
+}
@@ -0,0 +1,55 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITWIN24_SERIALINDEX_H
+#define BITWIN24_SERIALINDEX_H
+
+#include "uint256.h"
+
+#include <stdint.h>
+#include <vector>
+
+/**
+ * In-memory index of spent zerocoin serials, keyed by serial hash, with the spending transaction and,
+ * once known, the height it was included at. Entries live in an open addressing table with linear
+ * probing, fronted by a bloom filter: looking up a serial that was never spent, the usual case when a
+ * new spend is checked, mostly reads a few bits of the filter and never reaches the table.
+ * Serial hashes are uniformly distributed, so their words are used as probe positions as they are.
+ */
+class CSerialIndex
+{
+private:
+    struct CEntry {
+        uint256 hashSerial;
+        uint256 txid;
+        //! -1 while the height is not known
+        int nHeight;
+    };
+
+    //! Power of two sized, a null hashSerial marks a free slot
+    std::vector<CEntry> vTable;
+    size_t nEntries;
+    //! Filter bits, erased serials are only dropped from it when it is rebuilt
+    std::vector<uint64_t> vFilter;
+
+    size_t Find(const uint256& hashSerial) const;
+    bool FilterContains(const uint256& hashSerial) const;
+    void FilterInsert(const uint256& hashSerial);
+    void Rehash(size_t nSlots);
+
+public:
+    CSerialIndex();
+
+    /** Add a serial or replace its entry */
+    void Insert(const uint256& hashSerial, const uint256& txid, int nHeight = -1);
+    bool Lookup(const uint256& hashSerial, uint256& txid, int& nHeight) const;
+    bool SetHeight(const uint256& hashSerial, int nHeight);
+    bool Erase(const uint256& hashSerial);
+    void Clear();
+
+    size_t size() const { return nEntries; }
+    size_t DynamicUsage() const;
+};
+
+#endif //BITWIN24_SERIALINDEX_H
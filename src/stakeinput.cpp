@@ -167,33 +167,43 @@ bool CZBWIStake::MarkSpent(CWallet *pwallet, const uint256& txid)
 //!BITWIN24 Stake
 bool CBitWin24Stake::SetInput(CTransaction txPrev, unsigned int n)
 {
-    this->txFrom = txPrev;
-    this->nPosition = n;
+    if (n >= txPrev.vout.size())
+        return false;
+    this->prevout = COutPoint(txPrev.GetHash(), n);
+    this->txout = txPrev.vout[n];
     return true;
 }
 
-bool CBitWin24Stake::GetTxFrom(CTransaction& tx)
+bool CBitWin24Stake::SetInput(const COutPoint& prevoutIn, const CTxOut& txoutIn, CBlockIndex* pindexFromIn)
 {
-    tx = txFrom;
+    this->prevout = prevoutIn;
+    this->txout = txoutIn;
+    this->pindexFrom = pindexFromIn;
     return true;
 }
 
+bool CBitWin24Stake::GetTxFrom(CTransaction& tx)
+{
+    uint256 hashBlock;
+    return GetTransaction(prevout.hash, tx, hashBlock, true);
+}
+
 bool CBitWin24Stake::CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut)
 {
-    txIn = CTxIn(txFrom.GetHash(), nPosition);
+    txIn = CTxIn(prevout.hash, prevout.n);
     return true;
 }
 
 CAmount CBitWin24Stake::GetValue()
 {
-    return txFrom.vout[nPosition].nValue;
+    return txout.nValue;
 }
 
 bool CBitWin24Stake::CreateTxOuts(CWallet* pwallet, vector<CTxOut>& vout, CAmount nTotal)
 {
     vector<valtype> vSolutions;
     txnouttype whichType;
-    CScript scriptPubKeyKernel = txFrom.vout[nPosition].scriptPubKey;
+    CScript scriptPubKeyKernel = txout.scriptPubKey;
     if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
         LogPrintf("CreateCoinStake : failed to parse kernel\n");
         return false;
@@ -242,16 +252,20 @@ CDataStream CBitWin24Stake::GetUniqueness()
 {
     //The unique identifier for a BITWIN24 stake is the outpoint
     CDataStream ss(SER_NETWORK, 0);
-    ss << nPosition << txFrom.GetHash();
+    ss << prevout.n << prevout.hash;
     return ss;
 }
 
 //The block that the UTXO was added to the chain
 CBlockIndex* CBitWin24Stake::GetIndexFrom()
 {
+    // Already resolved from the coins view or the stake input index
+    if (pindexFrom && chainActive.Contains(pindexFrom))
+        return pindexFrom;
+
     uint256 hashBlock = 0;
     CTransaction tx;
-    if (GetTransaction(txFrom.GetHash(), tx, hashBlock, true)) {
+    if (GetTransaction(prevout.hash, tx, hashBlock, true)) {
         // If the index is in the chain, then set it as the "index from"
         if (mapBlockIndex.count(hashBlock)) {
             CBlockIndex* pindex = mapBlockIndex.at(hashBlock);
@@ -259,8 +273,8 @@ CBlockIndex* CBitWin24Stake::GetIndexFrom()
                 pindexFrom = pindex;
         }
     } else {
-        LogPrintf("%s : failed to find tx %s\n", __func__, txFrom.GetHash().GetHex());
+        LogPrintf("%s : failed to find tx %s\n", __func__, prevout.hash.GetHex());
     }
 
     return pindexFrom;
-}
\ No newline at end of file
+}
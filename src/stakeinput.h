@@ -66,8 +66,8 @@ public:
 class CBitWin24Stake : public CStakeInput
 {
 private:
-    CTransaction txFrom;
-    unsigned int nPosition;
+    COutPoint prevout;
+    CTxOut txout;
 public:
     CBitWin24Stake()
     {
@@ -75,6 +75,7 @@ public:
     }
 
     bool SetInput(CTransaction txPrev, unsigned int n);
+    bool SetInput(const COutPoint& prevoutIn, const CTxOut& txoutIn, CBlockIndex* pindexFromIn);
 
     CBlockIndex* GetIndexFrom() override;
     bool GetTxFrom(CTransaction& tx) override;
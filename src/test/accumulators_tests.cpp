@@ -0,0 +1,179 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "accumulators.h"
+
+#include "chainparams.h"
+#include "main.h"
+#include "random.h"
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+using namespace libzerocoin;
+
+BOOST_AUTO_TEST_SUITE(accumulators_tests)
+
+// Blocks on top of the genesis block, with a new accumulator checkpoint every ten blocks and
+// nMints ZQ_ONE mints in every third block, indexed in the block pubcoin index
+static std::vector<CBlockIndex*> BuildMintChain(int nBlocks, int nMints, std::map<int, std::vector<CBigNum> >& mapPubcoins)
+{
+    // the block index lives as long as the test binary, like mapBlockIndex entries do
+    static std::list<std::pair<uint256, CBlockIndex> > listBlocks;
+    std::vector<CBlockIndex*> vBlocks;
+    CBlockIndex* pindexPrev = chainActive.Genesis();
+    for (int i = 0; i < nBlocks; i++) {
+        listBlocks.emplace_back(GetRandHash(), CBlockIndex());
+        CBlockIndex* pindex = &listBlocks.back().second;
+        pindex->phashBlock = &listBlocks.back().first;
+        pindex->pprev = pindexPrev;
+        pindex->nHeight = pindexPrev->nHeight + 1;
+        pindex->nAccumulatorCheckpoint = pindex->nHeight % 10 == 0 ? GetRandHash() : pindexPrev->nAccumulatorCheckpoint;
+        pindex->BuildSkip();
+
+        if (pindex->nHeight % 3 == 0) {
+            std::map<CoinDenomination, std::vector<std::pair<CBigNum, bool> > > mapBlock;
+            for (int j = 0; j < nMints; j++) {
+                CBigNum bnPubcoin(GetRandHash());
+                mapBlock[ZQ_ONE].push_back(std::make_pair(bnPubcoin, false));
+                mapPubcoins[pindex->nHeight].push_back(bnPubcoin);
+            }
+            pindex->vMintDenominationsInBlock.push_back(ZQ_ONE);
+            BOOST_CHECK(pzerocoinTip->WriteBlockPubcoins(pindex->nHeight, pindex->GetBlockHash(), mapBlock));
+        }
+
+        mapBlockIndex[pindex->GetBlockHash()] = pindex;
+        vBlocks.push_back(pindex);
+        pindexPrev = pindex;
+    }
+    return vBlocks;
+}
+
+BOOST_AUTO_TEST_CASE(witness_cache_advance_matches_fresh)
+{
+    LOCK(cs_main);
+    std::map<int, std::vector<CBigNum> > mapPubcoins;
+    std::vector<CBlockIndex*> vBlocks = BuildMintChain(70, 4, mapPubcoins);
+    chainActive.SetTip(vBlocks.back());
+
+    // our coin is the second mint of the block at height 6
+    const int nHeightMintAdded = 6;
+    const CBigNum bnCoin = mapPubcoins[nHeightMintAdded][1];
+    ZerocoinParams* params = Params().Zerocoin_Params(false);
+    Accumulator accumulatorStart(params, ZQ_ONE);
+
+    CAccumulatorWitnessCache cacheStart;
+    cacheStart.bnPubcoin = bnCoin;
+    cacheStart.denom = ZQ_ONE;
+    cacheStart.nHeightMintAdded = nHeightMintAdded;
+    cacheStart.nHeightAccStart = 0;
+    cacheStart.nHeightNext = 1;
+    cacheStart.hashBlockLast = chainActive.Genesis()->GetBlockHash();
+    cacheStart.bnWitness = accumulatorStart.getValue();
+
+    // the witness accumulated block by block from scratch, leaving out our own coin
+    const int nHeightStop = 60;
+    Accumulator accumulatorFresh(params, ZQ_ONE);
+    int nMintsFresh = 0;
+    int nCheckpointsFresh = 0;
+    for (int nHeight = 1; nHeight < nHeightStop; nHeight++) {
+        if (chainActive[nHeight]->nAccumulatorCheckpoint != chainActive[nHeight - 1]->nAccumulatorCheckpoint)
+            nCheckpointsFresh++;
+        for (const CBigNum& bnPubcoin : mapPubcoins[nHeight]) {
+            if (bnPubcoin == bnCoin)
+                continue;
+            accumulatorFresh.increment(bnPubcoin);
+            nMintsFresh++;
+        }
+    }
+
+    // advanced in one go
+    CAccumulatorWitnessCache cacheOnce = cacheStart;
+    BOOST_CHECK(AdvanceAccumulatorWitnessCache(cacheOnce, nHeightStop));
+    BOOST_CHECK(cacheOnce.bnWitness == accumulatorFresh.getValue());
+    BOOST_CHECK_EQUAL(cacheOnce.nMintsAdded, nMintsFresh);
+    BOOST_CHECK_EQUAL(cacheOnce.nCheckpointsAdded, nCheckpointsFresh);
+    BOOST_CHECK_EQUAL(cacheOnce.nHeightNext, nHeightStop);
+    BOOST_CHECK(cacheOnce.hashBlockLast == chainActive[nHeightStop - 1]->GetBlockHash());
+
+    // and checkpoint by checkpoint, as the wallet does while the chain grows
+    CAccumulatorWitnessCache cacheSteps = cacheStart;
+    for (int nHeight = 10; nHeight <= nHeightStop; nHeight += 10)
+        BOOST_CHECK(AdvanceAccumulatorWitnessCache(cacheSteps, nHeight));
+    BOOST_CHECK(cacheSteps.bnWitness == accumulatorFresh.getValue());
+    BOOST_CHECK_EQUAL(cacheSteps.nMintsAdded, nMintsFresh);
+    BOOST_CHECK_EQUAL(cacheSteps.nCheckpointsAdded, nCheckpointsFresh);
+    BOOST_CHECK_EQUAL(cacheSteps.nHeightNext, nHeightStop);
+
+    // a cache built along a chain that is no longer active is not advanced
+    CAccumulatorWitnessCache cacheStale = cacheSteps;
+    cacheStale.hashBlockLast = GetRandHash();
+    BOOST_CHECK(!AdvanceAccumulatorWitnessCache(cacheStale, nHeightStop + 10));
+
+    chainActive.SetTip(chainActive.Genesis());
+    for (const CBlockIndex* pindex : vBlocks) {
+        pzerocoinTip->EraseBlockPubcoins(pindex->nHeight);
+        mapBlockIndex.erase(pindex->GetBlockHash());
+    }
+}
+
+// Checkpoint with nChecksumOne for the first denomination and nChecksumRest for all others
+static uint256 MakeCheckpoint(uint32_t nChecksumOne, uint32_t nChecksumRest)
+{
+    uint256 nCheckpoint = 0;
+    for (CoinDenomination denom : zerocoinDenomList)
+        nCheckpoint = nCheckpoint << 32 | (denom == zerocoinDenomList.front() ? nChecksumOne : nChecksumRest);
+    return nCheckpoint;
+}
+
+BOOST_AUTO_TEST_CASE(accumulator_value_cache_lru)
+{
+    mapArgs["-maxaccumulatorcachesize"] = "3";
+
+    std::vector<uint32_t> vChecksums;
+    std::vector<CBigNum> vValues;
+    for (int i = 0; i < 4; i++) {
+        vValues.push_back(CBigNum(GetRandHash()));
+        vChecksums.push_back(GetChecksum(vValues.back()));
+        BOOST_CHECK(pzerocoinTip->WriteAccumulatorValue(vChecksums[i], vValues[i]));
+    }
+
+    // the first lookup goes to the database, the next one is served from memory
+    CBigNum bnValue;
+    BOOST_CHECK(!GetAccumulatorValueFromChecksum(vChecksums[0], true, bnValue));
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[0], false, bnValue));
+    BOOST_CHECK(bnValue == vValues[0]);
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[0], true, bnValue));
+    BOOST_CHECK(bnValue == vValues[0]);
+
+    // value 0 was used last, so value 1 is evicted first
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[1], false, bnValue));
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[2], false, bnValue));
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[0], true, bnValue));
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[3], false, bnValue));
+    BOOST_CHECK(!GetAccumulatorValueFromChecksum(vChecksums[1], true, bnValue));
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[0], true, bnValue));
+    BOOST_CHECK(bnValue == vValues[0]);
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[2], true, bnValue));
+    BOOST_CHECK(bnValue == vValues[2]);
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[3], true, bnValue));
+    BOOST_CHECK(bnValue == vValues[3]);
+
+    // disconnecting the block that added checksum 3 drops it from memory and the database,
+    // the checksums it shares with the previous checkpoint stay
+    BOOST_CHECK(EraseAccumulatorValues(MakeCheckpoint(vChecksums[3], vChecksums[0]), MakeCheckpoint(vChecksums[2], vChecksums[0])));
+    BOOST_CHECK(!GetAccumulatorValueFromChecksum(vChecksums[3], true, bnValue));
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[3], false, bnValue));
+    BOOST_CHECK(bnValue == 0);
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[0], true, bnValue));
+    BOOST_CHECK(bnValue == vValues[0]);
+    BOOST_CHECK(GetAccumulatorValueFromChecksum(vChecksums[2], true, bnValue));
+    BOOST_CHECK(bnValue == vValues[2]);
+
+    for (int i = 0; i < 3; i++)
+        BOOST_CHECK(EraseAccumulatorValues(MakeCheckpoint(vChecksums[i], vChecksums[i]), 0));
+    mapArgs.erase("-maxaccumulatorcachesize");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
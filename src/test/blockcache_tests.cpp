@@ -0,0 +1,115 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockcache.h"
+
+#include "primitives/block.h"
+
+#include <atomic>
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockcache_tests)
+
+static std::shared_ptr<const CBlock> MakeBlock(uint32_t nNonce)
+{
+    std::shared_ptr<CBlock> pblock = std::make_shared<CBlock>();
+    pblock->nNonce = nNonce;
+    CMutableTransaction tx;
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << std::vector<unsigned char>(1000, 1);
+    pblock->vtx.push_back(tx);
+    return pblock;
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_lru)
+{
+    std::vector<std::shared_ptr<const CBlock> > vBlocks;
+    for (uint32_t i = 0; i < 5; i++)
+        vBlocks.push_back(MakeBlock(i));
+
+    CBlockCache cache;
+    cache.Insert(vBlocks[0]);
+    const size_t nBlockUsage = cache.GetStats().nUsage;
+    BOOST_CHECK(nBlockUsage > 1000);
+
+    // room for three blocks
+    cache.SetMaxUsage(3 * nBlockUsage + nBlockUsage / 2);
+    cache.Insert(vBlocks[1]);
+    cache.Insert(vBlocks[2]);
+    BOOST_CHECK_EQUAL(cache.GetStats().nBlocks, 3U);
+
+    // block 0 was used last, so block 1 is evicted first
+    BOOST_CHECK(cache.Get(vBlocks[0]->GetHash()) == vBlocks[0]);
+    cache.Insert(vBlocks[3]);
+    BOOST_CHECK_EQUAL(cache.GetStats().nBlocks, 3U);
+    BOOST_CHECK(cache.Get(vBlocks[1]->GetHash()) == nullptr);
+    BOOST_CHECK(cache.Get(vBlocks[0]->GetHash()) == vBlocks[0]);
+    BOOST_CHECK(cache.Get(vBlocks[2]->GetHash()) == vBlocks[2]);
+    BOOST_CHECK(cache.Get(vBlocks[3]->GetHash()) == vBlocks[3]);
+    BOOST_CHECK_EQUAL(cache.GetStats().nHits, 4U);
+    BOOST_CHECK_EQUAL(cache.GetStats().nMisses, 1U);
+
+    // raw bytes share the entry and the limit
+    std::shared_ptr<const std::vector<char> > praw = std::make_shared<const std::vector<char> >(nBlockUsage, 'x');
+    cache.InsertRaw(vBlocks[3]->GetHash(), praw);
+    BOOST_CHECK(cache.GetRaw(vBlocks[3]->GetHash()) == praw);
+    BOOST_CHECK(cache.Get(vBlocks[3]->GetHash()) == vBlocks[3]);
+    BOOST_CHECK(cache.Get(vBlocks[0]->GetHash()) == nullptr);
+    BOOST_CHECK_EQUAL(cache.GetStats().nBlocks, 2U);
+
+    cache.Erase(vBlocks[3]->GetHash());
+    BOOST_CHECK(cache.GetRaw(vBlocks[3]->GetHash()) == nullptr);
+    BOOST_CHECK_EQUAL(cache.GetStats().nUsage, nBlockUsage);
+
+    // a zero size turns the cache off
+    cache.SetMaxUsage(0);
+    BOOST_CHECK_EQUAL(cache.GetStats().nBlocks, 0U);
+    cache.Insert(vBlocks[4]);
+    BOOST_CHECK(cache.Get(vBlocks[4]->GetHash()) == nullptr);
+}
+
+BOOST_AUTO_TEST_CASE(blockcache_concurrent_reads)
+{
+    std::shared_ptr<CBlock> pblockNew = std::make_shared<CBlock>(*MakeBlock(7));
+    for (int i = 0; i < 20; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout.n = i;
+        tx.vout.resize(1);
+        tx.vout[0].nValue = i;
+        pblockNew->vtx.push_back(tx);
+    }
+    const uint256 hashMerkleRoot = CBlock(*pblockNew).BuildMerkleTree();
+    const uint256 hash = pblockNew->GetHash();
+
+    CBlockCache cache;
+    cache.Insert(pblockNew);
+
+    // every reader works on its own copy, so the cached block itself is never written
+    std::atomic<int> nErrors(0);
+    boost::thread_group threads;
+    for (int i = 0; i < 4; i++) {
+        threads.create_thread([&cache, &nErrors, &hash, &hashMerkleRoot]() {
+            for (int j = 0; j < 200; j++) {
+                std::shared_ptr<const CBlock> pblock = cache.Get(hash);
+                if (!pblock) {
+                    nErrors++;
+                    continue;
+                }
+                CBlock block(*pblock);
+                if (block.GetHash() != hash || block.BuildMerkleTree() != hashMerkleRoot || block.GetMerkleBranch(3).empty())
+                    nErrors++;
+            }
+        });
+    }
+    threads.join_all();
+
+    BOOST_CHECK_EQUAL(nErrors, 0);
+    BOOST_CHECK(pblockNew->vMerkleTree.empty());
+    BOOST_CHECK_EQUAL(cache.GetStats().nHits, 800U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -3,13 +3,17 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 //
-// Unit tests for block.CheckBlock()
+// Unit tests for block.CheckBlock() and the contextual header checks
 //
 
 
 
+#include "chainparams.h"
 #include "clientversion.h"
+#include "kernel.h"
 #include "main.h"
+#include "pow.h"
+#include "timedata.h"
 #include "utiltime.h"
 
 #include <cstdio>
@@ -66,4 +70,136 @@ BOOST_AUTO_TEST_CASE(May15)
     SetMockTime(0);
 }
 
+// Find a nonce whose hash passes (or fails) the proof of work check for the header's nBits
+static void SolveHeader(CBlockHeader& header, bool fValid)
+{
+    header.nNonce = 0;
+    while (CheckProofOfWork(header.GetHash(), header.nBits) != fValid)
+        header.nNonce++;
+}
+
+static CBlockHeader MakeHeader(const CBlockIndex* pindexPrev, int64_t nTime)
+{
+    CBlockHeader header;
+    header.nVersion = CBlockHeader::CURRENT_VERSION;
+    header.hashPrevBlock = pindexPrev->GetBlockHash();
+    header.nTime = nTime;
+    header.nBits = GetNextWorkRequired(pindexPrev, &header);
+    return header;
+}
+
+BOOST_AUTO_TEST_CASE(contextual_header_checks)
+{
+    // a bare index chain through the last PoW block, not linked into mapBlockIndex
+    const int nLastPoW = Params().LAST_POW_BLOCK();
+    const int64_t nTimeStart = 1500000000;
+    std::vector<uint256> vHashes(nLastPoW + 1);
+    std::vector<CBlockIndex> vIndex(nLastPoW + 1);
+    for (int i = 0; i <= nLastPoW; i++) {
+        vHashes[i] = i + 1;
+        vIndex[i].phashBlock = &vHashes[i];
+        vIndex[i].pprev = i ? &vIndex[i - 1] : NULL;
+        vIndex[i].nHeight = i;
+        vIndex[i].nTime = nTimeStart + i * 60;
+    }
+    CBlockIndex* pindexPoW = &vIndex[nLastPoW - 1];
+    CBlockIndex* pindexLastPoW = &vIndex[nLastPoW];
+    SetMockTime(pindexLastPoW->GetBlockTime() + 60);
+    CValidationState state;
+
+    // proof of work is only checked when asked for
+    CBlockHeader header = MakeHeader(pindexPoW, GetAdjustedTime());
+    SolveHeader(header, false);
+    BOOST_CHECK(!ContextualCheckBlockHeader(header, state, pindexPoW));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "high-hash");
+    state = CValidationState();
+    BOOST_CHECK(ContextualCheckBlockHeader(header, state, pindexPoW, false));
+    SolveHeader(header, true);
+    BOOST_CHECK(ContextualCheckBlockHeader(header, state, pindexPoW));
+
+    // the difficulty must be the retarget result
+    header.nBits--;
+    BOOST_CHECK(!ContextualCheckBlockHeader(header, state, pindexPoW, false));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-diffbits");
+
+    // PoW headers may run two hours ahead of the adjusted time
+    header = MakeHeader(pindexPoW, GetAdjustedTime() + 7200);
+    SolveHeader(header, true);
+    state = CValidationState();
+    BOOST_CHECK(ContextualCheckBlockHeader(header, state, pindexPoW));
+    header = MakeHeader(pindexPoW, GetAdjustedTime() + 7201);
+    SolveHeader(header, true);
+    BOOST_CHECK(!ContextualCheckBlockHeader(header, state, pindexPoW));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "time-too-new");
+
+    // a PoS header needs a stake modifier to build on, but no proof of work
+    header = MakeHeader(pindexLastPoW, GetAdjustedTime());
+    SolveHeader(header, false);
+    state = CValidationState();
+    BOOST_CHECK(!ContextualCheckBlockHeader(header, state, pindexLastPoW));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "bad-stakemodifier");
+    pindexLastPoW->SetStakeModifier(0x0123456789abcdefULL, true);
+    state = CValidationState();
+    BOOST_CHECK(ContextualCheckBlockHeader(header, state, pindexLastPoW));
+
+    // and may only run three minutes ahead
+    header = MakeHeader(pindexLastPoW, GetAdjustedTime() + 180);
+    BOOST_CHECK(ContextualCheckBlockHeader(header, state, pindexLastPoW));
+    header = MakeHeader(pindexLastPoW, GetAdjustedTime() + 181);
+    BOOST_CHECK(!ContextualCheckBlockHeader(header, state, pindexLastPoW));
+    BOOST_CHECK_EQUAL(state.GetRejectReason(), "time-too-new");
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_CASE(header_before_block_proof_of_stake)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindexGenesis = chainActive.Genesis();
+    CBlockIndex* pindexBestHeaderOld = pindexBestHeader;
+    CBlockIndex* pindexGenesisNext = pindexGenesis->pnext;
+
+    // index headers alone up to and past the first PoS height
+    std::vector<CBlockIndex*> vIndex;
+    CBlockIndex* pindexPrev = pindexGenesis;
+    for (int i = 0; i <= Params().LAST_POW_BLOCK() + 1; i++) {
+        CBlock block;
+        block.nVersion = CBlockHeader::CURRENT_VERSION;
+        block.hashPrevBlock = pindexPrev->GetBlockHash();
+        block.nTime = pindexPrev->nTime + 60;
+        pindexPrev = AddToBlockIndex(block);
+        vIndex.push_back(pindexPrev);
+    }
+    CBlockIndex* pindexStake = vIndex[vIndex.size() - 2];
+    CBlockIndex* pindexNext = vIndex.back();
+    BOOST_CHECK(pindexStake->IsProofOfStake());
+    BOOST_CHECK(pindexNext->IsProofOfStake());
+
+    // indexing a header must not invent a kernel hash for it
+    BOOST_CHECK(!mapProofOfStake.count(pindexStake->GetBlockHash()));
+    BOOST_CHECK(pindexStake->hashProofOfStake == 0);
+
+    // the child's body arrives first, then the parent's
+    const uint256 hashStakeNext = 2;
+    mapProofOfStake[pindexNext->GetBlockHash()] = hashStakeNext;
+    SetBlockIndexProofOfStake(pindexNext, hashStakeNext);
+    BOOST_CHECK(pindexNext->hashProofOfStake == hashStakeNext);
+    BOOST_CHECK_EQUAL(pindexNext->nStakeModifierChecksum, GetStakeModifierChecksum(pindexNext));
+
+    const uint256 hashStake = 1;
+    unsigned int nChecksumNextOld = pindexNext->nStakeModifierChecksum;
+    mapProofOfStake[pindexStake->GetBlockHash()] = hashStake;
+    SetBlockIndexProofOfStake(pindexStake, hashStake);
+    BOOST_CHECK(pindexStake->hashProofOfStake == hashStake);
+    BOOST_CHECK_EQUAL(pindexStake->nStakeModifierChecksum, GetStakeModifierChecksum(pindexStake));
+    BOOST_CHECK_EQUAL(pindexNext->nStakeModifierChecksum, GetStakeModifierChecksum(pindexNext));
+    BOOST_CHECK(pindexNext->nStakeModifierChecksum != nChecksumNextOld);
+
+    // the headers stay indexed as a side branch without data, as after a headers-first stall
+    for (CBlockIndex* pindex : vIndex)
+        mapProofOfStake.erase(pindex->GetBlockHash());
+    pindexGenesis->pnext = pindexGenesisNext;
+    pindexBestHeader = pindexBestHeaderOld;
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -58,6 +58,24 @@ public:
 
     bool GetStats(CCoinsStats& stats) const { return false; }
 };
+
+class CCoinsViewCacheTest : public CCoinsViewCache
+{
+public:
+    CCoinsViewCacheTest(CCoinsView* base) : CCoinsViewCache(base) {}
+
+    void SelfTest() const
+    {
+        // Manually recompute the dynamic usage of the whole data, and compare it.
+        size_t ret = memusage::DynamicUsage(cacheCoins);
+        if (pool)
+            ret = memusage::BucketUsage(cacheCoins) + pool->DynamicUsage();
+        for (CCoinsMap::iterator it = cacheCoins.begin(); it != cacheCoins.end(); it++) {
+            ret += it->second.coins.DynamicMemoryUsage();
+        }
+        BOOST_CHECK_EQUAL(DynamicMemoryUsage(), ret);
+    }
+};
 }
 
 BOOST_AUTO_TEST_SUITE(coins_tests)
@@ -89,8 +107,8 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
 
     // The cache stack.
     CCoinsViewTest base; // A CCoinsViewTest at the bottom.
-    std::vector<CCoinsViewCache*> stack; // A stack of CCoinsViewCaches on top.
-    stack.push_back(new CCoinsViewCache(&base)); // Start with one cache.
+    std::vector<CCoinsViewCacheTest*> stack; // A stack of CCoinsViewCaches on top.
+    stack.push_back(new CCoinsViewCacheTest(&base)); // Start with one cache.
 
     // Use a limited set of random transaction ids, so we do test overwriting entries.
     std::vector<uint256> txids;
@@ -135,6 +153,8 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
                     missed_an_entry = true;
                 }
             }
+            for (const CCoinsViewCacheTest* test : stack)
+                test->SelfTest();
         }
 
         if (insecure_rand() % 100 == 0) {
@@ -151,7 +171,7 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
                 } else {
                     removed_all_caches = true;
                 }
-                stack.push_back(new CCoinsViewCache(tip));
+                stack.push_back(new CCoinsViewCacheTest(tip));
                 if (stack.size() == 4) {
                     reached_4_caches = true;
                 }
@@ -175,4 +195,28 @@ BOOST_AUTO_TEST_CASE(coins_cache_simulation_test)
     BOOST_CHECK(missed_an_entry);
 }
 
+BOOST_AUTO_TEST_CASE(coins_cache_pool)
+{
+    std::shared_ptr<CPoolResource> pool = std::make_shared<CPoolResource>();
+    CCoinsMap map(0, CCoinsKeyHasher(), std::equal_to<uint256>(), CCoinsMap::allocator_type(pool));
+    for (int i = 0; i < 10000; i++)
+        map[GetRandHash()].flags = CCoinsCacheEntry::DIRTY;
+    BOOST_CHECK_EQUAL(pool->GetUsedBlocks(), map.size());
+    const size_t nUsage = pool->DynamicUsage();
+    BOOST_CHECK(nUsage > 0);
+
+    // freed entries are reused before the pool grows
+    map.erase(map.begin());
+    map[GetRandHash()];
+    BOOST_CHECK_EQUAL(pool->DynamicUsage(), nUsage);
+
+    // the chunks only go back once every entry is gone
+    pool->Release();
+    BOOST_CHECK_EQUAL(pool->DynamicUsage(), nUsage);
+    map.clear();
+    BOOST_CHECK_EQUAL(pool->GetUsedBlocks(), 0U);
+    pool->Release();
+    BOOST_CHECK_EQUAL(pool->DynamicUsage(), 0U);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,56 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txdb.h"
+
+#include "random.h"
+#include "script/script.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(coinsdb_tests)
+
+BOOST_AUTO_TEST_CASE(coins_async_flush)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CCoinsViewAsyncDB async(&db, db);
+    CCoinsViewCache tip(&async);
+
+    std::vector<uint256> vTxid;
+    for (int i = 0; i < 100; i++) {
+        vTxid.push_back(GetRandHash());
+        CCoinsModifier coins = tip.ModifyCoins(vTxid.back());
+        coins->nVersion = 1;
+        coins->vout.resize(1);
+        coins->vout[0].nValue = i + 1;
+        coins->vout[0].scriptPubKey = CScript() << OP_TRUE;
+    }
+    const uint256 hashBlock = GetRandHash();
+    tip.SetBestBlock(hashBlock);
+    BOOST_CHECK(tip.Flush());
+    BOOST_CHECK_EQUAL(tip.GetCacheSize(), 0U);
+
+    // the flushed coins are visible right away, written or not
+    BOOST_CHECK(tip.GetBestBlock() == hashBlock);
+    for (int i = 0; i < 100; i++) {
+        const CCoins* coins = tip.AccessCoins(vTxid[i]);
+        BOOST_CHECK(coins && coins->vout[0].nValue == i + 1);
+    }
+
+    // spends of coins still being written read as spent
+    for (int i = 0; i < 100; i += 2)
+        tip.ModifyCoins(vTxid[i])->Clear();
+    const uint256 hashBlock2 = GetRandHash();
+    tip.SetBestBlock(hashBlock2);
+    BOOST_CHECK(tip.Flush());
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK_EQUAL(tip.HaveCoins(vTxid[i]), i % 2 == 1);
+
+    BOOST_CHECK(async.Wait());
+    BOOST_CHECK(db.GetBestBlock() == hashBlock2);
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK_EQUAL(db.HaveCoins(vTxid[i]), i % 2 == 1);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,338 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "kernel.h"
+#include "main.h"
+#include "random.h"
+#include "stakeinput.h"
+#include "txdb.h"
+#include "uint256.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+BOOST_AUTO_TEST_SUITE(kernel_tests)
+
+class CTestStakeInput : public CStakeInput
+{
+private:
+    uint32_t nId;
+
+public:
+    CTestStakeInput(CBlockIndex* pindex, uint32_t nIdIn) : nId(nIdIn) { pindexFrom = pindex; }
+
+    CBlockIndex* GetIndexFrom() override { return pindexFrom; }
+    bool CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut = 0) override { return false; }
+    bool GetTxFrom(CTransaction& tx) override { return false; }
+    CAmount GetValue() override { return 100 << 24; }
+    bool CreateTxOuts(CWallet* pwallet, vector<CTxOut>& vout, CAmount nTotal) override { return false; }
+    bool GetModifier(uint64_t& nStakeModifier) override
+    {
+        nStakeModifier = 0x0123456789abcdefULL;
+        return true;
+    }
+    bool IsZBWI() override { return false; }
+    CDataStream GetUniqueness() override
+    {
+        CDataStream ss(SER_GETHASH, 0);
+        ss << nId;
+        return ss;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(stake_kernel_table_matches_checkstake)
+{
+    const unsigned int nBits = 0x1d00ffff;
+    uint256 bnTargetPerCoinDay;
+    bnTargetPerCoinDay.SetCompact(nBits);
+
+    CBlockIndex indexFrom;
+    indexFrom.nHeight = 1;
+    indexFrom.nTime = 1500000000;
+    unsigned int nTimeNow = indexFrom.nTime + nStakeMinAge + 1000;
+
+    std::list<std::unique_ptr<CStakeInput> > listInputs;
+    std::vector<CStakeInput*> vInputs;
+    for (uint32_t i = 0; i < 64; i++) {
+        listInputs.emplace_back(new CTestStakeInput(&indexFrom, i));
+        vInputs.push_back(listInputs.back().get());
+    }
+
+    // the first hit of every input in its window, latest timestamp first
+    std::vector<std::pair<CStakeInput*, unsigned int> > vExpected;
+    for (CStakeInput* pinput : vInputs) {
+        for (unsigned int nTime = nTimeNow + STAKE_HASH_DRIFT; nTime > nTimeNow; nTime--) {
+            unsigned int nTimeTx = nTime;
+            uint256 hash;
+            if (CheckStake(pinput->GetUniqueness(), pinput->GetValue(), 0x0123456789abcdefULL, bnTargetPerCoinDay, indexFrom.nTime, nTimeTx, hash)) {
+                vExpected.push_back(std::make_pair(pinput, nTime));
+                break;
+            }
+        }
+    }
+    BOOST_CHECK(!vExpected.empty());
+
+    CStakeKernelTable table;
+    table.Build(listInputs, chainActive.Tip(), nBits, nTimeNow);
+    BOOST_CHECK_EQUAL(table.size(), vInputs.size());
+    BOOST_CHECK(!table.IsStale(chainActive.Tip(), nBits, nTimeNow));
+    BOOST_CHECK(table.IsStale(chainActive.Tip(), nBits + 1, nTimeNow));
+
+    // each sweep resumes after the previous hit
+    for (const std::pair<CStakeInput*, unsigned int>& expected : vExpected) {
+        unsigned int nTimeTx = nTimeNow;
+        uint256 hashProofOfStake;
+        BOOST_CHECK(table.Sweep(nTimeTx, hashProofOfStake) == expected.first);
+        BOOST_CHECK_EQUAL(nTimeTx, expected.second);
+
+        uint256 hashCheck;
+        BOOST_CHECK(CheckStake(expected.first->GetUniqueness(), expected.first->GetValue(), 0x0123456789abcdefULL, bnTargetPerCoinDay, indexFrom.nTime, nTimeTx, hashCheck));
+        BOOST_CHECK(hashCheck == hashProofOfStake);
+    }
+    unsigned int nTimeTx = nTimeNow;
+    uint256 hashProofOfStake;
+    BOOST_CHECK(table.Sweep(nTimeTx, hashProofOfStake) == nullptr);
+
+    // a second later only the one new timestamp is hashed
+    unsigned int nTimeNew = nTimeNow + STAKE_HASH_DRIFT + 1;
+    for (CStakeInput* pinput : vInputs) {
+        unsigned int nTimeCheck = nTimeNew;
+        uint256 hash;
+        if (!CheckStake(pinput->GetUniqueness(), pinput->GetValue(), 0x0123456789abcdefULL, bnTargetPerCoinDay, indexFrom.nTime, nTimeCheck, hash))
+            continue;
+        nTimeTx = nTimeNow + 1;
+        BOOST_CHECK(table.Sweep(nTimeTx, hashProofOfStake) == pinput);
+        BOOST_CHECK_EQUAL(nTimeTx, nTimeNew);
+    }
+    nTimeTx = nTimeNow + 1;
+    BOOST_CHECK(table.Sweep(nTimeTx, hashProofOfStake) == nullptr);
+}
+
+static std::vector<std::pair<uint32_t, unsigned int> > SweepAll(CBlockIndex* pindexFrom, uint32_t nInputs, unsigned int nTimeNow)
+{
+    std::list<std::unique_ptr<CStakeInput> > listInputs;
+    std::map<CStakeInput*, uint32_t> mapIds;
+    for (uint32_t i = 0; i < nInputs; i++) {
+        listInputs.emplace_back(new CTestStakeInput(pindexFrom, i));
+        mapIds[listInputs.back().get()] = i;
+    }
+
+    CStakeKernelTable table;
+    table.Build(listInputs, chainActive.Tip(), 0x1d00ffff, nTimeNow);
+
+    std::vector<std::pair<uint32_t, unsigned int> > vFound;
+    while (true) {
+        unsigned int nTimeTx = nTimeNow;
+        uint256 hashProofOfStake;
+        CStakeInput* pinput = table.Sweep(nTimeTx, hashProofOfStake);
+        if (!pinput)
+            break;
+        vFound.push_back(std::make_pair(mapIds[pinput], nTimeTx));
+    }
+    return vFound;
+}
+
+BOOST_AUTO_TEST_CASE(stake_kernel_table_sharded_sweep)
+{
+    CBlockIndex indexFrom;
+    indexFrom.nHeight = 1;
+    indexFrom.nTime = 1500000000;
+    unsigned int nTimeNow = indexFrom.nTime + nStakeMinAge + 1000;
+
+    std::vector<std::pair<uint32_t, unsigned int> > vSequential = SweepAll(&indexFrom, 1000, nTimeNow);
+
+    // shards run on the worker threads and the caller as the queue's master
+    boost::thread_group threadGroup;
+    nStakeThreads = 4;
+    for (int i = 0; i < nStakeThreads - 1; i++)
+        threadGroup.create_thread(&ThreadStakeKernelCheck);
+    std::vector<std::pair<uint32_t, unsigned int> > vSharded = SweepAll(&indexFrom, 1000, nTimeNow);
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    nStakeThreads = DEFAULT_STAKE_THREADS;
+
+    // shards finish in any order, but every kernel is found exactly once
+    BOOST_CHECK(!vSequential.empty());
+    std::sort(vSequential.begin(), vSequential.end());
+    std::sort(vSharded.begin(), vSharded.end());
+    BOOST_CHECK(vSequential == vSharded);
+}
+
+BOOST_AUTO_TEST_CASE(stake_kernel_table_stale_tip)
+{
+    CBlockIndex indexFrom;
+    indexFrom.nHeight = 1;
+    indexFrom.nTime = 1500000000;
+    unsigned int nTimeNow = indexFrom.nTime + nStakeMinAge + 1000;
+
+    std::list<std::unique_ptr<CStakeInput> > listInputs;
+    for (uint32_t i = 0; i < 1000; i++)
+        listInputs.emplace_back(new CTestStakeInput(&indexFrom, i));
+
+    // a table built on a tip that is no longer active is not swept
+    uint256 hashOtherTip = GetRandHash();
+    CBlockIndex indexOtherTip;
+    indexOtherTip.phashBlock = &hashOtherTip;
+    CStakeKernelTable table;
+    table.Build(listInputs, &indexOtherTip, 0x1d00ffff, nTimeNow);
+    BOOST_CHECK_EQUAL(table.size(), 1000U);
+
+    unsigned int nTimeTx = nTimeNow;
+    uint256 hashProofOfStake;
+    BOOST_CHECK(table.Sweep(nTimeTx, hashProofOfStake) == nullptr);
+    BOOST_CHECK_EQUAL(nTimeTx, nTimeNow);
+}
+
+// GetKernelStakeModifier as it was before the modifier cache, walking the active chain forward
+static bool GetKernelStakeModifierUncached(const CBlockIndex* pindexFrom, uint64_t& nStakeModifier, int& nStakeModifierHeight)
+{
+    nStakeModifierHeight = pindexFrom->nHeight;
+    int64_t nStakeModifierTime = pindexFrom->GetBlockTime();
+    const CBlockIndex* pindex = pindexFrom;
+    CBlockIndex* pindexNext = chainActive[pindexFrom->nHeight + 1];
+    while (nStakeModifierTime < pindexFrom->GetBlockTime() + GetStakeModifierSelectionInterval()) {
+        if (!pindexNext)
+            return false;
+        pindex = pindexNext;
+        pindexNext = chainActive[pindexNext->nHeight + 1];
+        if (pindex->GeneratedStakeModifier()) {
+            nStakeModifierHeight = pindex->nHeight;
+            nStakeModifierTime = pindex->GetBlockTime();
+        }
+    }
+    nStakeModifier = pindex->nStakeModifier;
+    return true;
+}
+
+// Blocks on top of pindexPrev, every nGenerateEvery-th generating a modifier. Block times mostly rise
+// by nSpacing, but every seventh block is dated back to exercise the out of order timestamp path.
+static std::vector<CBlockIndex*> BuildModifierChain(CBlockIndex* pindexPrev, int nBlocks, int64_t nSpacing, int nGenerateEvery)
+{
+    // the cache keeps pointers to these, so they live as long as the test binary
+    static std::list<std::pair<uint256, CBlockIndex> > listBlocks;
+    std::vector<CBlockIndex*> vBlocks;
+    for (int i = 0; i < nBlocks; i++) {
+        listBlocks.emplace_back(GetRandHash(), CBlockIndex());
+        CBlockIndex* pindex = &listBlocks.back().second;
+        pindex->phashBlock = &listBlocks.back().first;
+        pindex->pprev = pindexPrev;
+        pindex->nHeight = pindexPrev->nHeight + 1;
+        pindex->nTime = pindexPrev->nTime + (pindex->nHeight % 7 == 0 ? -3 * nSpacing : nSpacing);
+        pindex->SetStakeModifier(GetRand(std::numeric_limits<uint64_t>::max()), pindex->nHeight % nGenerateEvery == 0);
+        pindex->BuildSkip();
+        mapBlockIndex[pindex->GetBlockHash()] = pindex;
+        vBlocks.push_back(pindex);
+        pindexPrev = pindex;
+    }
+    return vBlocks;
+}
+
+static void CheckModifiersMatch(const std::vector<CBlockIndex*>& vBlocks)
+{
+    for (const CBlockIndex* pindexFrom : vBlocks) {
+        uint64_t nExpected;
+        int nHeightExpected;
+        bool fExpected = GetKernelStakeModifierUncached(pindexFrom, nExpected, nHeightExpected);
+
+        // the second lookup is answered from the cache
+        for (int i = 0; i < 2; i++) {
+            uint64_t nStakeModifier;
+            int nStakeModifierHeight;
+            int64_t nStakeModifierTime;
+            bool fFound = GetKernelStakeModifier(pindexFrom->GetBlockHash(), nStakeModifier, nStakeModifierHeight, nStakeModifierTime, false);
+            BOOST_CHECK_EQUAL(fFound, fExpected);
+            if (fFound && fExpected) {
+                BOOST_CHECK_EQUAL(nStakeModifier, nExpected);
+                BOOST_CHECK_EQUAL(nStakeModifierHeight, nHeightExpected);
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(stake_modifier_cache_matches_chain_walk)
+{
+    LOCK(cs_main);
+    CBlockIndex* pindexGenesis = chainActive.Genesis();
+
+    std::vector<CBlockIndex*> vChain = BuildModifierChain(pindexGenesis, 300, 60, 3);
+    chainActive.SetTip(vChain.back());
+    CheckModifiersMatch(vChain);
+
+    // reorg to a branch off height 150 with other block times and generating blocks
+    std::vector<CBlockIndex*> vFork = BuildModifierChain(vChain[149], 200, 45, 4);
+    chainActive.SetTip(vFork.back());
+    CheckModifiersMatch(vChain);
+    CheckModifiersMatch(vFork);
+
+    // and back, with results cached for both branches
+    chainActive.SetTip(vChain.back());
+    CheckModifiersMatch(vChain);
+    CheckModifiersMatch(vFork);
+
+    chainActive.SetTip(pindexGenesis);
+    for (const CBlockIndex* pindex : vChain)
+        mapBlockIndex.erase(pindex->GetBlockHash());
+    for (const CBlockIndex* pindex : vFork)
+        mapBlockIndex.erase(pindex->GetBlockHash());
+}
+
+BOOST_AUTO_TEST_CASE(kernel_input_lookup_order)
+{
+    CMutableTransaction txPrev;
+    txPrev.vin.resize(1);
+    txPrev.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txPrev.vout.resize(1);
+    txPrev.vout[0].nValue = 1 * COIN;
+    txPrev.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    const CTransaction tx(txPrev);
+    const COutPoint prevout(tx.GetHash(), 0);
+    CBlockIndex* pindexGenesis = chainActive.Genesis();
+
+    CTxOut txout;
+    CBlockIndex* pindexFrom = nullptr;
+    BOOST_CHECK(!GetKernelInput(prevout, txout, pindexFrom));
+
+    // only GetTransaction knows it: the mempool has no block to report
+    mempool.addUnchecked(tx.GetHash(), CTxMemPoolEntry(tx, 0, 0, 0.0, 1));
+    BOOST_CHECK(GetKernelInput(prevout, txout, pindexFrom));
+    BOOST_CHECK(txout == tx.vout[0]);
+    BOOST_CHECK(pindexFrom == nullptr);
+
+    // the stake input index is consulted before GetTransaction
+    CTxOut txoutIndex(2 * COIN, tx.vout[0].scriptPubKey);
+    BOOST_CHECK(pblocktree->WriteStakeInput(prevout, pindexGenesis->GetBlockHash(), txoutIndex));
+    BOOST_CHECK(GetKernelInput(prevout, txout, pindexFrom));
+    BOOST_CHECK(txout == txoutIndex);
+    BOOST_CHECK(pindexFrom == pindexGenesis);
+
+    // entries for blocks off the active chain are ignored
+    BOOST_CHECK(pblocktree->WriteStakeInput(prevout, GetRandHash(), txoutIndex));
+    BOOST_CHECK(GetKernelInput(prevout, txout, pindexFrom));
+    BOOST_CHECK(txout == tx.vout[0]);
+    BOOST_CHECK(pblocktree->WriteStakeInput(prevout, pindexGenesis->GetBlockHash(), txoutIndex));
+
+    // and the coins view before both
+    {
+        CTxOut txoutCoins(3 * COIN, tx.vout[0].scriptPubKey);
+        CCoinsModifier coins = pcoinsTip->ModifyCoins(prevout.hash);
+        coins->vout.assign(1, txoutCoins);
+        coins->nHeight = 0;
+    }
+    BOOST_CHECK(GetKernelInput(prevout, txout, pindexFrom));
+    BOOST_CHECK_EQUAL(txout.nValue, 3 * COIN);
+    BOOST_CHECK(pindexFrom == pindexGenesis);
+
+    // spent again: back to the index, and to GetTransaction once the entry is erased
+    pcoinsTip->ModifyCoins(prevout.hash)->Clear();
+    BOOST_CHECK(GetKernelInput(prevout, txout, pindexFrom));
+    BOOST_CHECK(txout == txoutIndex);
+    BOOST_CHECK(pblocktree->EraseStakeInput(prevout));
+    BOOST_CHECK(GetKernelInput(prevout, txout, pindexFrom));
+    BOOST_CHECK(txout == tx.vout[0]);
+
+    std::list<CTransaction> removed;
+    mempool.remove(tx, removed);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -5,6 +5,7 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "primitives/transaction.h"
+#include "clientversion.h"
 #include "main.h"
 
 #include <boost/test/unit_test.hpp>
@@ -48,4 +49,29 @@ BOOST_AUTO_TEST_CASE(subsidy_limit_test)
     BOOST_CHECK(nSum == 4109975100000000ULL);
 }
 
+BOOST_AUTO_TEST_CASE(zerocoin_supply_serialization)
+{
+    // the block index used to store the supply in a map, existing entries must read back the same
+    std::map<libzerocoin::CoinDenomination, int64_t> mapSupply;
+    CZerocoinSupply supply;
+    int64_t nValue = 1;
+    for (libzerocoin::CoinDenomination denom : libzerocoin::zerocoinDenomList) {
+        mapSupply[denom] = nValue;
+        supply.at(denom) = nValue;
+        nValue *= 3;
+    }
+    CDataStream ssMap(SER_DISK, CLIENT_VERSION);
+    ssMap << mapSupply;
+    CDataStream ssSupply(SER_DISK, CLIENT_VERSION);
+    ssSupply << supply;
+    BOOST_CHECK(ssMap.str() == ssSupply.str());
+    BOOST_CHECK_EQUAL(GetSerializeSize(supply, SER_DISK, CLIENT_VERSION), ssSupply.size());
+
+    CZerocoinSupply supplyRead;
+    ssMap >> supplyRead;
+    for (libzerocoin::CoinDenomination denom : libzerocoin::zerocoinDenomList)
+        BOOST_CHECK_EQUAL(supplyRead.at(denom), mapSupply.at(denom));
+    BOOST_CHECK_THROW(supplyRead.at(libzerocoin::ZQ_ERROR), std::out_of_range);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
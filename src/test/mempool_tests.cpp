@@ -99,4 +99,117 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSizeLimitTest)
+{
+    CTxMemPool pool(CFeeRate(0));
+    std::list<CTransaction> removed;
+
+    CMutableTransaction tx[3];
+    for (int i = 0; i < 3; i++) {
+        tx[i].vin.resize(1);
+        tx[i].vin[0].scriptSig = CScript() << OP_11;
+        tx[i].vin[0].prevout.n = i;
+        tx[i].vout.resize(1);
+        tx[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx[i].vout[0].nValue = 10 * COIN;
+    }
+    CMutableTransaction txChild;
+    txChild.vin.resize(1);
+    txChild.vin[0].scriptSig = CScript() << OP_11;
+    txChild.vin[0].prevout = COutPoint(tx[1].GetHash(), 0);
+    txChild.vout.resize(1);
+    txChild.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txChild.vout[0].nValue = 9 * COIN;
+
+    pool.addUnchecked(tx[0].GetHash(), CTxMemPoolEntry(tx[0], 10000LL, 0, 0.0, 1));
+    pool.addUnchecked(tx[1].GetHash(), CTxMemPoolEntry(tx[1], 1000LL, 0, 0.0, 1));
+    pool.addUnchecked(tx[2].GetHash(), CTxMemPoolEntry(tx[2], 5000LL, 0, 0.0, 1));
+    pool.addUnchecked(txChild.GetHash(), CTxMemPoolEntry(txChild, 100000LL, 0, 0.0, 1));
+    const size_t nUsage = pool.DynamicMemoryUsage();
+    BOOST_CHECK(nUsage > 4 * sizeof(CTxMemPoolEntry));
+
+    // under the limit nothing happens
+    pool.TrimToSize(nUsage, removed);
+    BOOST_CHECK_EQUAL(removed.size(), 0);
+
+    // the cheapest transaction goes first, taking its child with it
+    pool.TrimToSize(nUsage - 1, removed);
+    BOOST_CHECK_EQUAL(removed.size(), 2);
+    BOOST_CHECK(!pool.exists(tx[1].GetHash()));
+    BOOST_CHECK(!pool.exists(txChild.GetHash()));
+    BOOST_CHECK(pool.exists(tx[0].GetHash()));
+    BOOST_CHECK(pool.exists(tx[2].GetHash()));
+    BOOST_CHECK(pool.DynamicMemoryUsage() < nUsage);
+
+    // zerocoin spends are never evicted, a pool holding only those is left as it is
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].scriptSig = CScript() << OP_ZEROCOINSPEND;
+    txSpend.vout.resize(1);
+    txSpend.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    txSpend.vout[0].nValue = 1 * COIN;
+    BOOST_CHECK(CTransaction(txSpend).IsZerocoinSpend());
+    pool.addUnchecked(txSpend.GetHash(), CTxMemPoolEntry(txSpend, 0LL, 0, 0.0, 1));
+    removed.clear();
+    pool.TrimToSize(0, removed);
+    BOOST_CHECK_EQUAL(removed.size(), 2);
+    BOOST_CHECK_EQUAL(pool.size(), 1);
+    BOOST_CHECK(pool.exists(txSpend.GetHash()));
+    pool.TrimToSize(0, removed);
+    BOOST_CHECK_EQUAL(removed.size(), 2);
+
+    pool.remove(txSpend, removed);
+    BOOST_CHECK_EQUAL(pool.size(), 0);
+    BOOST_CHECK_EQUAL(pool.DynamicMemoryUsage(), 0);
+}
+
+BOOST_AUTO_TEST_CASE(MempoolRollingMinFeeTest)
+{
+    CTxMemPool pool(CFeeRate(1000));
+    std::list<CTransaction> removed;
+    SetMockTime(42);
+
+    CMutableTransaction tx[3];
+    for (int i = 0; i < 3; i++) {
+        tx[i].vin.resize(1);
+        tx[i].vin[0].scriptSig = CScript() << OP_11;
+        tx[i].vin[0].prevout.n = i;
+        tx[i].vout.resize(1);
+        tx[i].vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+        tx[i].vout[0].nValue = 10 * COIN;
+    }
+    pool.addUnchecked(tx[0].GetHash(), CTxMemPoolEntry(tx[0], 10000LL, 0, 0.0, 1));
+    pool.addUnchecked(tx[1].GetHash(), CTxMemPoolEntry(tx[1], 5000LL, 0, 0.0, 1));
+    pool.addUnchecked(tx[2].GetHash(), CTxMemPoolEntry(tx[2], 20000LL, 0, 0.0, 1));
+    const size_t nUsage = pool.DynamicMemoryUsage();
+
+    // nothing evicted yet, so nothing beyond the relay fee is required
+    BOOST_CHECK(pool.GetMinFee(nUsage) == CFeeRate(0));
+
+    // evicting the cheapest raises the minimum to its fee rate plus the relay fee
+    pool.TrimToSize(nUsage - 1, removed);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    BOOST_CHECK(!pool.exists(tx[1].GetHash()));
+    CFeeRate feeEvicted(5000LL, ::GetSerializeSize(tx[1], SER_NETWORK, PROTOCOL_VERSION));
+    CFeeRate feeMin(feeEvicted.GetFeePerK() + 1000);
+    BOOST_CHECK(pool.GetMinFee(nUsage) == feeMin);
+
+    // it only decays once a block came in since
+    SetMockTime(42 + CTxMemPool::ROLLING_FEE_HALFLIFE);
+    BOOST_CHECK(pool.GetMinFee(nUsage) == feeMin);
+
+    std::vector<CTransaction> vtx;
+    std::list<CTransaction> conflicts;
+    pool.removeForBlock(vtx, 2, conflicts);
+    SetMockTime(42 + 2 * CTxMemPool::ROLLING_FEE_HALFLIFE);
+    // the pool is above half its limit, so this is one half-life
+    BOOST_CHECK(pool.GetMinFee(nUsage) == CFeeRate(llround(feeMin.GetFeePerK() / 2.0)));
+
+    // and drops to zero once it is below half the relay fee
+    SetMockTime(42 + 20 * CTxMemPool::ROLLING_FEE_HALFLIFE);
+    BOOST_CHECK(pool.GetMinFee(nUsage) == CFeeRate(0));
+
+    SetMockTime(0);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
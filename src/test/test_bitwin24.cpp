@@ -47,6 +47,9 @@ struct TestingSetup {
         pblocktree = new CBlockTreeDB(1 << 20, true);
         pcoinsdbview = new CCoinsViewDB(1 << 23, true);
         pcoinsTip = new CCoinsViewCache(pcoinsdbview);
+        zerocoinDB = new CZerocoinDB(1 << 20, true);
+        pzerocoinTip = new CZerocoinViewCache(zerocoinDB);
+        pzerocoinTip->LoadSerials();
         InitBlockIndex();
 #ifdef ENABLE_WALLET
         bool fFirstRun;
@@ -70,6 +73,8 @@ struct TestingSetup {
 #endif
         delete pcoinsTip;
         delete pcoinsdbview;
+        delete pzerocoinTip;
+        delete zerocoinDB;
         delete pblocktree;
 #ifdef ENABLE_WALLET
         bitdb.Flush(true);
@@ -10,8 +10,10 @@
 #include "primitives/deterministicmint.h"
 #include "key.h"
 #include "accumulatorcheckpoints.h"
+#include "accumulatormap.h"
 #include "libzerocoin/bignum.h"
 #include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
 #include <iostream>
 #include <accumulators.h>
 #include "wallet.h"
@@ -88,6 +90,71 @@ BOOST_AUTO_TEST_CASE(bignum_basic_tests)
     BOOST_CHECK_MESSAGE(bn2 == bn, "CBigNum.setvch() or CBigNum.getvch() does not work correctly");
 }
 
+BOOST_AUTO_TEST_CASE(bignum_fixedbase_tests)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    ZerocoinParams* ZCParams = Params().Zerocoin_Params(false);
+    const IntegerGroupParams& group = ZCParams->coinCommitmentGroup;
+    const IntegerGroupParams& sokGroup = ZCParams->serialNumberSoKCommitmentGroup;
+
+    std::vector<CBigNum> vExponents;
+    vExponents.push_back(CBigNum(0));
+    vExponents.push_back(CBigNum(1));
+    vExponents.push_back(group.groupOrder);
+    vExponents.push_back(group.groupOrder - CBigNum(1));
+    vExponents.push_back(group.groupOrder * CBigNum(3) + CBigNum(7));
+    vExponents.push_back(CBigNum(0) - CBigNum::randBignum(group.groupOrder));
+    for (int i = 0; i < 16; i++)
+        vExponents.push_back(CBigNum::randBignum(group.modulus));
+
+    for (const CBigNum& e : vExponents) {
+        BOOST_CHECK(group.gPow(e) == group.g.pow_mod(e, group.modulus));
+        BOOST_CHECK(group.hPow(e) == group.h.pow_mod(e, group.modulus));
+        BOOST_CHECK(sokGroup.gPow(e) == sokGroup.g.pow_mod(e, sokGroup.modulus));
+        BOOST_CHECK(sokGroup.hPow(e) == sokGroup.h.pow_mod(e, sokGroup.modulus));
+        BOOST_CHECK(sokGroup.powMod(group.g, e) == group.g.pow_mod(e, sokGroup.modulus));
+    }
+
+    // A table built with a different window size must agree as well
+    CBigNumFixedBase table(group.g, group.modulusContext, group.groupOrder, 6);
+    for (const CBigNum& e : vExponents)
+        BOOST_CHECK(table.pow_mod(e) == group.g.pow_mod(e, group.modulus));
+}
+
+BOOST_AUTO_TEST_CASE(bignum_multiexp_tests)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    ZerocoinParams* ZCParams = Params().Zerocoin_Params(false);
+    const IntegerGroupParams& group = ZCParams->accumulatorParams.accumulatorPoKCommitmentGroup;
+    const CBigNum& accModulus = ZCParams->accumulatorParams.accumulatorModulus;
+
+    for (int i = 0; i < 12; i++) {
+        std::vector<CBigNum> vBases, vExps;
+        for (int j = 0; j <= i % 4; j++) {
+            vBases.push_back(CBigNum::randBignum(accModulus));
+            CBigNum e = CBigNum::randBignum(group.modulus);
+            if ((i + j) % 3 == 0)
+                e = CBigNum(0) - e;
+            vExps.push_back(e);
+        }
+        if (i == 5)
+            vExps[0] = 0;
+
+        CBigNum expected = 1;
+        CBigNum expectedAcc = 1;
+        for (unsigned int j = 0; j < vBases.size(); j++) {
+            expected = expected.mul_mod(vBases[j].pow_mod(vExps[j], group.modulus), group.modulus);
+            expectedAcc = expectedAcc.mul_mod(vBases[j].pow_mod(vExps[j], accModulus), accModulus);
+        }
+        BOOST_CHECK(group.multiPowMod(vBases, vExps) == expected);
+        BOOST_CHECK(CBigNum::pow_mod_multi(vBases, vExps, group.modulus) == expected);
+        BOOST_CHECK(CBigNum::pow_mod_multi(vBases, vExps, accModulus) == expectedAcc);
+    }
+
+    // No terms at all give the empty product
+    BOOST_CHECK(CBigNum::pow_mod_multi(std::vector<CBigNum>(), std::vector<CBigNum>(), accModulus) == CBigNum(1));
+}
+
 //ZQ_ONE mints
 std::string rawTx1 = "0100000001983d5fd91685bb726c0ebc3676f89101b16e663fd896fea53e19972b95054c49000000006a473044022010fbec3e78f9c46e58193d481caff715ceb984df44671d30a2c0bde95c54055f0220446a97d9340da690eaf2658e5b2bf6a0add06f1ae3f1b40f37614c7079ce450d012103cb666bd0f32b71cbf4f32e95fa58e05cd83869ac101435fcb8acee99123ccd1dffffffff0200e1f5050000000086c10280004c80c3a01f94e71662f2ae8bfcd88dfc5b5e717136facd6538829db0c7f01e5fd793cccae7aa1958564518e0223d6d9ce15b1e38e757583546e3b9a3f85bd14408120cd5192a901bb52152e8759fdd194df230d78477706d0e412a66398f330be38a23540d12ab147e9fb19224913f3fe552ae6a587fb30a68743e52577150ff73042c0f0d8f000000001976a914d6042025bd1fff4da5da5c432d85d82b3f26a01688ac00000000";
 std::string rawTxpub1 = "473ff507157523e74680ab37f586aae52e53f3f912492b19f7e14ab120d54238ae30b338f39662a410e6d707784d730f24d19dd9f75e85221b51b902a19d50c120844d15bf8a3b9e346355857e7381e5be19c6d3d22e01845565819aae7cacc93d75f1ef0c7b09d823865cdfa3671715e5bfc8dd8fc8baef26216e7941fa0c3";
@@ -406,6 +473,76 @@ BOOST_AUTO_TEST_CASE(checkzerocoinspend_test)
     BOOST_CHECK_MESSAGE(coinSpend_v2.getPubKey() == privateCoin_v2.getPubKey(), "pub keys do not match");
 }
 
+BOOST_AUTO_TEST_CASE(checkzerocoinspend_parallel_sok_test)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    ZerocoinParams* params = Params().Zerocoin_Params(false);
+
+    boost::thread_group threadGroup;
+    for (int i = 0; i < 3; i++)
+        threadGroup.create_thread(&ThreadSerialNumberSoKCheck);
+
+    PrivateCoin privateCoin(params, CoinDenomination::ZQ_ONE);
+    Accumulator accumulator(params, CoinDenomination::ZQ_ONE);
+    AccumulatorWitness witness(params, accumulator, privateCoin.getPublicCoin());
+    for (int i = 0; i < 2; i++) {
+        PrivateCoin privTemp(params, CoinDenomination::ZQ_ONE);
+        accumulator += privTemp.getPublicCoin();
+        witness += privTemp.getPublicCoin();
+    }
+    accumulator += privateCoin.getPublicCoin();
+
+    // Proof creation and verification spread the iterations over the workers
+    // but must hash them in order, so the proof checks out and round-trips
+    uint256 ptxHash = CBigNum::RandKBitBigum(256).getuint256();
+    CoinSpend coinSpend(params, params, privateCoin, accumulator, GetChecksum(accumulator.getValue()), witness, ptxHash, SpendType::SPEND);
+    BOOST_CHECK_MESSAGE(coinSpend.Verify(accumulator), "coinspend created with SoK workers failed to verify");
+
+    CDataStream serializedCoinSpend(SER_NETWORK, PROTOCOL_VERSION);
+    serializedCoinSpend << coinSpend;
+    CoinSpend spend2(params, params, serializedCoinSpend);
+    BOOST_CHECK_MESSAGE(spend2.Verify(accumulator), "deserialized coinspend failed to verify with SoK workers");
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+
+    // And the same proof verifies without any worker
+    BOOST_CHECK_MESSAGE(spend2.Verify(accumulator), "deserialized coinspend failed to verify without SoK workers");
+}
+
+BOOST_AUTO_TEST_CASE(accumulator_batch_increment_test)
+{
+    SelectParams(CBaseChainParams::MAIN);
+    ZerocoinParams* params = Params().Zerocoin_Params(false);
+
+    std::list<PublicCoin> listPubcoins;
+    std::vector<CBigNum> vValues;
+    Accumulator accumulator(params, CoinDenomination::ZQ_FIVE);
+    AccumulatorMap mapAccumulators(params);
+    for (int i = 0; i < 5; i++) {
+        CoinDenomination denom = i % 2 ? CoinDenomination::ZQ_FIVE : CoinDenomination::ZQ_TEN;
+        PrivateCoin privTemp(params, denom);
+        listPubcoins.emplace_back(privTemp.getPublicCoin());
+        mapAccumulators.Accumulate(privTemp.getPublicCoin(), true);
+        if (denom == CoinDenomination::ZQ_FIVE) {
+            accumulator.increment(privTemp.getPublicCoin().getValue());
+            vValues.emplace_back(privTemp.getPublicCoin().getValue());
+        }
+    }
+
+    // One exponentiation by the product gives the same value as one per coin
+    Accumulator accumulatorBatch(params, CoinDenomination::ZQ_FIVE);
+    accumulatorBatch.increment(vValues);
+    BOOST_CHECK_MESSAGE(accumulatorBatch == accumulator, "batch increment differs from single increments");
+
+    accumulatorBatch.increment(std::vector<CBigNum>());
+    BOOST_CHECK_MESSAGE(accumulatorBatch == accumulator, "empty batch changed the accumulator");
+
+    AccumulatorMap mapBatch(params);
+    BOOST_CHECK(mapBatch.Accumulate(listPubcoins));
+    BOOST_CHECK_MESSAGE(mapBatch.GetCheckpoint() == mapAccumulators.GetCheckpoint(), "batch accumulate differs from single accumulates");
+}
+
 BOOST_AUTO_TEST_CASE(setup_exceptions_test)
 {
     CBigNum bnTrustedModulus = 0;
@@ -0,0 +1,178 @@
+// Copyright (c) 2019 The BITWIN24 developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "txdb.h"
+
+#include "chainparams.h"
+#include "main.h"
+#include "primitives/zerocoin.h"
+#include "random.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(zerocoindb_tests)
+
+BOOST_AUTO_TEST_CASE(zerocoin_cache_write_back)
+{
+    CZerocoinDB db(1 << 20, true);
+    CZerocoinViewCache cache(&db);
+    BOOST_CHECK(cache.LoadSerials());
+
+    const CBigNum bnPubcoin(1234567);
+    const CBigNum bnSerial(7654321);
+    const uint256 hashTx = GetRandHash();
+    cache.WriteCoinMint(GetPubCoinHash(bnPubcoin), hashTx);
+    cache.WriteCoinSpend(GetSerialHash(bnSerial), hashTx);
+    cache.WriteAccumulatorValue(42, CBigNum(99));
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 3U);
+
+    // written entries are served from memory until the flush
+    uint256 hashRead;
+    CBigNum bnRead;
+    BOOST_CHECK(cache.ReadCoinMint(bnPubcoin, hashRead) && hashRead == hashTx);
+    BOOST_CHECK(!db.ReadCoinMint(bnPubcoin, hashRead));
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK_EQUAL(cache.GetCacheSize(), 0U);
+    BOOST_CHECK(db.ReadCoinMint(bnPubcoin, hashRead) && hashRead == hashTx);
+    BOOST_CHECK(db.ReadCoinSpend(bnSerial, hashRead) && hashRead == hashTx);
+    BOOST_CHECK(db.ReadAccumulatorValue(42, bnRead) && bnRead == CBigNum(99));
+
+    // erasing, as when a block is disconnected, hides the stored entries before they are deleted
+    cache.EraseCoinMint(bnPubcoin);
+    cache.EraseCoinSpend(bnSerial);
+    cache.EraseAccumulatorValue(42);
+    BOOST_CHECK(!cache.ReadCoinMint(bnPubcoin, hashRead));
+    BOOST_CHECK(!cache.ReadCoinSpend(bnSerial, hashRead));
+    BOOST_CHECK(!cache.ReadAccumulatorValue(42, bnRead));
+    BOOST_CHECK(db.ReadCoinSpend(bnSerial, hashRead));
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(!db.ReadCoinMint(bnPubcoin, hashRead));
+    BOOST_CHECK(!db.ReadCoinSpend(bnSerial, hashRead));
+    BOOST_CHECK(!db.ReadAccumulatorValue(42, bnRead));
+
+    // spends written with their block height report it, reloading from the database forgets it
+    cache.WriteCoinSpend(GetSerialHash(bnSerial), hashTx, 10);
+    int nHeight;
+    BOOST_CHECK(cache.ReadCoinSpend(GetSerialHash(bnSerial), hashRead, nHeight) && nHeight == 10);
+    BOOST_CHECK(cache.Flush());
+    BOOST_CHECK(cache.LoadSerials());
+    BOOST_CHECK(cache.ReadCoinSpend(GetSerialHash(bnSerial), hashRead, nHeight) && hashRead == hashTx && nHeight == -1);
+}
+
+BOOST_AUTO_TEST_CASE(block_pubcoin_index)
+{
+    CZerocoinDB db(1 << 20, true);
+    CZerocoinViewCache cache(&db);
+
+    std::map<libzerocoin::CoinDenomination, std::vector<std::pair<CBigNum, bool> > > mapPubcoins;
+    mapPubcoins[libzerocoin::ZQ_ONE].push_back(std::make_pair(CBigNum(GetRandHash()), false));
+    mapPubcoins[libzerocoin::ZQ_ONE].push_back(std::make_pair(CBigNum(GetRandHash()), true));
+    mapPubcoins[libzerocoin::ZQ_FIFTY].push_back(std::make_pair(CBigNum(GetRandHash()), false));
+    const uint256 hashBlock = GetRandHash();
+    BOOST_CHECK(cache.WriteBlockPubcoins(7, hashBlock, mapPubcoins));
+
+    // the 'P' entry lists the minted denominations and the block they came from
+    uint256 hashRead;
+    std::vector<libzerocoin::CoinDenomination> vDenoms;
+    BOOST_CHECK(cache.ReadBlockPubcoinDenoms(7, hashRead, vDenoms));
+    BOOST_CHECK(hashRead == hashBlock);
+    BOOST_CHECK(vDenoms == std::vector<libzerocoin::CoinDenomination>({libzerocoin::ZQ_ONE, libzerocoin::ZQ_FIFTY}));
+    BOOST_CHECK(!cache.ReadBlockPubcoinDenoms(8, hashRead, vDenoms));
+
+    // and one 'p' entry per denomination holds its pubcoins in block order
+    std::vector<std::pair<CBigNum, bool> > vPubcoins;
+    BOOST_CHECK(cache.ReadBlockPubcoins(7, libzerocoin::ZQ_ONE, vPubcoins));
+    BOOST_CHECK(vPubcoins == mapPubcoins[libzerocoin::ZQ_ONE]);
+    BOOST_CHECK(db.ReadBlockPubcoins(7, libzerocoin::ZQ_FIFTY, vPubcoins));
+    BOOST_CHECK(vPubcoins == mapPubcoins[libzerocoin::ZQ_FIFTY]);
+    BOOST_CHECK(!cache.ReadBlockPubcoins(7, libzerocoin::ZQ_FIVE, vPubcoins));
+
+    BOOST_CHECK(cache.EraseBlockPubcoins(7));
+    BOOST_CHECK(!db.ReadBlockPubcoinDenoms(7, hashRead, vDenoms));
+    BOOST_CHECK(!db.ReadBlockPubcoins(7, libzerocoin::ZQ_ONE, vPubcoins));
+    BOOST_CHECK(!db.ReadBlockPubcoins(7, libzerocoin::ZQ_FIFTY, vPubcoins));
+}
+
+BOOST_AUTO_TEST_CASE(block_pubcoin_index_disconnect)
+{
+    LOCK(cs_main);
+
+    // a coinbase only block on top of the genesis block, with its (empty) undo data on disk
+    CMutableTransaction txCoinbase;
+    txCoinbase.vin.resize(1);
+    txCoinbase.vin[0].scriptSig = CScript() << 1 << OP_0;
+    txCoinbase.vout.resize(1);
+    txCoinbase.vout[0].nValue = 1;
+    txCoinbase.vout[0].scriptPubKey = CScript() << OP_TRUE;
+    CBlock block;
+    block.hashPrevBlock = chainActive.Genesis()->GetBlockHash();
+    block.vtx.push_back(txCoinbase);
+    const uint256 hashBlock = block.GetHash();
+
+    CBlockIndex index(block);
+    index.phashBlock = &hashBlock;
+    index.pprev = chainActive.Genesis();
+    index.nHeight = 1;
+
+    CBlockUndo blockundo;
+    CDiskBlockPos pos(999, 0);
+    BOOST_CHECK(blockundo.WriteToDisk(pos, block.hashPrevBlock));
+    index.nFile = pos.nFile;
+    index.nUndoPos = pos.nPos;
+    index.nStatus |= BLOCK_HAVE_UNDO;
+
+    CCoinsViewCache view(pcoinsTip);
+    *view.ModifyCoins(block.vtx[0].GetHash()) = CCoins(block.vtx[0], 1);
+    view.SetBestBlock(hashBlock);
+
+    std::map<libzerocoin::CoinDenomination, std::vector<std::pair<CBigNum, bool> > > mapPubcoins;
+    mapPubcoins[libzerocoin::ZQ_TEN].push_back(std::make_pair(CBigNum(GetRandHash()), false));
+    BOOST_CHECK(pzerocoinTip->WriteBlockPubcoins(1, hashBlock, mapPubcoins));
+
+    // disconnecting the block drops its entries from the index
+    CValidationState state;
+    bool fClean;
+    BOOST_CHECK(DisconnectBlock(block, state, &index, view, &fClean));
+    BOOST_CHECK(fClean);
+    uint256 hashRead;
+    std::vector<libzerocoin::CoinDenomination> vDenoms;
+    std::vector<std::pair<CBigNum, bool> > vPubcoins;
+    BOOST_CHECK(!pzerocoinTip->ReadBlockPubcoinDenoms(1, hashRead, vDenoms));
+    BOOST_CHECK(!pzerocoinTip->ReadBlockPubcoins(1, libzerocoin::ZQ_TEN, vPubcoins));
+}
+
+BOOST_AUTO_TEST_CASE(serial_index)
+{
+    CSerialIndex serials;
+    std::vector<uint256> vSerials;
+    for (int i = 0; i < 5000; i++) {
+        vSerials.push_back(GetRandHash());
+        serials.Insert(vSerials.back(), vSerials.back(), i);
+    }
+    BOOST_CHECK_EQUAL(serials.size(), 5000U);
+
+    // erase every other serial, the ones left behind in each probe run must still be found
+    for (int i = 0; i < 5000; i += 2)
+        BOOST_CHECK(serials.Erase(vSerials[i]));
+    BOOST_CHECK(!serials.Erase(vSerials[0]));
+    BOOST_CHECK_EQUAL(serials.size(), 2500U);
+    for (int i = 0; i < 5000; i++) {
+        uint256 txid;
+        int nHeight;
+        BOOST_CHECK_EQUAL(serials.Lookup(vSerials[i], txid, nHeight), i % 2 == 1);
+        if (i % 2 == 1)
+            BOOST_CHECK(txid == vSerials[i] && nHeight == i);
+    }
+
+    uint256 txid;
+    int nHeight;
+    BOOST_CHECK(serials.SetHeight(vSerials[1], 7));
+    BOOST_CHECK(serials.Lookup(vSerials[1], txid, nHeight) && nHeight == 7);
+    BOOST_CHECK(!serials.Lookup(GetRandHash(), txid, nHeight));
+
+    serials.Clear();
+    BOOST_CHECK(!serials.Lookup(vSerials[1], txid, nHeight));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -74,6 +74,149 @@ bool CCoinsViewDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
     return db.WriteBatch(batch);
 }
 
+bool CCoinsViewDB::WriteCoins(const CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    CLevelDBBatch batch;
+    size_t changed = 0;
+    for (CCoinsMap::const_iterator it = mapCoins.begin(); it != mapCoins.end(); it++) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            BatchWriteCoins(batch, it->first, it->second.coins);
+            changed++;
+        }
+    }
+    if (hashBlock != uint256(0))
+        BatchWriteHashBestChain(batch, hashBlock);
+
+    LogPrint("coindb", "Committing %u changed transactions to coin database...\n", (unsigned int)changed);
+    return db.WriteBatch(batch);
+}
+
+CCoinsViewAsyncDB::CCoinsViewAsyncDB(CCoinsView* baseIn, CCoinsViewDB& dbIn) : CCoinsViewBacked(baseIn), db(dbIn), hashBlockPending(0), fPending(false), fFailed(false), fShutdown(false)
+{
+    thread = boost::thread(&CCoinsViewAsyncDB::ThreadWrite, this);
+}
+
+CCoinsViewAsyncDB::~CCoinsViewAsyncDB()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        fShutdown = true;
+        cond.notify_all();
+    }
+    thread.join();
+}
+
+void CCoinsViewAsyncDB::ThreadWrite()
+{
+    RenameThread("bitwin24-coinsdb");
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (true) {
+        while (!fPending && !fShutdown)
+            cond.wait(lock);
+        if (!fPending)
+            return;
+
+        // The snapshot stays put until fPending is cleared, so it is written without the lock
+        lock.unlock();
+        const int64_t nStart = GetTimeMicros();
+        bool fOk = false;
+        try {
+            fOk = db.WriteCoins(mapPending, hashBlockPending);
+        } catch (const std::exception& e) {
+            LogPrintf("%s : %s\n", __func__, e.what());
+        }
+        LogPrint("bench", "  - Background write of %u coins entries: %.2fms\n", (unsigned int)mapPending.size(), (GetTimeMicros() - nStart) * 0.001);
+        lock.lock();
+
+        if (!fOk)
+            fFailed = true;
+        mapPending.clear();
+        fPending = false;
+        cond.notify_all();
+    }
+}
+
+bool CCoinsViewAsyncDB::GetCoins(const uint256& txid, CCoins& coins) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (fPending) {
+            CCoinsMap::const_iterator it = mapPending.find(txid);
+            if (it != mapPending.end()) {
+                // A pruned entry is about to be erased from the database
+                if (it->second.coins.IsPruned())
+                    return false;
+                coins = it->second.coins;
+                return true;
+            }
+        }
+    }
+    return base->GetCoins(txid, coins);
+}
+
+bool CCoinsViewAsyncDB::HaveCoins(const uint256& txid) const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (fPending) {
+            CCoinsMap::const_iterator it = mapPending.find(txid);
+            if (it != mapPending.end())
+                return !it->second.coins.IsPruned();
+        }
+    }
+    return base->HaveCoins(txid);
+}
+
+uint256 CCoinsViewAsyncDB::GetBestBlock() const
+{
+    {
+        boost::unique_lock<boost::mutex> lock(cs);
+        if (fPending && hashBlockPending != uint256(0))
+            return hashBlockPending;
+    }
+    return base->GetBestBlock();
+}
+
+bool CCoinsViewAsyncDB::BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock)
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    // One snapshot at a time, so they reach the database in order
+    while (fPending)
+        cond.wait(lock);
+    if (fFailed)
+        return false;
+
+    // Entries are moved rather than the maps swapped, as the two maps need not share an allocator
+    for (CCoinsMap::iterator it = mapCoins.begin(); it != mapCoins.end();) {
+        if (it->second.flags & CCoinsCacheEntry::DIRTY) {
+            CCoinsCacheEntry& entry = mapPending[it->first];
+            entry.coins.swap(it->second.coins);
+            entry.flags = CCoinsCacheEntry::DIRTY;
+        }
+        CCoinsMap::iterator itOld = it++;
+        mapCoins.erase(itOld);
+    }
+    hashBlockPending = hashBlock;
+    fPending = true;
+    cond.notify_all();
+    return true;
+}
+
+bool CCoinsViewAsyncDB::GetStats(CCoinsStats& stats) const
+{
+    if (!Wait())
+        return false;
+    return base->GetStats(stats);
+}
+
+bool CCoinsViewAsyncDB::Wait() const
+{
+    boost::unique_lock<boost::mutex> lock(cs);
+    while (fPending)
+        cond.wait(lock);
+    return !fFailed;
+}
+
 CBlockTreeDB::CBlockTreeDB(size_t nCacheSize, bool fMemory, bool fWipe) : CLevelDBWrapper(GetDataDir() / "blocks" / "index", nCacheSize, fMemory, fWipe)
 {
 }
@@ -184,6 +327,26 @@ bool CBlockTreeDB::WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos>
     return WriteBatch(batch);
 }
 
+bool CBlockTreeDB::ReadStakeInput(const COutPoint& prevout, uint256& hashBlockFrom, CTxOut& txout)
+{
+    std::pair<uint256, CTxOut> value;
+    if (!Read(make_pair('k', prevout), value))
+        return false;
+    hashBlockFrom = value.first;
+    txout = value.second;
+    return true;
+}
+
+bool CBlockTreeDB::WriteStakeInput(const COutPoint& prevout, const uint256& hashBlockFrom, const CTxOut& txout)
+{
+    return Write(make_pair('k', prevout), make_pair(hashBlockFrom, txout));
+}
+
+bool CBlockTreeDB::EraseStakeInput(const COutPoint& prevout)
+{
+    return Erase(make_pair('k', prevout));
+}
+
 bool CBlockTreeDB::WriteFlag(const std::string& name, bool fValue)
 {
     return Write(std::make_pair('F', name), fValue ? '1' : '0');
@@ -217,7 +380,6 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
     pcursor->Seek(ssKeySet.str());
 
     // Load mapBlockIndex
-    uint256 nPreviousCheckpoint;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
@@ -269,15 +431,6 @@ bool CBlockTreeDB::LoadBlockIndexGuts()
                 if (pindexNew->IsProofOfStake())
                     setStakeSeen.insert(make_pair(pindexNew->prevoutStake, pindexNew->nStakeTime));
 
-                //populate accumulator checksum map in memory
-                if(pindexNew->nAccumulatorCheckpoint != 0 && pindexNew->nAccumulatorCheckpoint != nPreviousCheckpoint) {
-                    //Don't load any checkpoints that exist before v2 zbwi. The accumulator is invalid for v1 and not used.
-                    if (pindexNew->nHeight >= Params().Zerocoin_Block_V2_Start())
-                        LoadAccumulatorValuesFromDB(pindexNew->nAccumulatorCheckpoint);
-
-                    nPreviousCheckpoint = pindexNew->nAccumulatorCheckpoint;
-                }
-
                 pcursor->Next();
             } else {
                 break; // if shutdown requested or finished loading block index
@@ -424,3 +577,306 @@ bool CZerocoinDB::EraseAccumulatorValue(const uint32_t& nChecksum)
     LogPrint("zero", "%s : checksum:%d\n", __func__, nChecksum);
     return Erase(make_pair('2', nChecksum));
 }
+
+bool CZerocoinDB::WriteBlockPubcoins(int nHeight, const uint256& hashBlock, const std::map<libzerocoin::CoinDenomination, std::vector<std::pair<CBigNum, bool> > >& mapPubcoins)
+{
+    CLevelDBBatch batch;
+    std::vector<libzerocoin::CoinDenomination> vDenoms;
+    for (const auto& denomPubcoins : mapPubcoins) {
+        vDenoms.emplace_back(denomPubcoins.first);
+        batch.Write(make_pair('p', make_pair(nHeight, denomPubcoins.first)), denomPubcoins.second);
+    }
+    // The block hash lets readers tell an entry from a block that has since been reorganized away
+    batch.Write(make_pair('P', nHeight), make_pair(hashBlock, vDenoms));
+    return WriteBatch(batch);
+}
+
+bool CZerocoinDB::ReadBlockPubcoinDenoms(int nHeight, uint256& hashBlock, std::vector<libzerocoin::CoinDenomination>& vDenoms)
+{
+    std::pair<uint256, std::vector<libzerocoin::CoinDenomination> > entry;
+    if (!Read(make_pair('P', nHeight), entry))
+        return false;
+    hashBlock = entry.first;
+    vDenoms = entry.second;
+    return true;
+}
+
+bool CZerocoinDB::ReadBlockPubcoins(int nHeight, libzerocoin::CoinDenomination denom, std::vector<std::pair<CBigNum, bool> >& vPubcoins)
+{
+    return Read(make_pair('p', make_pair(nHeight, denom)), vPubcoins);
+}
+
+bool CZerocoinDB::EraseBlockPubcoins(int nHeight)
+{
+    CLevelDBBatch batch;
+    batch.Erase(make_pair('P', nHeight));
+    for (const libzerocoin::CoinDenomination denom : libzerocoin::zerocoinDenomList)
+        batch.Erase(make_pair('p', make_pair(nHeight, denom)));
+    return WriteBatch(batch);
+}
+
+bool CZerocoinDB::BatchWrite(const std::map<uint256, uint256>& mapMints, const std::map<uint256, uint256>& mapSpends, const std::map<uint32_t, CBigNum>& mapAccumulatorValues)
+{
+    CLevelDBBatch batch;
+    for (const std::pair<const uint256, uint256>& mint : mapMints) {
+        if (mint.second == 0)
+            batch.Erase(make_pair('m', mint.first));
+        else
+            batch.Write(make_pair('m', mint.first), mint.second);
+    }
+    for (const std::pair<const uint256, uint256>& spend : mapSpends) {
+        if (spend.second == 0)
+            batch.Erase(make_pair('s', spend.first));
+        else
+            batch.Write(make_pair('s', spend.first), spend.second);
+    }
+    for (const std::pair<const uint32_t, CBigNum>& value : mapAccumulatorValues) {
+        if (value.second == 0)
+            batch.Erase(make_pair('2', value.first));
+        else
+            batch.Write(make_pair('2', value.first), value.second);
+    }
+
+    LogPrint("zero", "Committing %u mints, %u spends and %u accumulator values to zerocoin database...\n",
+        (unsigned int)mapMints.size(), (unsigned int)mapSpends.size(), (unsigned int)mapAccumulatorValues.size());
+    return WriteBatch(batch, true);
+}
+
+bool CZerocoinDB::LoadCoinSpends(CSerialIndex& serials)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+
+    CDataStream ssKeySet(SER_DISK, CLIENT_VERSION);
+    ssKeySet << make_pair('s', uint256(0));
+    pcursor->Seek(ssKeySet.str());
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chType;
+            ssKey >> chType;
+            if (chType != 's')
+                break;
+            uint256 hashSerial;
+            ssKey >> hashSerial;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            uint256 txid;
+            ssValue >> txid;
+            serials.Insert(hashSerial, txid);
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+CZerocoinViewCache::CZerocoinViewCache(CZerocoinDB* baseIn) : base(baseIn), fSerialsLoaded(false) {}
+
+bool CZerocoinViewCache::WriteCoinMint(const uint256& hashPubcoin, const uint256& hashTx)
+{
+    LOCK(cs);
+    mapMints[hashPubcoin] = hashTx;
+    return true;
+}
+
+bool CZerocoinViewCache::WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo)
+{
+    for (const std::pair<libzerocoin::PublicCoin, uint256>& mint : mintInfo)
+        WriteCoinMint(GetPubCoinHash(mint.first.getValue()), mint.second);
+    return true;
+}
+
+bool CZerocoinViewCache::ReadCoinMint(const CBigNum& bnPubcoin, uint256& hashTx)
+{
+    return ReadCoinMint(GetPubCoinHash(bnPubcoin), hashTx);
+}
+
+bool CZerocoinViewCache::ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx)
+{
+    {
+        LOCK(cs);
+        std::map<uint256, uint256>::const_iterator it = mapMints.find(hashPubcoin);
+        if (it != mapMints.end()) {
+            hashTx = it->second;
+            return hashTx != 0;
+        }
+    }
+    return base->ReadCoinMint(hashPubcoin, hashTx);
+}
+
+bool CZerocoinViewCache::EraseCoinMint(const CBigNum& bnPubcoin)
+{
+    return WriteCoinMint(GetPubCoinHash(bnPubcoin), 0);
+}
+
+bool CZerocoinViewCache::WriteCoinSpend(const uint256& hashSerial, const uint256& hashTx, int nHeight)
+{
+    LOCK(cs);
+    mapSpends[hashSerial] = hashTx;
+    if (hashTx == 0)
+        serials.Erase(hashSerial);
+    else
+        serials.Insert(hashSerial, hashTx, nHeight);
+    return true;
+}
+
+bool CZerocoinViewCache::WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo, int nHeight)
+{
+    for (const std::pair<libzerocoin::CoinSpend, uint256>& spend : spendInfo)
+        WriteCoinSpend(GetSerialHash(spend.first.getCoinSerialNumber()), spend.second, nHeight);
+    return true;
+}
+
+bool CZerocoinViewCache::ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash)
+{
+    return ReadCoinSpend(GetSerialHash(bnSerial), txHash);
+}
+
+bool CZerocoinViewCache::ReadCoinSpend(const uint256& hashSerial, uint256& txHash)
+{
+    int nHeight;
+    return ReadCoinSpend(hashSerial, txHash, nHeight);
+}
+
+bool CZerocoinViewCache::ReadCoinSpend(const uint256& hashSerial, uint256& txHash, int& nHeight)
+{
+    {
+        LOCK(cs);
+        if (fSerialsLoaded)
+            return serials.Lookup(hashSerial, txHash, nHeight);
+        std::map<uint256, uint256>::const_iterator it = mapSpends.find(hashSerial);
+        if (it != mapSpends.end()) {
+            txHash = it->second;
+            nHeight = -1;
+            return txHash != 0;
+        }
+    }
+    nHeight = -1;
+    return base->ReadCoinSpend(hashSerial, txHash);
+}
+
+void CZerocoinViewCache::SetCoinSpendHeight(const uint256& hashSerial, int nHeight)
+{
+    LOCK(cs);
+    serials.SetHeight(hashSerial, nHeight);
+}
+
+bool CZerocoinViewCache::EraseCoinSpend(const CBigNum& bnSerial)
+{
+    return WriteCoinSpend(GetSerialHash(bnSerial), 0);
+}
+
+bool CZerocoinViewCache::WipeCoins(std::string strType)
+{
+    {
+        LOCK(cs);
+        if (strType == "spends") {
+            mapSpends.clear();
+            serials.Clear();
+        }
+        else if (strType == "mints")
+            mapMints.clear();
+    }
+    return base->WipeCoins(strType);
+}
+
+bool CZerocoinViewCache::WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue)
+{
+    LogPrint("zero","%s : checksum:%d val:%s\n", __func__, nChecksum, bnValue.GetHex());
+    LOCK(cs);
+    mapAccumulatorValues[nChecksum] = bnValue;
+    return true;
+}
+
+bool CZerocoinViewCache::ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue)
+{
+    {
+        LOCK(cs);
+        std::map<uint32_t, CBigNum>::const_iterator it = mapAccumulatorValues.find(nChecksum);
+        if (it != mapAccumulatorValues.end()) {
+            bnValue = it->second;
+            return bnValue != 0;
+        }
+    }
+    return base->ReadAccumulatorValue(nChecksum, bnValue);
+}
+
+bool CZerocoinViewCache::EraseAccumulatorValue(const uint32_t& nChecksum)
+{
+    LogPrint("zero", "%s : checksum:%d\n", __func__, nChecksum);
+    LOCK(cs);
+    mapAccumulatorValues[nChecksum] = 0;
+    return true;
+}
+
+bool CZerocoinViewCache::WriteBlockPubcoins(int nHeight, const uint256& hashBlock, const std::map<libzerocoin::CoinDenomination, std::vector<std::pair<CBigNum, bool> > >& mapPubcoins)
+{
+    return base->WriteBlockPubcoins(nHeight, hashBlock, mapPubcoins);
+}
+
+bool CZerocoinViewCache::ReadBlockPubcoinDenoms(int nHeight, uint256& hashBlock, std::vector<libzerocoin::CoinDenomination>& vDenoms)
+{
+    return base->ReadBlockPubcoinDenoms(nHeight, hashBlock, vDenoms);
+}
+
+bool CZerocoinViewCache::ReadBlockPubcoins(int nHeight, libzerocoin::CoinDenomination denom, std::vector<std::pair<CBigNum, bool> >& vPubcoins)
+{
+    return base->ReadBlockPubcoins(nHeight, denom, vPubcoins);
+}
+
+bool CZerocoinViewCache::EraseBlockPubcoins(int nHeight)
+{
+    return base->EraseBlockPubcoins(nHeight);
+}
+
+bool CZerocoinViewCache::LoadSerials()
+{
+    LOCK(cs);
+    int64_t nStart = GetTimeMillis();
+    serials.Clear();
+    fSerialsLoaded = false;
+    if (!base->LoadCoinSpends(serials))
+        return false;
+    // Spends not flushed yet take precedence over the stored ones
+    for (const std::pair<const uint256, uint256>& spend : mapSpends) {
+        if (spend.second == 0)
+            serials.Erase(spend.first);
+        else
+            serials.Insert(spend.first, spend.second);
+    }
+    fSerialsLoaded = true;
+    LogPrintf("%s: %u spent serials in %dms, %.1fMiB\n", __func__, serials.size(), GetTimeMillis() - nStart,
+        serials.DynamicUsage() * (1.0 / (1 << 20)));
+    return true;
+}
+
+bool CZerocoinViewCache::Flush()
+{
+    LOCK(cs);
+    if (mapMints.empty() && mapSpends.empty() && mapAccumulatorValues.empty())
+        return true;
+    if (!base->BatchWrite(mapMints, mapSpends, mapAccumulatorValues))
+        return false;
+    mapMints.clear();
+    mapSpends.clear();
+    mapAccumulatorValues.clear();
+    return true;
+}
+
+unsigned int CZerocoinViewCache::GetCacheSize() const
+{
+    LOCK(cs);
+    return mapMints.size() + mapSpends.size() + mapAccumulatorValues.size();
+}
+
+size_t CZerocoinViewCache::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    size_t nUsage = memusage::DynamicUsage(mapMints) + memusage::DynamicUsage(mapSpends) + memusage::DynamicUsage(mapAccumulatorValues);
+    for (const std::pair<const uint32_t, CBigNum>& value : mapAccumulatorValues)
+        nUsage += memusage::MallocUsage((value.second.bitSize() + 7) / 8);
+    return nUsage;
+}
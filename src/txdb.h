@@ -10,12 +10,18 @@
 #include "leveldbwrapper.h"
 #include "main.h"
 #include "primitives/zerocoin.h"
+#include "serialindex.h"
+#include "sync.h"
 
 #include <map>
 #include <string>
 #include <utility>
 #include <vector>
 
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+
 class CCoins;
 class uint256;
 
@@ -25,6 +31,8 @@ static const int64_t nDefaultDbCache = 100;
 static const int64_t nMaxDbCache = sizeof(void*) > 4 ? 4096 : 1024;
 //! min. -dbcache in (MiB)
 static const int64_t nMinDbCache = 4;
+//! -asyncflush default
+static const bool DEFAULT_ASYNC_FLUSH = true;
 
 /** CCoinsView backed by the LevelDB coin database (chainstate/) */
 class CCoinsViewDB : public CCoinsView
@@ -40,6 +48,48 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
+
+    /** Write the dirty entries of mapCoins and the best block marker, leaving mapCoins untouched */
+    bool WriteCoins(const CCoinsMap& mapCoins, const uint256& hashBlock);
+};
+
+/**
+ * Sits between the coins tip and the coin database and moves the writes of a flush to a background
+ * thread. BatchWrite only takes the dirty entries over into a snapshot and returns; the thread
+ * then writes the snapshot, together with its best block marker, in one batch. Until that is done
+ * the snapshot answers reads, so views on top never see the database behind it, and the next
+ * BatchWrite waits for it. A failed write is reported by Wait() and every later BatchWrite.
+ */
+class CCoinsViewAsyncDB : public CCoinsViewBacked
+{
+private:
+    CCoinsViewDB& db;
+
+    mutable boost::mutex cs;
+    mutable boost::condition_variable cond;
+    //! Snapshot being written, not modified while fPending
+    CCoinsMap mapPending;
+    uint256 hashBlockPending;
+    bool fPending;
+    bool fFailed;
+    bool fShutdown;
+    boost::thread thread;
+
+    void ThreadWrite();
+
+public:
+    CCoinsViewAsyncDB(CCoinsView* baseIn, CCoinsViewDB& dbIn);
+    /** Writes what is still pending before returning */
+    ~CCoinsViewAsyncDB();
+
+    bool GetCoins(const uint256& txid, CCoins& coins) const;
+    bool HaveCoins(const uint256& txid) const;
+    uint256 GetBestBlock() const;
+    bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
+    bool GetStats(CCoinsStats& stats) const;
+
+    /** Block until the pending snapshot is on disk, false if any background write failed */
+    bool Wait() const;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -62,6 +112,9 @@ public:
     bool ReadReindexing(bool& fReindex);
     bool ReadTxIndex(const uint256& txid, CDiskTxPos& pos);
     bool WriteTxIndex(const std::vector<std::pair<uint256, CDiskTxPos> >& list);
+    bool ReadStakeInput(const COutPoint& prevout, uint256& hashBlockFrom, CTxOut& txout);
+    bool WriteStakeInput(const COutPoint& prevout, const uint256& hashBlockFrom, const CTxOut& txout);
+    bool EraseStakeInput(const COutPoint& prevout);
     bool WriteFlag(const std::string& name, bool fValue);
     bool ReadFlag(const std::string& name, bool& fValue);
     bool WriteInt(const std::string& name, int nValue);
@@ -94,6 +147,79 @@ public:
     bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
     bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
     bool EraseAccumulatorValue(const uint32_t& nChecksum);
+    /** Per-block index of minted pubcoins: the denominations minted at a height, then the values per denomination */
+    bool WriteBlockPubcoins(int nHeight, const uint256& hashBlock, const std::map<libzerocoin::CoinDenomination, std::vector<std::pair<CBigNum, bool> > >& mapPubcoins);
+    bool ReadBlockPubcoinDenoms(int nHeight, uint256& hashBlock, std::vector<libzerocoin::CoinDenomination>& vDenoms);
+    bool ReadBlockPubcoins(int nHeight, libzerocoin::CoinDenomination denom, std::vector<std::pair<CBigNum, bool> >& vPubcoins);
+    bool EraseBlockPubcoins(int nHeight);
+    /** Write cached mints, spends and accumulator values in one synced batch, null values are erased */
+    bool BatchWrite(const std::map<uint256, uint256>& mapMints, const std::map<uint256, uint256>& mapSpends, const std::map<uint32_t, CBigNum>& mapAccumulatorValues);
+    /** Add every stored spend to the serial index */
+    bool LoadCoinSpends(CSerialIndex& serials);
+};
+
+/**
+ * Write-back cache on top of CZerocoinDB, the zerocoin counterpart of CCoinsViewCache. Mints, spends
+ * and accumulator values written or erased while connecting and disconnecting blocks stay in memory
+ * and reach the database in one synced batch when the chainstate is flushed, instead of several synced
+ * writes per block. An erased entry is kept as a null value until then, so it hides the one on disk.
+ * Block pubcoins are not cached, they are written unsynced and checked against the block hash on read.
+ *
+ * Once LoadSerials() has run, every spent serial is also held in a CSerialIndex, so spend lookups,
+ * including those of serials that were never spent, do not read the database at all.
+ */
+class CZerocoinViewCache
+{
+private:
+    CZerocoinDB* base;
+
+    mutable CCriticalSection cs;
+    std::map<uint256, uint256> mapMints;
+    std::map<uint256, uint256> mapSpends;
+    std::map<uint32_t, CBigNum> mapAccumulatorValues;
+    CSerialIndex serials;
+    bool fSerialsLoaded;
+
+    CZerocoinViewCache(const CZerocoinViewCache&);
+    void operator=(const CZerocoinViewCache&);
+
+public:
+    CZerocoinViewCache(CZerocoinDB* baseIn);
+
+    bool WriteCoinMint(const uint256& hashPubcoin, const uint256& hashTx);
+    bool WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo);
+    bool ReadCoinMint(const CBigNum& bnPubcoin, uint256& hashTx);
+    bool ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx);
+    /** Spends are written with the height of their block when it is known, -1 otherwise */
+    bool WriteCoinSpend(const uint256& hashSerial, const uint256& hashTx, int nHeight = -1);
+    bool WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo, int nHeight = -1);
+    bool ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash);
+    bool ReadCoinSpend(const uint256& hashSerial, uint256& txHash);
+    bool ReadCoinSpend(const uint256& hashSerial, uint256& txHash, int& nHeight);
+    /** Remember the height a spend was found in the chain at */
+    void SetCoinSpendHeight(const uint256& hashSerial, int nHeight);
+    bool EraseCoinMint(const CBigNum& bnPubcoin);
+    bool EraseCoinSpend(const CBigNum& bnSerial);
+    bool WipeCoins(std::string strType);
+    bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
+    bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
+    bool EraseAccumulatorValue(const uint32_t& nChecksum);
+    bool WriteBlockPubcoins(int nHeight, const uint256& hashBlock, const std::map<libzerocoin::CoinDenomination, std::vector<std::pair<CBigNum, bool> > >& mapPubcoins);
+    bool ReadBlockPubcoinDenoms(int nHeight, uint256& hashBlock, std::vector<libzerocoin::CoinDenomination>& vDenoms);
+    bool ReadBlockPubcoins(int nHeight, libzerocoin::CoinDenomination denom, std::vector<std::pair<CBigNum, bool> >& vPubcoins);
+    bool EraseBlockPubcoins(int nHeight);
+
+    /** Fill the serial index from the database */
+    bool LoadSerials();
+
+    /** Write the cached entries to the database and empty the cache */
+    bool Flush();
+
+    /** Number of cached entries */
+    unsigned int GetCacheSize() const;
+
+    /** Memory used by the cached entries, not counting the serial index */
+    size_t DynamicMemoryUsage() const;
 };
 
 #endif // BITCOIN_TXDB_H
@@ -7,6 +7,7 @@
 #include "txmempool.h"
 
 #include "clientversion.h"
+#include "core_memusage.h"
 #include "main.h"
 #include "streams.h"
 #include "util.h"
@@ -17,7 +18,7 @@
 
 using namespace std;
 
-CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nTime(0), dPriority(0.0)
+CTxMemPoolEntry::CTxMemPoolEntry() : nFee(0), nTxSize(0), nModSize(0), nUsageSize(0), nTime(0), dPriority(0.0)
 {
     nHeight = MEMPOOL_HEIGHT;
 }
@@ -27,6 +28,7 @@ CTxMemPoolEntry::CTxMemPoolEntry(const CTransaction& _tx, const CAmount& _nFee,
     nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
 
     nModSize = tx.CalculateModifiedSize(nTxSize);
+    nUsageSize = RecursiveDynamicUsage(tx);
 }
 
 CTxMemPoolEntry::CTxMemPoolEntry(const CTxMemPoolEntry& other)
@@ -356,7 +358,13 @@ public:
 
 
 CTxMemPool::CTxMemPool(const CFeeRate& _minRelayFee) : nTransactionsUpdated(0),
-                                                       minRelayFee(_minRelayFee)
+                                                       minRelayFee(_minRelayFee),
+                                                       totalTxSize(0),
+                                                       cachedInnerUsage(0),
+                                                       nZerocoinSpends(0),
+                                                       lastRollingFeeUpdate(GetTime()),
+                                                       blockSinceLastRollingFeeBump(false),
+                                                       rollingMinimumFeeRate(0)
 {
     // Sanity checks off by default for performance, because otherwise
     // accepting transactions becomes O(N^2) where N is the number
@@ -414,9 +422,12 @@ bool CTxMemPool::addUnchecked(const uint256& hash, const CTxMemPoolEntry& entry)
         if(!tx.IsZerocoinSpend()) {
             for (unsigned int i = 0; i < tx.vin.size(); i++)
                 mapNextTx[tx.vin[i].prevout] = CInPoint(&tx, i);
+        } else {
+            nZerocoinSpends++;
         }
         nTransactionsUpdated++;
         totalTxSize += entry.GetTxSize();
+        cachedInnerUsage += entry.DynamicMemoryUsage();
     }
     return true;
 }
@@ -460,6 +471,9 @@ void CTxMemPool::remove(const CTransaction& origTx, std::list<CTransaction>& rem
 
             removed.push_back(tx);
             totalTxSize -= mapTx[hash].GetTxSize();
+            cachedInnerUsage -= mapTx[hash].DynamicMemoryUsage();
+            if (tx.IsZerocoinSpend())
+                nZerocoinSpends--;
             mapTx.erase(hash);
             nTransactionsUpdated++;
         }
@@ -526,6 +540,8 @@ void CTxMemPool::removeForBlock(const std::vector<CTransaction>& vtx, unsigned i
         removeConflicts(tx, conflicts);
         ClearPrioritisation(tx.GetHash());
     }
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = true;
 }
 
 
@@ -535,9 +551,79 @@ void CTxMemPool::clear()
     mapTx.clear();
     mapNextTx.clear();
     totalTxSize = 0;
+    cachedInnerUsage = 0;
+    nZerocoinSpends = 0;
+    lastRollingFeeUpdate = GetTime();
+    blockSinceLastRollingFeeBump = false;
+    rollingMinimumFeeRate = 0;
     ++nTransactionsUpdated;
 }
 
+void CTxMemPool::TrimToSize(size_t sizelimit, std::list<CTransaction>& removed)
+{
+    LOCK(cs);
+    if (DynamicMemoryUsage() <= sizelimit || mapTx.size() == nZerocoinSpends)
+        return;
+
+    // Cheapest first, counting fee deltas from prioritisetransaction
+    std::vector<std::pair<CFeeRate, uint256> > vByFeeRate;
+    vByFeeRate.reserve(mapTx.size());
+    for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
+        if (it->second.GetTx().IsZerocoinSpend())
+            continue;
+        CAmount nFee = it->second.GetFee();
+        std::map<uint256, std::pair<double, CAmount> >::const_iterator itDelta = mapDeltas.find(it->first);
+        if (itDelta != mapDeltas.end())
+            nFee += itDelta->second.second;
+        vByFeeRate.push_back(std::make_pair(CFeeRate(nFee, it->second.GetTxSize()), it->first));
+    }
+    std::sort(vByFeeRate.begin(), vByFeeRate.end());
+
+    const size_t nTargetUsage = sizelimit - sizelimit / 20;
+    for (unsigned int i = 0; i < vByFeeRate.size() && DynamicMemoryUsage() > nTargetUsage; i++) {
+        std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.find(vByFeeRate[i].second);
+        if (it == mapTx.end())
+            continue; // already gone with an evicted parent
+        CTransaction tx = it->second.GetTx();
+        remove(tx, removed, true);
+        trackPackageRemoved(CFeeRate(vByFeeRate[i].first.GetFeePerK() + minRelayFee.GetFeePerK()));
+    }
+}
+
+void CTxMemPool::trackPackageRemoved(const CFeeRate& rate)
+{
+    AssertLockHeld(cs);
+    if (rate.GetFeePerK() > rollingMinimumFeeRate) {
+        rollingMinimumFeeRate = rate.GetFeePerK();
+        blockSinceLastRollingFeeBump = false;
+    }
+}
+
+CFeeRate CTxMemPool::GetMinFee(size_t sizelimit) const
+{
+    LOCK(cs);
+    if (!blockSinceLastRollingFeeBump || rollingMinimumFeeRate == 0)
+        return CFeeRate(llround(rollingMinimumFeeRate));
+
+    int64_t time = GetTime();
+    if (time > lastRollingFeeUpdate + 10) {
+        double halflife = ROLLING_FEE_HALFLIFE;
+        if (DynamicMemoryUsage() < sizelimit / 4)
+            halflife /= 4;
+        else if (DynamicMemoryUsage() < sizelimit / 2)
+            halflife /= 2;
+
+        rollingMinimumFeeRate = rollingMinimumFeeRate / pow(2.0, (time - lastRollingFeeUpdate) / halflife);
+        lastRollingFeeUpdate = time;
+
+        if (rollingMinimumFeeRate < minRelayFee.GetFeePerK() / 2) {
+            rollingMinimumFeeRate = 0;
+            return CFeeRate(0);
+        }
+    }
+    return std::max(CFeeRate(llround(rollingMinimumFeeRate)), minRelayFee);
+}
+
 void CTxMemPool::check(const CCoinsViewCache* pcoins) const
 {
     if (!fSanityCheck)
@@ -546,6 +632,8 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     LogPrint("mempool", "Checking mempool with %u transactions and %u inputs\n", (unsigned int)mapTx.size(), (unsigned int)mapNextTx.size());
 
     uint64_t checkTotal = 0;
+    uint64_t innerUsage = 0;
+    uint64_t checkZerocoinSpends = 0;
 
     CCoinsViewCache mempoolDuplicate(const_cast<CCoinsViewCache*>(pcoins));
 
@@ -554,7 +642,10 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     for (std::map<uint256, CTxMemPoolEntry>::const_iterator it = mapTx.begin(); it != mapTx.end(); it++) {
         unsigned int i = 0;
         checkTotal += it->second.GetTxSize();
+        innerUsage += it->second.DynamicMemoryUsage();
         const CTransaction& tx = it->second.GetTx();
+        if (tx.IsZerocoinSpend())
+            checkZerocoinSpends++;
         bool fDependsWait = false;
         BOOST_FOREACH (const CTxIn& txin, tx.vin) {
             // Check that every mempool transaction's inputs refer to available coins, or other mempool tx's.
@@ -610,6 +701,8 @@ void CTxMemPool::check(const CCoinsViewCache* pcoins) const
     }
 
     assert(totalTxSize == checkTotal);
+    assert(innerUsage == cachedInnerUsage);
+    assert(checkZerocoinSpends == nZerocoinSpends);
 }
 
 void CTxMemPool::queryHashes(vector<uint256>& vtxid)
@@ -640,6 +733,12 @@ bool CTxMemPool::lookup(uint256 hash, CTransaction& result) const
     return true;
 }
 
+size_t CTxMemPool::DynamicMemoryUsage() const
+{
+    LOCK(cs);
+    return memusage::DynamicUsage(mapTx) + memusage::DynamicUsage(mapNextTx) + memusage::DynamicUsage(mapDeltas) + cachedInnerUsage;
+}
+
 CFeeRate CTxMemPool::estimateFee(int nBlocks) const
 {
     LOCK(cs);
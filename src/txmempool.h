@@ -42,6 +42,7 @@ private:
     CAmount nFee;         //! Cached to avoid expensive parent-transaction lookups
     size_t nTxSize;       //! ... and avoid recomputing tx size
     size_t nModSize;      //! ... and modified size for priority
+    size_t nUsageSize;    //! ... and total memory usage
     int64_t nTime;        //! Local time when entering the mempool
     double dPriority;     //! Priority when entering the mempool
     unsigned int nHeight; //! Chain height when entering the mempool
@@ -57,6 +58,7 @@ public:
     size_t GetTxSize() const { return nTxSize; }
     int64_t GetTime() const { return nTime; }
     unsigned int GetHeight() const { return nHeight; }
+    size_t DynamicMemoryUsage() const { return nUsageSize; }
 };
 
 class CMinerPolicyEstimator;
@@ -101,8 +103,18 @@ private:
 
     CFeeRate minRelayFee; //! Passed to constructor to avoid dependency on main
     uint64_t totalTxSize; //! sum of all mempool tx' byte sizes
+    uint64_t cachedInnerUsage; //! sum of dynamic memory usage of all the map elements (NOT the maps themselves)
+    uint64_t nZerocoinSpends; //! number of zerocoin spends in mapTx, which TrimToSize cannot evict
+
+    mutable int64_t lastRollingFeeUpdate;
+    mutable bool blockSinceLastRollingFeeBump;
+    mutable double rollingMinimumFeeRate; //! minimum fee to get into the pool, decreases exponentially
+
+    void trackPackageRemoved(const CFeeRate& rate);
 
 public:
+    static const int ROLLING_FEE_HALFLIFE = 60 * 60 * 12; // public only for testing
+
     mutable CCriticalSection cs;
     std::map<uint256, CTxMemPoolEntry> mapTx;
     std::map<COutPoint, CInPoint> mapNextTx;
@@ -126,6 +138,18 @@ public:
     void removeConflicts(const CTransaction& tx, std::list<CTransaction>& removed);
     void removeForBlock(const std::vector<CTransaction>& vtx, unsigned int nBlockHeight, std::list<CTransaction>& conflicts);
     void clear();
+    /**
+     * Evict the transactions paying the lowest fee rate, together with anything spending them, until
+     * the pool uses a twentieth less than sizelimit bytes, so that the next additions don't sort the
+     * pool again. Zerocoin spends are never evicted, so a pool holding nothing else is left alone.
+     */
+    void TrimToSize(size_t sizelimit, std::list<CTransaction>& removed);
+    /**
+     * The minimum fee rate to get into a pool limited to sizelimit bytes. Raised to just above the
+     * fee rate of the last evicted transaction, then halves every ROLLING_FEE_HALFLIFE seconds once
+     * a block has been connected since, faster while the pool is small.
+     */
+    CFeeRate GetMinFee(size_t sizelimit) const;
     void queryHashes(std::vector<uint256>& vtxid);
     void getTransactions(std::set<uint256>& setTxid);
     void pruneSpent(const uint256& hash, CCoins& coins);
@@ -156,6 +180,8 @@ public:
 
     bool lookup(uint256 hash, CTransaction& result) const;
 
+    size_t DynamicMemoryUsage() const;
+
     /** Estimate fee rate needed to get into the next nBlocks */
     CFeeRate estimateFee(int nBlocks) const;
 
@@ -735,6 +735,48 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    // Bring the cached zBWI witnesses up to date whenever a new accumulator checkpoint is connected, so that
+    // a spend or stake only has to add the few blocks since. Stay as deep as a stake would stop. The work is
+    // left to AdvanceWitnessCaches() on the wallet thread, so that it doesn't hold up validation.
+    if (!zbwiTracker || pindex->nHeight % 10 != 0 || pindex->nHeight < Params().Zerocoin_Block_V2_Start())
+        return;
+
+    int nHeightStop = pindex->nHeight - Params().Zerocoin_RequiredStakeDepth();
+    nHeightStop -= nHeightStop % 10 + 10;
+    nWitnessCacheHeightStop = nHeightStop;
+}
+
+void CWallet::AdvanceWitnessCaches()
+{
+    int nHeightStop = nWitnessCacheHeightStop.exchange(0);
+    if (nHeightStop <= 0 || !zbwiTracker)
+        return;
+
+    std::map<uint256, CAccumulatorWitnessCache> mapWitnessCache;
+    {
+        LOCK(cs_wallet);
+        mapWitnessCache = zbwiTracker->GetWitnessCaches();
+    }
+
+    for (const auto& it : mapWitnessCache) {
+        if (it.second.nHeightNext >= nHeightStop)
+            continue;
+
+        CAccumulatorWitnessCache cache = it.second;
+        if (!AdvanceAccumulatorWitnessCache(cache, nHeightStop))
+            continue;
+
+        // Only store the result if a spend did not move the cache in the meantime
+        LOCK(cs_wallet);
+        CAccumulatorWitnessCache cacheCurrent;
+        if (zbwiTracker->GetWitnessCache(it.first, cacheCurrent) && cacheCurrent.nHeightNext == it.second.nHeightNext &&
+            cacheCurrent.hashBlockLast == it.second.hashBlockLast)
+            zbwiTracker->SetWitnessCache(it.first, cache);
+    }
+}
+
 void CWallet::EraseFromWallet(const uint256& hash)
 {
     if (!fFileBacked)
@@ -2975,7 +3017,7 @@ bool CWallet::CreateTransaction(CScript scriptPubKey, const CAmount& nValue, CWa
 }
 
 // ppcoin: create coin stake transaction
-bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int64_t nSearchInterval, CMutableTransaction& txNew, unsigned int& nTxNewTime)
+bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, unsigned int nTimeSearchedTo, CMutableTransaction& txNew, unsigned int& nTxNewTime)
 {
     // The following split & combine thresholds are important to security
     // Should not be adjusted if you don't understand the consequences
@@ -2997,104 +3039,98 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
     if (nBalance > 0 && nBalance <= nReserveBalance)
         return false;
 
-    // Get the list of stakable inputs
-    std::list<std::unique_ptr<CStakeInput> > listInputs;
-    if (!SelectStakeCoins(listInputs, nBalance - nReserveBalance))
-        return false;
+    // Get the list of stakable inputs, again only when the caller saw the tip or the coins change
+    // or the kernel candidates built from them may be out of date
+    if (nTimeSearchedTo == 0 || stakeKernelTable.IsStale(chainActive.Tip(), nBits, GetAdjustedTime())) {
+        std::list<std::unique_ptr<CStakeInput> > listInputs;
+        if (!SelectStakeCoins(listInputs, nBalance - nReserveBalance)) {
+            stakeKernelTable.Clear();
+            return false;
+        }
+        stakeKernelTable.Build(listInputs, chainActive.Tip(), nBits, GetAdjustedTime());
+    }
 
-    if (listInputs.empty())
+    if (!stakeKernelTable.size())
         return false;
 
-    if (GetAdjustedTime() - chainActive.Tip()->GetBlockTime() < 60)
-        MilliSleep(10000);
-
     CAmount nCredit;
     CScript scriptPubKeyKernel;
     bool fKernelFound = false;
-    for (std::unique_ptr<CStakeInput>& stakeInput : listInputs) {
+    while (true) {
         nCredit = 0;
         // Make sure the wallet is unlocked and shutdown hasn't been requested
         if (IsLocked() || ShutdownRequested())
             return false;
 
-        //make sure that enough time has elapsed between
-        CBlockIndex* pindex = stakeInput->GetIndexFrom();
-        if (!pindex || pindex->nHeight < 1) {
-            LogPrintf("*** no pindexfrom\n");
-            continue;
-        }
-
-        // Read block header
-        CBlockHeader block = pindex->GetBlockHeader();
         uint256 hashProofOfStake = 0;
         nTxNewTime = GetAdjustedTime();
 
-        //iterates each utxo inside of CheckStakeKernelHash()
-        if (Stake(stakeInput.get(), nBits, block.GetBlockTime(), nTxNewTime, hashProofOfStake)) {
-            LOCK(cs_main);
-            //Double check that this will pass time requirements
-            if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
-                LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
-                continue;
-            }
+        //hashes the timestamps that became reachable since the last sweep
+        CStakeInput* stakeInput = stakeKernelTable.Sweep(nTxNewTime, hashProofOfStake);
+        if (!stakeInput)
+            break;
 
-            // Found a kernel
-            LogPrintf("CreateCoinStake : kernel found\n");
-            nCredit += stakeInput->GetValue();
+        LOCK(cs_main);
+        //Double check that this will pass time requirements
+        if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
+            LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
+            continue;
+        }
 
-            // Calculate reward
-            CAmount nReward;
-            nReward = GetBlockValue(chainActive.Height() + 1);
-            nCredit += nReward;
+        // Found a kernel
+        LogPrintf("CreateCoinStake : kernel found\n");
+        nCredit += stakeInput->GetValue();
 
-            // Create the output transaction(s)
-            vector<CTxOut> vout;
-            if (!stakeInput->CreateTxOuts(this, vout, nCredit)) {
-                LogPrintf("%s : failed to get scriptPubKey\n", __func__);
-                continue;
-            }
-            txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
-
-            CAmount nMinFee = 0;
-            if (!stakeInput->IsZBWI()) {
-                // Set output amount
-                if (txNew.vout.size() == 3) {
-                    txNew.vout[1].nValue = ((nCredit - nMinFee) / 2 / CENT) * CENT;
-                    txNew.vout[2].nValue = nCredit - nMinFee - txNew.vout[1].nValue;
-                } else
-                    txNew.vout[1].nValue = nCredit - nMinFee;
-            }
+        // Calculate reward
+        CAmount nReward;
+        nReward = GetBlockValue(chainActive.Height() + 1);
+        nCredit += nReward;
 
-            // Limit size
-            unsigned int nBytes = ::GetSerializeSize(txNew, SER_NETWORK, PROTOCOL_VERSION);
-            if (nBytes >= DEFAULT_BLOCK_MAX_SIZE / 5)
-                return error("CreateCoinStake : exceeded coinstake size limit");
+        // Create the output transaction(s)
+        vector<CTxOut> vout;
+        if (!stakeInput->CreateTxOuts(this, vout, nCredit)) {
+            LogPrintf("%s : failed to get scriptPubKey\n", __func__);
+            continue;
+        }
+        txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
 
-            //Masternode payment
-            FillBlockPayee(txNew, nMinFee, true, stakeInput->IsZBWI());
+        CAmount nMinFee = 0;
+        if (!stakeInput->IsZBWI()) {
+            // Set output amount
+            if (txNew.vout.size() == 3) {
+                txNew.vout[1].nValue = ((nCredit - nMinFee) / 2 / CENT) * CENT;
+                txNew.vout[2].nValue = nCredit - nMinFee - txNew.vout[1].nValue;
+            } else
+                txNew.vout[1].nValue = nCredit - nMinFee;
+        }
 
-            uint256 hashTxOut = txNew.GetHash();
-            CTxIn in;
-            if (!stakeInput->CreateTxIn(this, in, hashTxOut)) {
-                LogPrintf("%s : failed to create TxIn\n", __func__);
-                txNew.vin.clear();
-                txNew.vout.clear();
-                continue;
-            }
-            txNew.vin.emplace_back(in);
+        // Limit size
+        unsigned int nBytes = ::GetSerializeSize(txNew, SER_NETWORK, PROTOCOL_VERSION);
+        if (nBytes >= DEFAULT_BLOCK_MAX_SIZE / 5)
+            return error("CreateCoinStake : exceeded coinstake size limit");
 
-            //Mark mints as spent
-            if (stakeInput->IsZBWI()) {
-                CZBWIStake* z = (CZBWIStake*)stakeInput.get();
-                if (!z->MarkSpent(this, txNew.GetHash()))
-                    return error("%s: failed to mark mint as used\n", __func__);
-            }
+        //Masternode payment
+        FillBlockPayee(txNew, nMinFee, true, stakeInput->IsZBWI());
 
-            fKernelFound = true;
-            break;
+        uint256 hashTxOut = txNew.GetHash();
+        CTxIn in;
+        if (!stakeInput->CreateTxIn(this, in, hashTxOut)) {
+            LogPrintf("%s : failed to create TxIn\n", __func__);
+            txNew.vin.clear();
+            txNew.vout.clear();
+            continue;
+        }
+        txNew.vin.emplace_back(in);
+
+        //Mark mints as spent
+        if (stakeInput->IsZBWI()) {
+            CZBWIStake* z = (CZBWIStake*)stakeInput;
+            if (!z->MarkSpent(this, txNew.GetHash()))
+                return error("%s: failed to mark mint as used\n", __func__);
         }
-        if (fKernelFound)
-            break; // if kernel is found stop searching
+
+        fKernelFound = true;
+        break;
     }
     if (!fKernelFound)
         return false;
@@ -4637,7 +4673,20 @@ bool CWallet::MintToTxIn(CZerocoinMint zerocoinSelected, int nSecurityLevel, con
     libzerocoin::AccumulatorWitness witness(paramsAccumulator, accumulator, pubCoinSelected);
     string strFailReason = "";
     int nMintsAdded = 0;
-    if (!GenerateAccumulatorWitness(pubCoinSelected, accumulator, witness, nSecurityLevel, nMintsAdded, strFailReason, pindexCheckpoint)) {
+    uint256 hashPubcoin = GetPubCoinHash(pubCoinSelected.getValue());
+    CAccumulatorWitnessCache witnessCache;
+    {
+        LOCK(cs_wallet);
+        zbwiTracker->GetWitnessCache(hashPubcoin, witnessCache);
+    }
+    int nHeightCached = witnessCache.nHeightNext;
+    uint256 hashCached = witnessCache.hashBlockLast;
+    bool fWitness = GenerateAccumulatorWitness(pubCoinSelected, accumulator, witness, nSecurityLevel, nMintsAdded, strFailReason, pindexCheckpoint, &witnessCache);
+    if (witnessCache.nHeightNext != nHeightCached || witnessCache.hashBlockLast != hashCached) {
+        LOCK(cs_wallet);
+        zbwiTracker->SetWitnessCache(hashPubcoin, witnessCache);
+    }
+    if (!fWitness) {
         receipt.SetStatus(_("Try to spend with a higher security level to include more coins"), ZBWI_FAILED_ACCUMULATOR_INITIALIZATION);
         return error("%s : %s", __func__, receipt.GetStatusMessage());
     }
@@ -27,6 +27,7 @@
 #include "zbwitracker.h"
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -244,6 +245,7 @@ public:
     std::string strWalletFile;
     bool fBackupMints;
     std::unique_ptr<CzBWITracker> zbwiTracker;
+    std::atomic<int> nWitnessCacheHeightStop; // witness caches still to be advanced to here, 0 if none
 
     std::set<int64_t> setKeyPool;
     std::map<CKeyID, CKeyMetadata> mapKeyMetadata;
@@ -257,6 +259,7 @@ public:
     unsigned int nHashInterval;
     uint64_t nStakeSplitThreshold;
     int nStakeSetUpdateTime;
+    CStakeKernelTable stakeKernelTable; // only used by the stake minter thread
 
     //MultiSend
     std::vector<std::pair<std::string, int> > vMultiSend;
@@ -302,6 +305,7 @@ public:
         nTimeFirstKey = 0;
         fWalletUnlockAnonymizeOnly = false;
         fBackupMints = false;
+        nWitnessCacheHeightStop = 0;
 
         // Stake Settings
         nHashDrift = 45;
@@ -465,6 +469,8 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet = false);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+    void UpdatedBlockTip(const CBlockIndex* pindex);
+    void AdvanceWitnessCaches();
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     void EraseFromWallet(const uint256& hash);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
@@ -506,7 +512,7 @@ public:
     int GenerateObfuscationOutputs(int nTotalValue, std::vector<CTxOut>& vout);
     bool CreateCollateralTransaction(CMutableTransaction& txCollateral, std::string& strReason);
     bool ConvertList(std::vector<CTxIn> vCoins, std::vector<int64_t>& vecAmounts);
-    bool CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int64_t nSearchInterval, CMutableTransaction& txNew, unsigned int& nTxNewTime);
+    bool CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, unsigned int nTimeSearchedTo, CMutableTransaction& txNew, unsigned int& nTxNewTime);
     bool MultiSend();
     void AutoCombineDust();
     void AutoZeromint();
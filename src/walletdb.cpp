@@ -8,6 +8,7 @@
 #include "walletdb.h"
 
 #include "base58.h"
+#include "init.h"
 #include "protocol.h"
 #include "serialize.h"
 #include "sync.h"
@@ -857,8 +858,7 @@ void ThreadFlushWalletDB(const string& strFile)
     if (fOneThread)
         return;
     fOneThread = true;
-    if (!GetBoolArg("-flushwallet", true))
-        return;
+    bool fFlushWallet = GetBoolArg("-flushwallet", true);
 
     unsigned int nLastSeen = nWalletDBUpdated;
     unsigned int nLastFlushed = nWalletDBUpdated;
@@ -866,6 +866,13 @@ void ThreadFlushWalletDB(const string& strFile)
     while (true) {
         MilliSleep(500);
 
+        // Catch up the zBWI witness caches outside the validation callback that asked for it
+        if (pwalletMain)
+            pwalletMain->AdvanceWitnessCaches();
+
+        if (!fFlushWallet)
+            continue;
+
         if (nLastSeen != nWalletDBUpdated) {
             nLastSeen = nWalletDBUpdated;
             nLastWalletUpdate = GetTime();
@@ -1380,6 +1387,61 @@ std::map<uint256, std::vector<pair<uint256, uint32_t> > > CWalletDB::MapMintPool
     return mapPool;
 }
 
+bool CWalletDB::WriteWitnessCache(const uint256& hashPubcoin, const CAccumulatorWitnessCache& cache)
+{
+    return Write(make_pair(string("zwitness"), hashPubcoin), cache);
+}
+
+bool CWalletDB::EraseWitnessCache(const uint256& hashPubcoin)
+{
+    return Erase(make_pair(string("zwitness"), hashPubcoin));
+}
+
+//! map with hashPubcoin as the key, paired with how far the witness of that mint has been accumulated
+std::map<uint256, CAccumulatorWitnessCache> CWalletDB::MapWitnessCache()
+{
+    std::map<uint256, CAccumulatorWitnessCache> mapCache;
+    Dbc* pcursor = GetCursor();
+    if (!pcursor)
+        throw runtime_error(std::string(__func__)+" : cannot create DB cursor");
+    unsigned int fFlags = DB_SET_RANGE;
+    for (;;)
+    {
+        // Read next record
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        if (fFlags == DB_SET_RANGE)
+            ssKey << make_pair(string("zwitness"), uint256(0));
+        CDataStream ssValue(SER_DISK, CLIENT_VERSION);
+        int ret = ReadAtCursor(pcursor, ssKey, ssValue, fFlags);
+        fFlags = DB_NEXT;
+        if (ret == DB_NOTFOUND)
+            break;
+        else if (ret != 0)
+        {
+            pcursor->close();
+            throw runtime_error(std::string(__func__)+" : error scanning DB");
+        }
+
+        // Unserialize
+        string strType;
+        ssKey >> strType;
+        if (strType != "zwitness")
+            break;
+
+        uint256 hashPubcoin;
+        ssKey >> hashPubcoin;
+
+        CAccumulatorWitnessCache cache;
+        ssValue >> cache;
+
+        mapCache.insert(make_pair(hashPubcoin, cache));
+    }
+
+    pcursor->close();
+
+    return mapCache;
+}
+
 std::list<CDeterministicMint> CWalletDB::ListDeterministicMints()
 {
     std::list<CDeterministicMint> listMints;
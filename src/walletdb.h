@@ -185,6 +185,9 @@ public:
     bool ReadZBWICount(uint32_t& nCount);
     std::map<uint256, std::vector<pair<uint256, uint32_t> > > MapMintPool();
     bool WriteMintPoolPair(const uint256& hashMasterSeed, const uint256& hashPubcoin, const uint32_t& nCount);
+    bool WriteWitnessCache(const uint256& hashPubcoin, const CAccumulatorWitnessCache& cache);
+    bool EraseWitnessCache(const uint256& hashPubcoin);
+    std::map<uint256, CAccumulatorWitnessCache> MapWitnessCache();
 
 
 private:
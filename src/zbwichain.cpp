@@ -79,6 +79,92 @@ bool BlockToPubcoinList(const CBlock& block, std::list<libzerocoin::PublicCoin>&
     return true;
 }
 
+bool BlockToPubcoinMap(const CBlock& block, BlockPubcoinMap& mapPubcoins)
+{
+    for (const CTransaction& tx : block.vtx) {
+        if(!tx.IsZerocoinMint())
+            continue;
+
+        // Same filtering as BlockToPubcoinList, recorded instead of applied
+        bool fInvalid = false;
+        for (const CTxIn& in : tx.vin) {
+            if (!ValidOutPoint(in.prevout, INT_MAX)) {
+                fInvalid = true;
+                break;
+            }
+        }
+
+        uint256 txHash = tx.GetHash();
+        for (unsigned int i = 0; i < tx.vout.size(); i++) {
+            if (!ValidOutPoint(COutPoint(txHash, i), INT_MAX))
+                fInvalid = true;
+
+            const CTxOut& txOut = tx.vout[i];
+            if(!txOut.scriptPubKey.IsZerocoinMint())
+                continue;
+
+            CValidationState state;
+            libzerocoin::PublicCoin pubCoin(Params().Zerocoin_Params(false));
+            if(!TxOutToPublicCoin(txOut, pubCoin, state))
+                return false;
+
+            mapPubcoins[pubCoin.getDenomination()].emplace_back(pubCoin.getValue(), fInvalid);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * The pubcoins of one denomination (or all of them for ZQ_ERROR) minted in the block at pindex.
+ * Served from the zerocoinDB pubcoin index, falling back to reading the block when the index
+ * has no entry for it, e.g. for blocks connected before the index existed.
+ */
+bool GetBlockPubcoins(const CBlockIndex* pindex, libzerocoin::CoinDenomination denom, bool fFilterInvalid, std::list<libzerocoin::PublicCoin>& listPubcoins)
+{
+    uint256 hashBlock;
+    std::vector<libzerocoin::CoinDenomination> vDenoms;
+    if (pzerocoinTip->ReadBlockPubcoinDenoms(pindex->nHeight, hashBlock, vDenoms) && hashBlock == pindex->GetBlockHash()) {
+        std::list<libzerocoin::PublicCoin> listIndexed;
+        bool fComplete = true;
+        for (const libzerocoin::CoinDenomination denomIndexed : vDenoms) {
+            if (denom != libzerocoin::ZQ_ERROR && denomIndexed != denom)
+                continue;
+
+            std::vector<std::pair<CBigNum, bool> > vPubcoins;
+            if (!pzerocoinTip->ReadBlockPubcoins(pindex->nHeight, denomIndexed, vPubcoins)) {
+                fComplete = false;
+                break;
+            }
+            for (const auto& pubcoin : vPubcoins) {
+                if (fFilterInvalid && pubcoin.second)
+                    continue;
+                listIndexed.emplace_back(Params().Zerocoin_Params(false), pubcoin.first, denomIndexed);
+            }
+        }
+
+        if (fComplete) {
+            listPubcoins.splice(listPubcoins.end(), listIndexed);
+            return true;
+        }
+    }
+
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return error("%s: failed to read block from disk", __func__);
+
+    std::list<libzerocoin::PublicCoin> listBlock;
+    if (!BlockToPubcoinList(block, listBlock, fFilterInvalid))
+        return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
+
+    for (const libzerocoin::PublicCoin& pubcoin : listBlock) {
+        if (denom == libzerocoin::ZQ_ERROR || pubcoin.getDenomination() == denom)
+            listPubcoins.emplace_back(pubcoin);
+    }
+
+    return true;
+}
+
 //return a list of zerocoin mints contained in a specific block
 bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMints, bool fFilterInvalid)
 {
@@ -131,7 +217,7 @@ void FindMints(std::vector<CMintMeta> vMintsToFind, std::vector<CMintMeta>& vMin
     // something went wrong
     for (CMintMeta meta : vMintsToFind) {
         uint256 txHash;
-        if (!zerocoinDB->ReadCoinMint(meta.hashPubcoin, txHash)) {
+        if (!pzerocoinTip->ReadCoinMint(meta.hashPubcoin, txHash)) {
             vMissingMints.push_back(meta);
             continue;
         }
@@ -153,7 +239,7 @@ void FindMints(std::vector<CMintMeta> vMintsToFind, std::vector<CMintMeta>& vMin
 
         //see if this mint is spent
         uint256 hashTxSpend = 0;
-        bool fSpent = zerocoinDB->ReadCoinSpend(meta.hashSerial, hashTxSpend);
+        bool fSpent = pzerocoinTip->ReadCoinSpend(meta.hashSerial, hashTxSpend);
 
         //if marked as spent, check that it actually made it into the chain
         CTransaction txSpend;
@@ -212,50 +298,63 @@ int GetZerocoinStartHeight()
 bool GetZerocoinMint(const CBigNum& bnPubcoin, uint256& txHash)
 {
     txHash = 0;
-    return zerocoinDB->ReadCoinMint(bnPubcoin, txHash);
+    return pzerocoinTip->ReadCoinMint(bnPubcoin, txHash);
 }
 
 bool IsPubcoinInBlockchain(const uint256& hashPubcoin, uint256& txid)
 {
     txid = 0;
-    return zerocoinDB->ReadCoinMint(hashPubcoin, txid);
+    return pzerocoinTip->ReadCoinMint(hashPubcoin, txid);
 }
 
 bool IsSerialKnown(const CBigNum& bnSerial)
 {
     uint256 txHash = 0;
-    return zerocoinDB->ReadCoinSpend(bnSerial, txHash);
+    return pzerocoinTip->ReadCoinSpend(bnSerial, txHash);
 }
 
 bool IsSerialInBlockchain(const CBigNum& bnSerial, int& nHeightTx)
 {
     uint256 txHash = 0;
-    // if not in zerocoinDB then its not in the blockchain
-    if (!zerocoinDB->ReadCoinSpend(bnSerial, txHash))
-        return false;
-
-    return IsTransactionInChain(txHash, nHeightTx);
+    return IsSerialInBlockchain(GetSerialHash(bnSerial), nHeightTx, txHash);
 }
 
 bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& txidSpend)
 {
-    CTransaction tx;
-    return IsSerialInBlockchain(hashSerial, nHeightTx, txidSpend, tx);
+    txidSpend = 0;
+    // if not in zerocoinDB then its not in the blockchain
+    int nHeightSpend;
+    if (!pzerocoinTip->ReadCoinSpend(hashSerial, txidSpend, nHeightSpend))
+        return false;
+
+    // spends connected since startup, or found before, carry their height and need no transaction lookup
+    if (nHeightSpend >= 0) {
+        nHeightTx = nHeightSpend;
+        return true;
+    }
+
+    if (!IsTransactionInChain(txidSpend, nHeightTx))
+        return false;
+    pzerocoinTip->SetCoinSpendHeight(hashSerial, nHeightTx);
+    return true;
 }
 
 bool IsSerialInBlockchain(const uint256& hashSerial, int& nHeightTx, uint256& txidSpend, CTransaction& tx)
 {
     txidSpend = 0;
     // if not in zerocoinDB then its not in the blockchain
-    if (!zerocoinDB->ReadCoinSpend(hashSerial, txidSpend))
+    if (!pzerocoinTip->ReadCoinSpend(hashSerial, txidSpend))
         return false;
 
-    return IsTransactionInChain(txidSpend, nHeightTx, tx);
+    if (!IsTransactionInChain(txidSpend, nHeightTx, tx))
+        return false;
+    pzerocoinTip->SetCoinSpendHeight(hashSerial, nHeightTx);
+    return true;
 }
 
 std::string ReindexZerocoinDB()
 {
-    if (!zerocoinDB->WipeCoins("spends") || !zerocoinDB->WipeCoins("mints")) {
+    if (!pzerocoinTip->WipeCoins("spends") || !pzerocoinTip->WipeCoins("mints")) {
         return _("Failed to wipe zerocoinDB");
     }
 
@@ -275,6 +374,10 @@ std::string ReindexZerocoinDB()
             return _("Reindexing zerocoin failed");
         }
 
+        BlockPubcoinMap mapPubcoins;
+        if (BlockToPubcoinMap(block, mapPubcoins) && !pzerocoinTip->WriteBlockPubcoins(pindex->nHeight, pindex->GetBlockHash(), mapPubcoins))
+            return _("Error writing zerocoinDB to disk");
+
         for (const CTransaction& tx : block.vtx) {
             for (unsigned int i = 0; i < tx.vin.size(); i++) {
                 if (tx.IsCoinBase())
@@ -311,7 +414,7 @@ std::string ReindexZerocoinDB()
 
         // Flush the zerocoinDB to disk every 100 blocks
         if (pindex->nHeight % 100 == 0) {
-            if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
+            if ((!vSpendInfo.empty() && !pzerocoinTip->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !pzerocoinTip->WriteCoinMintBatch(vMintInfo)) || !pzerocoinTip->Flush())
                 return _("Error writing zerocoinDB to disk");
             vSpendInfo.clear();
             vMintInfo.clear();
@@ -322,7 +425,7 @@ std::string ReindexZerocoinDB()
     uiInterface.ShowProgress("", 100);
 
     // Final flush to disk in case any remaining information exists
-    if ((!vSpendInfo.empty() && !zerocoinDB->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !zerocoinDB->WriteCoinMintBatch(vMintInfo)))
+    if ((!vSpendInfo.empty() && !pzerocoinTip->WriteCoinSpendBatch(vSpendInfo)) || (!vMintInfo.empty() && !pzerocoinTip->WriteCoinMintBatch(vMintInfo)) || !pzerocoinTip->Flush())
         return _("Error writing zerocoinDB to disk");
 
     uiInterface.ShowProgress("", 100);
@@ -332,7 +435,7 @@ std::string ReindexZerocoinDB()
 
 bool RemoveSerialFromDB(const CBigNum& bnSerial)
 {
-    return zerocoinDB->EraseCoinSpend(bnSerial);
+    return pzerocoinTip->EraseCoinSpend(bnSerial);
 }
 
 libzerocoin::CoinSpend TxInToZerocoinSpend(const CTxIn& txin)
@@ -9,9 +9,13 @@
 #include "libzerocoin/Denominations.h"
 #include "libzerocoin/CoinSpend.h"
 #include <list>
+#include <map>
 #include <string>
+#include <utility>
+#include <vector>
 
 class CBlock;
+class CBlockIndex;
 class CBigNum;
 struct CMintMeta;
 class CTransaction;
@@ -23,6 +27,10 @@ class uint256;
 
 bool BlockToMintValueVector(const CBlock& block, const libzerocoin::CoinDenomination denom, std::vector<CBigNum>& vValues);
 bool BlockToPubcoinList(const CBlock& block, std::list<libzerocoin::PublicCoin>& listPubcoins, bool fFilterInvalid);
+/** Pubcoin values minted in a block per denomination, flagged when BlockToPubcoinList would filter them as invalid */
+typedef std::map<libzerocoin::CoinDenomination, std::vector<std::pair<CBigNum, bool> > > BlockPubcoinMap;
+bool BlockToPubcoinMap(const CBlock& block, BlockPubcoinMap& mapPubcoins);
+bool GetBlockPubcoins(const CBlockIndex* pindex, libzerocoin::CoinDenomination denom, bool fFilterInvalid, std::list<libzerocoin::PublicCoin>& listPubcoins);
 bool BlockToZerocoinMintList(const CBlock& block, std::list<CZerocoinMint>& vMints, bool fFilterInvalid);
 void FindMints(std::vector<CMintMeta> vMintsToFind, std::vector<CMintMeta>& vMintsToUpdate, std::vector<CMintMeta>& vMissingMints);
 int GetZerocoinStartHeight();
@@ -0,0 +1,109 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "zbwispendcache.h"
+
+#include "hash.h"
+#include "random.h"
+#include "uint256.h"
+#include "util.h"
+#include "libzerocoin/CoinSpend.h"
+
+#include <atomic>
+#include <set>
+
+#include <boost/thread.hpp>
+#include <boost/tuple/tuple_comparison.hpp>
+
+namespace {
+
+/**
+ * Valid zerocoin spend cache, to avoid doing the expensive proof verification (commitment PoK,
+ * accumulator PoK and serial number SoK) twice for every spend (once when accepted into memory
+ * pool, and again when accepted into the block chain)
+ */
+class CZerocoinSpendCache
+{
+private:
+    //! spenddata_type is (hash of the serialized spend, accumulator checksum, V1 params):
+    typedef boost::tuple<uint256, uint32_t, bool> spenddata_type;
+    std::set<spenddata_type> setValid;
+    boost::shared_mutex cs_spendcache;
+    std::atomic<uint64_t> nHits;
+    std::atomic<uint64_t> nMisses;
+
+public:
+    CZerocoinSpendCache() : nHits(0), nMisses(0) {}
+
+    bool Get(const uint256& hashSpend, uint32_t nChecksum, bool fUseV1Params)
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_spendcache);
+
+        spenddata_type k(hashSpend, nChecksum, fUseV1Params);
+        if (setValid.count(k)) {
+            ++nHits;
+            return true;
+        }
+        ++nMisses;
+        return false;
+    }
+
+    void Set(const uint256& hashSpend, uint32_t nChecksum, bool fUseV1Params)
+    {
+        // A block holds at most a few hundred spends, and each entry is only ~40 bytes
+        int64_t nMaxCacheSize = GetArg("-maxzerocoinspendcachesize", DEFAULT_ZEROCOIN_SPEND_CACHE_SIZE);
+        if (nMaxCacheSize <= 0) return;
+
+        boost::unique_lock<boost::shared_mutex> lock(cs_spendcache);
+
+        while (static_cast<int64_t>(setValid.size()) >= nMaxCacheSize) {
+            // Evict a random entry, for the same reasons as the signature cache
+            uint256 randomHash = GetRandHash();
+            std::set<spenddata_type>::iterator it = setValid.lower_bound(spenddata_type(randomHash));
+            if (it == setValid.end())
+                it = setValid.begin();
+            setValid.erase(it);
+        }
+
+        setValid.insert(spenddata_type(hashSpend, nChecksum, fUseV1Params));
+    }
+
+    CZerocoinSpendCacheStats GetStats()
+    {
+        boost::shared_lock<boost::shared_mutex> lock(cs_spendcache);
+
+        CZerocoinSpendCacheStats stats;
+        stats.nSize = setValid.size();
+        stats.nMaxSize = std::max((int64_t)0, GetArg("-maxzerocoinspendcachesize", DEFAULT_ZEROCOIN_SPEND_CACHE_SIZE));
+        stats.nHits = nHits;
+        stats.nMisses = nMisses;
+        return stats;
+    }
+};
+
+CZerocoinSpendCache spendCache;
+
+}
+
+bool CachingVerifyZerocoinSpend(const libzerocoin::CoinSpend& spend, const libzerocoin::Accumulator& accumulator, bool fUseV1Params, bool fStore)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << spend;
+    uint256 hashSpend = ss.GetHash();
+
+    if (spendCache.Get(hashSpend, spend.getAccumulatorChecksum(), fUseV1Params))
+        return true;
+
+    if (!spend.Verify(accumulator))
+        return false;
+
+    if (fStore)
+        spendCache.Set(hashSpend, spend.getAccumulatorChecksum(), fUseV1Params);
+    return true;
+}
+
+CZerocoinSpendCacheStats GetZerocoinSpendCacheStats()
+{
+    return spendCache.GetStats();
+}
@@ -0,0 +1,38 @@
+// Copyright (c) 2018 The PIVX developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITWIN24_ZBWISPENDCACHE_H
+#define BITWIN24_ZBWISPENDCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace libzerocoin
+{
+class Accumulator;
+class CoinSpend;
+}
+
+/** -maxzerocoinspendcachesize default, in entries */
+static const int64_t DEFAULT_ZEROCOIN_SPEND_CACHE_SIZE = 10000;
+
+/** Hit/miss statistics of the verified zerocoin spend cache */
+struct CZerocoinSpendCacheStats
+{
+    size_t nSize;
+    size_t nMaxSize;
+    uint64_t nHits;
+    uint64_t nMisses;
+};
+
+/**
+ * Verify a zerocoin spend proof against an accumulator, skipping the verification when the same proof
+ * was already accepted against the same accumulator checksum. If fStore is set a successful verification
+ * is remembered, so the block containing a spend we accepted into the mempool does not pay for it again.
+ */
+bool CachingVerifyZerocoinSpend(const libzerocoin::CoinSpend& spend, const libzerocoin::Accumulator& accumulator, bool fUseV1Params, bool fStore);
+
+CZerocoinSpendCacheStats GetZerocoinSpendCacheStats();
+
+#endif //BITWIN24_ZBWISPENDCACHE_H
@@ -18,6 +18,7 @@ CzBWITracker::CzBWITracker(std::string strWalletFile)
     this->strWalletFile = strWalletFile;
     mapSerialHashes.clear();
     mapPendingSpends.clear();
+    mapWitnessCache.clear();
     fInitialized = false;
 }
 
@@ -25,6 +26,7 @@ CzBWITracker::~CzBWITracker()
 {
     mapSerialHashes.clear();
     mapPendingSpends.clear();
+    mapWitnessCache.clear();
 }
 
 void CzBWITracker::Init()
@@ -32,6 +34,7 @@ void CzBWITracker::Init()
     //Load all CZerocoinMints and CDeterministicMints from the database
     if (!fInitialized) {
         ListMints(false, false, true);
+        mapWitnessCache = CWalletDB(strWalletFile).MapWitnessCache();
         fInitialized = true;
     }
 }
@@ -276,6 +279,41 @@ bool CzBWITracker::UpdateState(const CMintMeta& meta)
     return true;
 }
 
+bool CzBWITracker::GetWitnessCache(const uint256& hashPubcoin, CAccumulatorWitnessCache& cache) const
+{
+    auto it = mapWitnessCache.find(hashPubcoin);
+    if (it == mapWitnessCache.end())
+        return false;
+
+    cache = it->second;
+    return true;
+}
+
+//Witness caches of the mints that can still be spent or staked, caches of used and archived mints are dropped
+std::map<uint256, CAccumulatorWitnessCache> CzBWITracker::GetWitnessCaches()
+{
+    CWalletDB walletdb(strWalletFile);
+    for (auto it = mapWitnessCache.begin(); it != mapWitnessCache.end();) {
+        CMintMeta meta = GetMetaFromPubcoin(it->first);
+        if (meta.hashPubcoin == it->first && !meta.isUsed && !meta.isArchived) {
+            ++it;
+            continue;
+        }
+
+        walletdb.EraseWitnessCache(it->first);
+        it = mapWitnessCache.erase(it);
+    }
+
+    return mapWitnessCache;
+}
+
+void CzBWITracker::SetWitnessCache(const uint256& hashPubcoin, const CAccumulatorWitnessCache& cache)
+{
+    mapWitnessCache[hashPubcoin] = cache;
+    if (!CWalletDB(strWalletFile).WriteWitnessCache(hashPubcoin, cache))
+        LogPrintf("%s: failed to write witness cache for %s\n", __func__, hashPubcoin.GetHex());
+}
+
 void CzBWITracker::Add(const CDeterministicMint& dMint, bool isNew, bool isArchived)
 {
     CMintMeta meta;
@@ -357,14 +395,14 @@ bool CzBWITracker::UpdateStatusInternal(const std::set<uint256>& setMempool, CMi
     //! Check whether this mint has been spent and is considered 'pending' or 'confirmed'
     // If there is not a record of the block height, then look it up and assign it
     uint256 txidMint;
-    bool isMintInChain = zerocoinDB->ReadCoinMint(mint.hashPubcoin, txidMint);
+    bool isMintInChain = pzerocoinTip->ReadCoinMint(mint.hashPubcoin, txidMint);
 
     //See if there is internal record of spending this mint (note this is memory only, would reset on restart)
     bool isPendingSpend = static_cast<bool>(mapPendingSpends.count(mint.hashSerial));
 
     // See if there is a blockchain record of spending this mint
     uint256 txidSpend;
-    bool isConfirmedSpend = zerocoinDB->ReadCoinSpend(mint.hashSerial, txidSpend);
+    bool isConfirmedSpend = pzerocoinTip->ReadCoinSpend(mint.hashSerial, txidSpend);
 
     // Double check the mempool for pending spend
     if (isPendingSpend) {
@@ -5,6 +5,7 @@
 #ifndef BITWIN24_ZBWITRACKER_H
 #define BITWIN24_ZBWITRACKER_H
 
+#include "accumulators.h"
 #include "primitives/zerocoin.h"
 #include <list>
 
@@ -17,6 +18,7 @@ private:
     std::string strWalletFile;
     std::map<uint256, CMintMeta> mapSerialHashes;
     std::map<uint256, uint256> mapPendingSpends; //serialhash, txid of spend
+    std::map<uint256, CAccumulatorWitnessCache> mapWitnessCache; //pubcoinhash, witness progress of the mint
     bool UpdateStatusInternal(const std::set<uint256>& setMempool, CMintMeta& mint);
 public:
     CzBWITracker(std::string strWalletFile);
@@ -45,6 +47,9 @@ public:
     bool UnArchive(const uint256& hashPubcoin, bool isDeterministic);
     bool UpdateZerocoinMint(const CZerocoinMint& mint);
     bool UpdateState(const CMintMeta& meta);
+    bool GetWitnessCache(const uint256& hashPubcoin, CAccumulatorWitnessCache& cache) const;
+    std::map<uint256, CAccumulatorWitnessCache> GetWitnessCaches();
+    void SetWitnessCache(const uint256& hashPubcoin, const CAccumulatorWitnessCache& cache);
     void Clear();
 };
 
@@ -210,7 +210,7 @@ void CzBWIWallet::SyncWithChain(bool fGenerateMintPool)
 
             uint256 txHash;
             CZerocoinMint mint;
-            if (zerocoinDB->ReadCoinMint(pMint.first, txHash)) {
+            if (pzerocoinTip->ReadCoinMint(pMint.first, txHash)) {
                 //this mint has already occurred on the chain, increment counter's state to reflect this
                 LogPrintf("%s : Found wallet coin mint=%s count=%d tx=%s\n", __func__, pMint.first.GetHex(), pMint.second, txHash.GetHex());
                 found = true;
@@ -372,8 +372,8 @@ void CzBWIWallet::SeedToZBWI(const uint512& seedZerocoin, CBigNum& bnValue, CBig
 
     //See if serial and randomness make a valid commitment
     // Generate a Pedersen commitment to the serial number
-    CBigNum commitmentValue = params->coinCommitmentGroup.g.pow_mod(bnSerial, params->coinCommitmentGroup.modulus).mul_mod(
-                        params->coinCommitmentGroup.h.pow_mod(bnRandomness, params->coinCommitmentGroup.modulus),
+    CBigNum commitmentValue = params->coinCommitmentGroup.gPow(bnSerial).mul_mod(
+                        params->coinCommitmentGroup.hPow(bnRandomness),
                         params->coinCommitmentGroup.modulus);
 
     CBigNum random;
@@ -395,7 +395,7 @@ void CzBWIWallet::SeedToZBWI(const uint512& seedZerocoin, CBigNum& bnValue, CBig
                               attempts256.begin(), attempts256.end());
         random.setuint256(hashRandomness);
         bnRandomness = (bnRandomness + random) % params->coinCommitmentGroup.groupOrder;
-        commitmentValue = commitmentValue.mul_mod(params->coinCommitmentGroup.h.pow_mod(random, params->coinCommitmentGroup.modulus), params->coinCommitmentGroup.modulus);
+        commitmentValue = commitmentValue.mul_mod(params->coinCommitmentGroup.hPow(random), params->coinCommitmentGroup.modulus);
     }
 }
 